@@ -0,0 +1,201 @@
+/*
+ * Measures lox_lexer_analyze_source over every corpus kind at several
+ * sizes, and prints the results as one JSON document on stdout. With
+ * --threads above 1, lox_lexer_analyze_source_parallel is measured
+ * instead.
+ *
+ * usage: lox_bench [--corpus <name>] [--max-size <KB>] [--seconds <s>]
+ *                  [--threads <n>]
+ *
+ * Each case runs in its own child process, so its peak RSS isn't
+ * inflated by the cases before it.
+ */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "lexer_parallel.h"
+#include "stats.h"
+
+#define LOX_BENCH_MIN_SIZE       1024L
+#define LOX_BENCH_DEFAULT_MAX_KB (16L * 1024)
+#define LOX_BENCH_DEFAULT_SECONDS 0.25
+
+typedef struct lox_bench_options_t
+{
+  int    corpus;
+  long   max_size;
+  double min_seconds;
+  int    thread_count;
+} lox_bench_options_t;
+
+static int
+lox_bench_run_case
+(
+  lox_corpus_e _kind,
+  long         _size,
+  double       _min_seconds,
+  int          _thread_count
+)
+{
+  char *source = lox_corpus_generate(_kind, _size);
+  if (source == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  long iterations = 0;
+  long token_count = 0;
+  lox_arena_stats_t arena_stats = { 0 };
+  long token_buffer_bytes = 0;
+  double elapsed = 0.0;
+  double start = lox_stats_now();
+  do
+  {
+    lox_lexer_t *lexer = (_thread_count > 1)
+                         ? lox_lexer_analyze_source_parallel(source, _size, _thread_count)
+                         : lox_lexer_analyze_source(source, _size);
+    if (lexer == NULL)
+    {
+      free(source);
+
+      return EXIT_FAILURE;
+    }
+
+    token_count = lexer->token_count;
+    arena_stats = lox_arena_get_stats(lexer->arena);
+    token_buffer_bytes = lexer->token_capacity * (long)sizeof(lox_token_t);
+    lox_lexer_clean(lexer);
+
+    ++iterations;
+    elapsed = lox_stats_now() - start;
+  } while (elapsed < _min_seconds);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  const double seconds_per_iteration = elapsed / (double)iterations;
+  printf("    {\"corpus\": \"%s\", \"size_bytes\": %ld, \"iterations\": %ld, "
+         "\"seconds_per_iteration\": %.9f, \"mb_per_s\": %.3f, \"tokens\": %ld, "
+         "\"tokens_per_s\": %.1f, \"arena_allocations\": %zu, \"arena_bytes\": %zu, "
+         "\"arena_reserved_bytes\": %zu, \"token_buffer_bytes\": %ld, \"peak_rss_kb\": %ld}",
+         lox_corpus_name(_kind), _size, iterations, seconds_per_iteration,
+         (double)_size / (seconds_per_iteration * 1024.0 * 1024.0), token_count,
+         (double)token_count / seconds_per_iteration, arena_stats.allocation_count,
+         arena_stats.allocated_bytes, arena_stats.reserved_bytes, token_buffer_bytes,
+         (long)usage.ru_maxrss);
+  fflush(stdout);
+
+  free(source);
+
+  return EXIT_SUCCESS;
+}
+
+static bool
+lox_bench_parse_args
+(
+  int                  _argc,
+  char               **_argv,
+  lox_bench_options_t *_options
+)
+{
+  _options->corpus = -1;
+  _options->max_size = LOX_BENCH_DEFAULT_MAX_KB * 1024;
+  _options->min_seconds = LOX_BENCH_DEFAULT_SECONDS;
+  _options->thread_count = 1;
+
+  for (int i = 1; i + 1 < _argc; i += 2)
+  {
+    if (strcmp(_argv[i], "--corpus") == 0)
+    {
+      for (int kind = 0; kind < LOX_CORPUS_COUNT; ++kind)
+      {
+        if (strcmp(_argv[i + 1], lox_corpus_name(kind)) == 0)
+        {
+          _options->corpus = kind;
+        }
+      }
+
+      if (_options->corpus < 0)
+      {
+        fprintf(stderr, "unknown corpus %s\n", _argv[i + 1]);
+
+        return false;
+      }
+    }
+    else if (strcmp(_argv[i], "--max-size") == 0)
+    {
+      _options->max_size = strtol(_argv[i + 1], NULL, 10) * 1024;
+    }
+    else if (strcmp(_argv[i], "--seconds") == 0)
+    {
+      _options->min_seconds = strtod(_argv[i + 1], NULL);
+    }
+    else if (strcmp(_argv[i], "--threads") == 0)
+    {
+      _options->thread_count = (int)strtol(_argv[i + 1], NULL, 10);
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", _argv[i]);
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+  lox_bench_options_t options;
+  if (!lox_bench_parse_args(_argc, _argv, &options))
+  {
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  bool is_first_case = true;
+  printf("{\n  \"benchmark\": \"lexer\",\n  \"simd\": \"%s\",\n  \"threads\": %d,\n"
+         "  \"results\": [\n", lox_simd_get_kernels()->name, options.thread_count);
+  for (int kind = 0; kind < LOX_CORPUS_COUNT; ++kind)
+  {
+    if (options.corpus >= 0 && kind != options.corpus)
+    {
+      continue;
+    }
+
+    for (long size = LOX_BENCH_MIN_SIZE; size <= options.max_size; size *= 16)
+    {
+      printf(is_first_case ? "" : ",\n");
+      fflush(stdout);
+      is_first_case = false;
+
+      pid_t child = fork();
+      if (child == 0)
+      {
+        exit(lox_bench_run_case(kind, size, options.min_seconds, options.thread_count));
+      }
+
+      int child_status = EXIT_FAILURE;
+      if (child < 0 || waitpid(child, &child_status, 0) < 0 ||
+          !WIFEXITED(child_status) || WEXITSTATUS(child_status) != EXIT_SUCCESS)
+      {
+        fprintf(stderr, "%s case of %ld bytes failed\n", lox_corpus_name(kind), size);
+        printf("    {\"corpus\": \"%s\", \"size_bytes\": %ld, \"error\": true}",
+               lox_corpus_name(kind), size);
+        status = EXIT_FAILURE;
+      }
+    }
+  }
+  printf("\n  ]\n}\n");
+
+  return status;
+}
@@ -0,0 +1,142 @@
+#include "corpus.h"
+
+#define LOX_CORPUS_LINE_CAPACITY 512
+
+static const char *lox_corpus_names[LOX_CORPUS_COUNT] = {
+  "identifiers", "strings", "numbers", "operators", "mixed"
+};
+
+static const char *lox_corpus_words[] = {
+  "alpha", "beta", "gamma", "delta", "epsilon", "counter", "index", "value",
+  "total", "result", "buffer", "node", "left", "right", "parent", "child"
+};
+
+/*
+ * Small xorshift generator, so corpora are the same on every platform.
+ */
+static uint32_t
+lox_corpus_next_random
+(
+  uint32_t *_state
+)
+{
+  uint32_t x = *_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *_state = x;
+
+  return x;
+}
+
+static const char
+*lox_corpus_word
+(
+  uint32_t *_state
+)
+{
+  const size_t word_count = sizeof(lox_corpus_words) / sizeof(lox_corpus_words[0]);
+
+  return lox_corpus_words[lox_corpus_next_random(_state) % word_count];
+}
+
+static int
+lox_corpus_write_line
+(
+  lox_corpus_e  _kind,
+  uint32_t     *_state,
+  long          _line_index,
+  char         *_line
+)
+{
+  switch (_kind)
+  {
+    case LOX_CORPUS_IDENTIFIERS:
+      return snprintf(_line, LOX_CORPUS_LINE_CAPACITY,
+                      "%s_%u = %s_%s.%s(%s_%u, %s);\n",
+                      lox_corpus_word(_state), lox_corpus_next_random(_state) % 4096,
+                      lox_corpus_word(_state), lox_corpus_word(_state),
+                      lox_corpus_word(_state), lox_corpus_word(_state),
+                      lox_corpus_next_random(_state) % 64, lox_corpus_word(_state));
+    case LOX_CORPUS_STRINGS:
+      return snprintf(_line, LOX_CORPUS_LINE_CAPACITY,
+                      "print \"the %s of %s number %ld is stored in the %s %s\";\n",
+                      lox_corpus_word(_state), lox_corpus_word(_state), _line_index,
+                      lox_corpus_word(_state), lox_corpus_word(_state));
+    case LOX_CORPUS_NUMBERS:
+      return snprintf(_line, LOX_CORPUS_LINE_CAPACITY,
+                      "%u.%u, %u, %u.%u, %u, %u.%u, %u,\n",
+                      lox_corpus_next_random(_state) % 100000, lox_corpus_next_random(_state) % 1000,
+                      lox_corpus_next_random(_state) % 1000000,
+                      lox_corpus_next_random(_state) % 1000, lox_corpus_next_random(_state) % 100000,
+                      lox_corpus_next_random(_state) % 100,
+                      lox_corpus_next_random(_state) % 10, lox_corpus_next_random(_state) % 10000000,
+                      lox_corpus_next_random(_state));
+    case LOX_CORPUS_OPERATORS:
+      return snprintf(_line, LOX_CORPUS_LINE_CAPACITY,
+                      "if ((a <= b) == !(c >= d) != (e < f) and -g * h / i + j > k) { x = -(-y); }\n");
+    case LOX_CORPUS_MIXED:
+    default:
+      return snprintf(_line, LOX_CORPUS_LINE_CAPACITY,
+                      "var counter_%ld = 0; # counts to %ld\n"
+                      "while (counter_%ld < 100) {\n"
+                      "  counter_%ld = counter_%ld + 1.5;\n"
+                      "  if (counter_%ld >= 50 and counter_%ld != 75) print \"halfway\";\n"
+                      "}\n",
+                      _line_index, _line_index, _line_index, _line_index,
+                      _line_index, _line_index, _line_index);
+  }
+}
+
+const char
+*lox_corpus_name
+(
+  lox_corpus_e _kind
+)
+{
+  return (_kind < LOX_CORPUS_COUNT) ? lox_corpus_names[_kind] : "unknown";
+}
+
+char
+*lox_corpus_generate
+(
+  lox_corpus_e _kind,
+  long         _size
+)
+{
+  char *source = malloc(_size + 1);
+  if (source == NULL)
+  {
+    fprintf(stderr, "failed to allocate %ld bytes of corpus\n", _size);
+
+    return NULL;
+  }
+
+  uint32_t state = 0x9E3779B9u ^ (uint32_t)_kind;
+  char line[LOX_CORPUS_LINE_CAPACITY];
+  long written = 0;
+  long truncated = _size;
+  for (long i = 0; written < _size; ++i)
+  {
+    int line_length = lox_corpus_write_line(_kind, &state, i, line);
+    if (line_length >= LOX_CORPUS_LINE_CAPACITY)
+    {
+      line_length = LOX_CORPUS_LINE_CAPACITY - 1;
+    }
+
+    long to_copy = (written + line_length <= _size) ? line_length : _size - written;
+    if (to_copy < line_length)
+    {
+      truncated = written;
+    }
+    memcpy(source + written, line, to_copy);
+    written += to_copy;
+  }
+
+  // Blank out all of the truncated last entry, which in the mixed corpus
+  // spans several lines, so the source ends on a whole statement
+  memset(source + truncated, ' ', _size - truncated);
+  source[_size] = '\0';
+
+  return source;
+}
@@ -0,0 +1,40 @@
+/*
+ * Generates synthetic Lox programs for the benchmarks, each kind
+ * stressing one part of the lexer.
+ */
+
+#ifndef LOX_CORPUS_H
+#define LOX_CORPUS_H
+
+#include "base.h"
+
+typedef enum lox_corpus_e
+{
+  LOX_CORPUS_IDENTIFIERS,
+  LOX_CORPUS_STRINGS,
+  LOX_CORPUS_NUMBERS,
+  LOX_CORPUS_OPERATORS,
+  LOX_CORPUS_MIXED,
+
+  LOX_CORPUS_COUNT
+} lox_corpus_e;
+
+const char
+*lox_corpus_name
+(
+  lox_corpus_e _kind
+);
+
+/*
+ * Returns _size bytes of source, NUL-terminated, or NULL on failure.
+ * The output only depends on _kind and _size, and never ends in the
+ * middle of a token or a statement.
+ */
+char
+*lox_corpus_generate
+(
+  lox_corpus_e _kind,
+  long         _size
+);
+
+#endif // LOX_CORPUS_H
@@ -0,0 +1,137 @@
+/*
+ * Lexes many small snippets, once with a fresh lexer per snippet and
+ * once through lox_lexer_analyze_batch, and reports snippets per
+ * second for both. Snippets are cut at line ends out of a mixed
+ * program.
+ *
+ * usage: lox_bench_batch [snippet count, defaults to 100000]
+ *                        [snippet size in bytes, defaults to 160]
+ */
+
+#include "base.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "lexer_batch.h"
+#include "stats.h"
+
+#define BENCH_DEFAULT_SNIPPETS     100000
+#define BENCH_DEFAULT_SNIPPET_SIZE 160
+
+/*
+ * Splits _source into _snippet_count views of about _snippet_size
+ * bytes each, ending after a newline.
+ */
+static lox_string_view_t
+*bench_split
+(
+  const char *_source,
+  long        _source_size,
+  long        _snippet_count,
+  long        _snippet_size
+)
+{
+  lox_string_view_t *snippets = malloc(_snippet_count * sizeof(lox_string_view_t));
+  if (snippets == NULL)
+  {
+    return NULL;
+  }
+
+  long start = 0;
+  for (long i = 0; i < _snippet_count; ++i)
+  {
+    long end = start + _snippet_size;
+    if (end > _source_size)
+    {
+      end = _source_size;
+    }
+    while (end < _source_size && _source[end - 1] != '\n')
+    {
+      ++end;
+    }
+
+    snippets[i] = (lox_string_view_t){ .data = _source + start, .length = end - start };
+    start = end;
+  }
+
+  return snippets;
+}
+
+static void
+bench_count_tokens
+(
+  void        *_token_count,
+  long         _source_index,
+  lox_lexer_t *_lexer
+)
+{
+  (void)_source_index;
+  *(long *)_token_count += _lexer->token_count;
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+  const long snippet_count = (_argc > 1) ? strtol(_argv[1], NULL, 10) : BENCH_DEFAULT_SNIPPETS;
+  const long snippet_size = (_argc > 2) ? strtol(_argv[2], NULL, 10) : BENCH_DEFAULT_SNIPPET_SIZE;
+  if (snippet_count <= 0 || snippet_size <= 0)
+  {
+    fprintf(stderr, "usage: lox_bench_batch [snippet count] [snippet size]\n");
+
+    return EXIT_FAILURE;
+  }
+
+  // Cutting at line ends makes snippets a bit longer than asked for
+  const long source_size = snippet_count * (snippet_size + snippet_size / 2);
+  char *source = lox_corpus_generate(LOX_CORPUS_MIXED, source_size);
+  lox_string_view_t *snippets = (source != NULL)
+                                ? bench_split(source, source_size, snippet_count, snippet_size)
+                                : NULL;
+  lox_lexer_t *lexer = lox_lexer_create();
+  if (snippets == NULL || lexer == NULL)
+  {
+    fprintf(stderr, "failed to set up the benchmark\n");
+
+    return EXIT_FAILURE;
+  }
+
+  long fresh_token_count = 0;
+  double start = lox_stats_now();
+  for (long i = 0; i < snippet_count; ++i)
+  {
+    lox_lexer_t *fresh_lexer = lox_lexer_analyze_source(snippets[i].data, snippets[i].length);
+    if (fresh_lexer == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+    fresh_token_count += fresh_lexer->token_count;
+    lox_lexer_clean(fresh_lexer);
+  }
+  const double fresh_seconds = lox_stats_now() - start;
+
+  long batch_token_count = 0;
+  start = lox_stats_now();
+  const long lexed_count = lox_lexer_analyze_batch(lexer, snippets, snippet_count,
+                                                   bench_count_tokens, &batch_token_count);
+  const double batch_seconds = lox_stats_now() - start;
+
+  printf("%ld snippets of ~%ld bytes, %ld tokens\n", snippet_count, snippet_size, fresh_token_count);
+  printf("fresh lexer: %.0f snippets/s, %.2f us each\n",
+         (double)snippet_count / fresh_seconds, fresh_seconds / (double)snippet_count * 1e6);
+  printf("batch:       %.0f snippets/s, %.2f us each\n",
+         (double)snippet_count / batch_seconds, batch_seconds / (double)snippet_count * 1e6);
+
+  const bool is_same = lexed_count == snippet_count && batch_token_count == fresh_token_count;
+  if (!is_same)
+  {
+    fprintf(stderr, "batch lexing produced %ld tokens instead of %ld\n",
+            batch_token_count, fresh_token_count);
+  }
+
+  lox_lexer_clean(lexer);
+  free(snippets);
+  free(source);
+
+  return is_same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,215 @@
+/*
+ * Types into a large program one keystroke at a time and reports how
+ * long lox_lexer_apply_edit takes per keystroke. Each keystroke inserts
+ * a character at a random offset, the next one deletes it again. Every
+ * BENCH_VERIFY_INTERVAL keystrokes, and once at the end, the tokens are
+ * checked against a full lex, outside the timed part.
+ *
+ * usage: lox_bench_edit [line count, defaults to 50000] [keystrokes]
+ */
+
+#include "base.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "lexer_edit.h"
+#include "stats.h"
+
+#define BENCH_DEFAULT_LINES      50000
+#define BENCH_DEFAULT_KEYSTROKES 20000
+#define BENCH_LINE_LENGTH_GUESS  64
+#define BENCH_VERIFY_INTERVAL    1000
+
+static int
+bench_compare_latencies
+(
+  const void *_left,
+  const void *_right
+)
+{
+  const double left = *(const double *)_left;
+  const double right = *(const double *)_right;
+
+  return (left > right) - (left < right);
+}
+
+/*
+ * Generates a mixed program cut after its _line_count-th line.
+ */
+static char
+*bench_generate
+(
+  long  _line_count,
+  long *_size
+)
+{
+  char *source = lox_corpus_generate(LOX_CORPUS_MIXED, _line_count * BENCH_LINE_LENGTH_GUESS);
+  if (source == NULL)
+  {
+    return NULL;
+  }
+
+  long line_count = 0;
+  long size = 0;
+  while (source[size] != '\0' && line_count < _line_count)
+  {
+    if (source[size++] == '\n')
+    {
+      ++line_count;
+    }
+  }
+
+  *_size = size;
+
+  return source;
+}
+
+/*
+ * Whether two tokens carry the same literal. Interned ids are private
+ * to each lexer, so names are compared by their text.
+ */
+static bool
+bench_same_literal
+(
+  const lox_lexer_t *_lexer,
+  const lox_token_t *_token,
+  const lox_lexer_t *_fresh_lexer,
+  const lox_token_t *_fresh_token
+)
+{
+  if (_token->literal_kind != _fresh_token->literal_kind)
+  {
+    return false;
+  }
+
+  switch (_token->literal_kind)
+  {
+    case LOX_LITERAL_NUMBER:
+      return _token->literal.number == _fresh_token->literal.number;
+    case LOX_LITERAL_INTERNED:
+    {
+      const lox_interned_t *name = lox_get_interned(_lexer->interner, _token->literal.id);
+      const lox_interned_t *fresh_name =
+        lox_get_interned(_fresh_lexer->interner, _fresh_token->literal.id);
+
+      return name != NULL && fresh_name != NULL && name->length == fresh_name->length &&
+             memcmp(name->name, fresh_name->name, name->length) == 0;
+    }
+    default:
+      return true;
+  }
+}
+
+/*
+ * Whether incremental lexing ended up where a full one does.
+ */
+static bool
+bench_verify
+(
+  const lox_lexer_t *_lexer
+)
+{
+  lox_lexer_t *fresh_lexer = lox_lexer_analyze_source(_lexer->source, _lexer->source_length);
+  if (fresh_lexer == NULL)
+  {
+    return false;
+  }
+
+  bool is_same = fresh_lexer->token_count == _lexer->token_count;
+  for (long i = 0; is_same && i < _lexer->token_count; ++i)
+  {
+    const lox_token_t *token = &_lexer->tokens[i];
+    const lox_token_t *fresh_token = &fresh_lexer->tokens[i];
+    is_same = token->type == fresh_token->type && token->offset == fresh_token->offset &&
+              token->length == fresh_token->length &&
+              bench_same_literal(_lexer, token, fresh_lexer, fresh_token);
+  }
+  lox_lexer_clean(fresh_lexer);
+
+  return is_same;
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+  const long line_count = (_argc > 1) ? strtol(_argv[1], NULL, 10) : BENCH_DEFAULT_LINES;
+  const long keystroke_count = (_argc > 2) ? strtol(_argv[2], NULL, 10) : BENCH_DEFAULT_KEYSTROKES;
+
+  long size = 0;
+  char *source = bench_generate(line_count, &size);
+  char *edited_source = malloc(size + 1);
+  double *latencies = malloc(keystroke_count * sizeof(double));
+  lox_lexer_t *lexer = (source != NULL) ? lox_lexer_analyze_source(source, size) : NULL;
+  if (edited_source == NULL || latencies == NULL || lexer == NULL)
+  {
+    fprintf(stderr, "failed to set up the benchmark\n");
+
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+  long offset = 0;
+  for (long i = 0; i < keystroke_count; ++i)
+  {
+    lox_lexer_edit_t edit = { 0 };
+    const char *edited = source;
+    long edited_size = size;
+    if (i % 2 == 0)
+    {
+      offset = rand() % (size + 1);
+      memcpy(edited_source, source, offset);
+      edited_source[offset] = 'x';
+      memcpy(edited_source + offset + 1, source + offset, size - offset);
+
+      edit = (lox_lexer_edit_t){ .offset = offset, .removed_length = 0, .inserted_length = 1 };
+      edited = edited_source;
+      edited_size = size + 1;
+    }
+    else
+    {
+      edit = (lox_lexer_edit_t){ .offset = offset, .removed_length = 1, .inserted_length = 0 };
+    }
+
+    const double start = lox_stats_now();
+    if (!lox_lexer_apply_edit(lexer, edited, edited_size, edit))
+    {
+      return EXIT_FAILURE;
+    }
+    latencies[i] = lox_stats_now() - start;
+
+    // Insertions leave the text changed, deletions only undo them
+    if (i % BENCH_VERIFY_INTERVAL == 0 && !bench_verify(lexer))
+    {
+      fprintf(stderr, "incremental tokens differ from a full lex after keystroke %ld\n", i);
+
+      return EXIT_FAILURE;
+    }
+  }
+
+  qsort(latencies, keystroke_count, sizeof(double), bench_compare_latencies);
+  double total = 0.0;
+  for (long i = 0; i < keystroke_count; ++i)
+  {
+    total += latencies[i];
+  }
+
+  printf("%ld lines, %ld bytes, %ld tokens, %ld keystrokes\n",
+         line_count, size, lexer->token_count, keystroke_count);
+  printf("mean %.1f us, median %.1f us, p99 %.1f us, max %.1f us\n",
+         total / (double)keystroke_count * 1e6, latencies[keystroke_count / 2] * 1e6,
+         latencies[keystroke_count * 99 / 100] * 1e6, latencies[keystroke_count - 1] * 1e6);
+
+  const bool is_same = bench_verify(lexer);
+  if (!is_same)
+  {
+    fprintf(stderr, "incremental tokens differ from a full lex\n");
+  }
+
+  lox_lexer_clean(lexer);
+  free(latencies);
+  free(edited_source);
+  free(source);
+
+  return is_same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+/*
+ * Lexes the same kind of program at growing sizes and checks that
+ * throughput doesn't degrade, i.e. that lexing stays linear.
+ *
+ * usage: lox_bench_scaling [max size in MB, defaults to 100]
+ */
+
+#include "base.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "stats.h"
+
+#define BENCH_MIN_SECONDS   0.25
+#define BENCH_MIN_RUNS      5
+#define BENCH_MIN_RATIO     0.5
+
+/*
+ * Throughput of the fastest of the runs. All runs share one lexer, so
+ * every size is measured with its buffers already faulted in: a fresh
+ * lexer per run would only get recycled memory from malloc for the
+ * small sizes, and the cost of zeroing new pages for the large ones
+ * would pass for a change in throughput. Taking the fastest run also
+ * keeps one the scheduler interrupted from deciding the ratio.
+ */
+static double
+bench_measure
+(
+  char *_source,
+  long  _size
+)
+{
+  lox_lexer_t *lexer = lox_lexer_create();
+  if (lexer == NULL)
+  {
+    return 0.0;
+  }
+
+  long run_count = 0;
+  double best_seconds = 0.0;
+  const double start = lox_stats_now();
+  do
+  {
+    const double run_start = lox_stats_now();
+    if (!lox_lexer_reset(lexer, _source, _size))
+    {
+      lox_lexer_clean(lexer);
+
+      return 0.0;
+    }
+    const double run_seconds = lox_stats_now() - run_start;
+
+    if (run_count == 0 || run_seconds < best_seconds)
+    {
+      best_seconds = run_seconds;
+    }
+    ++run_count;
+  } while (run_count < BENCH_MIN_RUNS || lox_stats_now() - start < BENCH_MIN_SECONDS);
+  lox_lexer_clean(lexer);
+
+  return (double)_size / (best_seconds * 1024.0 * 1024.0);
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+  long max_size = 100L * 1024 * 1024;
+  if (_argc > 1)
+  {
+    max_size = strtol(_argv[1], NULL, 10) * 1024 * 1024;
+  }
+
+  double min_throughput = 0.0;
+  double max_throughput = 0.0;
+  for (long size = 1024; size <= max_size; size *= 4)
+  {
+    char *source = lox_corpus_generate(LOX_CORPUS_MIXED, size);
+    if (source == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+    double throughput = bench_measure(source, size);
+    printf("%10ld bytes: %8.2f MB/s\n", size, throughput);
+
+    if (min_throughput == 0.0 || throughput < min_throughput)
+    {
+      min_throughput = throughput;
+    }
+    if (throughput > max_throughput)
+    {
+      max_throughput = throughput;
+    }
+
+    free(source);
+
+    // Always finish on exactly max_size
+    if (size < max_size && size * 4 > max_size)
+    {
+      size = max_size / 4;
+    }
+  }
+
+  double ratio = (max_throughput > 0.0) ? min_throughput / max_throughput : 0.0;
+  printf("min/max throughput ratio: %.2f\n", ratio);
+  if (ratio < BENCH_MIN_RATIO)
+  {
+    fprintf(stderr, "lexer throughput isn't constant across input sizes\n");
+
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
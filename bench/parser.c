@@ -0,0 +1,100 @@
+/*
+ * Measures lox_parse over the corpus kinds that are valid programs,
+ * next to the lexing that feeds it, and reports both in MB/s.
+ *
+ * usage: lox_bench_parse [size in KB, defaults to 16384]
+ */
+
+#include "base.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "parser.h"
+#include "stats.h"
+
+#define BENCH_DEFAULT_KB   (16L * 1024)
+#define BENCH_MIN_SECONDS  0.5
+
+static bool
+bench_run
+(
+  lox_corpus_e _kind,
+  long         _size
+)
+{
+  char *source = lox_corpus_generate(_kind, _size);
+  if (source == NULL)
+  {
+    return false;
+  }
+
+  double lex_seconds = 0.0;
+  double parse_seconds = 0.0;
+  long iteration_count = 0;
+  long node_count = 0;
+  long error_count = 0;
+  while (lex_seconds + parse_seconds < BENCH_MIN_SECONDS)
+  {
+    double start = lox_stats_now();
+    lox_lexer_t *lexer = lox_lexer_analyze_source(source, _size);
+    lex_seconds += lox_stats_now() - start;
+    if (lexer == NULL)
+    {
+      free(source);
+
+      return false;
+    }
+
+    start = lox_stats_now();
+    lox_ast_t *ast = lox_parse(lexer);
+    parse_seconds += lox_stats_now() - start;
+    if (ast == NULL)
+    {
+      lox_lexer_clean(lexer);
+      free(source);
+
+      return false;
+    }
+
+    node_count = ast->node_count;
+    error_count = ast->error_count;
+    lox_ast_clean(ast);
+    lox_lexer_clean(lexer);
+    ++iteration_count;
+  }
+
+  const double megabytes = (double)_size * (double)iteration_count / (1024.0 * 1024.0);
+  printf("%-12s %8ld KB  lex %7.1f MB/s  parse %7.1f MB/s  %ld nodes, %ld errors\n",
+         lox_corpus_name(_kind), _size / 1024, megabytes / lex_seconds,
+         megabytes / parse_seconds, node_count, error_count);
+  free(source);
+
+  return true;
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+  const long size = ((_argc > 1) ? strtol(_argv[1], NULL, 10) : BENCH_DEFAULT_KB) * 1024;
+  if (size <= 0)
+  {
+    fprintf(stderr, "usage: lox_bench_parse [size in KB]\n");
+
+    return EXIT_FAILURE;
+  }
+
+  // The numbers corpus is a bare list of literals, not a program
+  const lox_corpus_e kinds[] = {
+    LOX_CORPUS_IDENTIFIERS, LOX_CORPUS_STRINGS, LOX_CORPUS_OPERATORS, LOX_CORPUS_MIXED
+  };
+  for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i)
+  {
+    if (!bench_run(kinds[i], size))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+/*
+ * Runs a few loop-heavy programs through the compiler and the VM and
+ * reports how long each took, compiling included, with the collections
+ * and the longest garbage collector pause. Each program prints its
+ * result first, so a wrong answer shows above the timing.
+ *
+ * lox_bench_vm_tagged is the same benchmark over tagged-union values,
+ * see src/value.h, so the two layouts can be compared.
+ *
+ * usage: lox_bench_vm [name of the one program to run]
+ */
+
+#include "base.h"
+#include "lexer.h"
+#include "stats.h"
+#include "vm.h"
+
+typedef struct bench_program_t
+{
+  const char *name;
+  const char *source;
+} bench_program_t;
+
+static const bench_program_t bench_programs[] = {
+  {
+    "fib",
+    "fun fib(n) {\n"
+    "  if (n < 2) return n;\n"
+    "  return fib(n - 2) + fib(n - 1);\n"
+    "}\n"
+    "print fib(30);\n"
+  },
+  {
+    "loop",
+    "fun loop() {\n"
+    "  var sum = 0;\n"
+    "  for (var i = 0; i < 20000000; i = i + 1) {\n"
+    "    sum = sum + i;\n"
+    "  }\n"
+    "  return sum;\n"
+    "}\n"
+    "print loop();\n"
+  },
+  {
+    "globals",
+    "var sum = 0;\n"
+    "var i = 0;\n"
+    "while (i < 5000000) {\n"
+    "  sum = sum + i;\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "print sum;\n"
+  },
+  {
+    "methods",
+    "class Counter {\n"
+    "  init() { this.count = 0; }\n"
+    "  add(n) { this.count = this.count + n; return this; }\n"
+    "}\n"
+    "fun run() {\n"
+    "  var counter = Counter();\n"
+    "  for (var i = 0; i < 5000000; i = i + 1) counter.add(i);\n"
+    "  return counter.count;\n"
+    "}\n"
+    "print run();\n"
+  },
+  {
+    "closures",
+    "fun make() {\n"
+    "  var count = 0;\n"
+    "  fun next() { count = count + 1; return count; }\n"
+    "  return next;\n"
+    "}\n"
+    "fun run() {\n"
+    "  var next = make();\n"
+    "  var last = 0;\n"
+    "  for (var i = 0; i < 5000000; i = i + 1) last = next();\n"
+    "  return last;\n"
+    "}\n"
+    "print run();\n"
+  },
+  {
+    "strings",
+    "fun run() {\n"
+    "  var count = 0;\n"
+    "  for (var i = 0; i < 1000000; i = i + 1) {\n"
+    "    var s = \"abc\" + \"def\";\n"
+    "    if (s == \"abcdef\") count = count + 1;\n"
+    "  }\n"
+    "  return count;\n"
+    "}\n"
+    "print run();\n"
+  },
+  {
+    "garbage",
+    "class Node {\n"
+    "  init(value, next) { this.value = value; this.next = next; }\n"
+    "}\n"
+    "fun run() {\n"
+    "  var total = 0;\n"
+    "  for (var i = 0; i < 200000; i = i + 1) {\n"
+    "    var list = nil;\n"
+    "    for (var j = 0; j < 10; j = j + 1) list = Node(j, list);\n"
+    "    total = total + list.value;\n"
+    "  }\n"
+    "  return total;\n"
+    "}\n"
+    "print run();\n"
+  }
+};
+
+static bool
+bench_run
+(
+  const bench_program_t *_program
+)
+{
+  lox_lexer_t *lexer = lox_lexer_analyze_source(_program->source, (long)strlen(_program->source));
+  if (lexer == NULL)
+  {
+    return false;
+  }
+
+  lox_vm_t *vm = lox_vm_create();
+  const double start = lox_stats_now();
+  const lox_interpret_e result = lox_vm_interpret(vm, lexer);
+  const double seconds = lox_stats_now() - start;
+  const lox_gc_stats_t gc_stats = vm->gc.stats;
+  lox_vm_clean(vm);
+  lox_lexer_clean(lexer);
+
+  printf("%-10s %8.3f s %6ld collections, %6ld minor, max pause %8.3f ms\n", _program->name, seconds,
+         gc_stats.collection_count, gc_stats.minor_collection_count, gc_stats.max_pause_seconds * 1e3);
+
+  return result == LOX_INTERPRET_OK;
+}
+
+int main(
+  int    _argc,
+  char **_argv
+)
+{
+#ifdef LOX_TAGGED_VALUES
+  printf("values: tagged union, %zu bytes\n", sizeof(lox_value_t));
+#else
+  printf("values: NaN-boxed, %zu bytes\n", sizeof(lox_value_t));
+#endif // LOX_TAGGED_VALUES
+
+  for (size_t i = 0; i < sizeof(bench_programs) / sizeof(bench_programs[0]); ++i)
+  {
+    if (_argc > 1 && strcmp(_argv[1], bench_programs[i].name) != 0)
+    {
+      continue;
+    }
+
+    if (!bench_run(&bench_programs[i]))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
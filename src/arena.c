@@ -0,0 +1,174 @@
+#include "arena.h"
+
+static size_t
+lox_arena_align
+(
+  size_t _size
+)
+{
+  return (_size + LOX_ARENA_ALIGNMENT - 1) & ~(LOX_ARENA_ALIGNMENT - 1);
+}
+
+static lox_arena_block_t
+*lox_arena_push_block
+(
+  lox_arena_t *_arena,
+  size_t       _min_capacity
+)
+{
+  size_t capacity = (_min_capacity > _arena->block_size)
+                    ? _min_capacity
+                    : _arena->block_size;
+
+  lox_arena_block_t *new_block = malloc(sizeof(lox_arena_block_t) + capacity);
+  if (new_block == NULL)
+  {
+    fprintf(stderr, "failed to allocate arena block of %zu bytes\n", capacity);
+
+    return NULL;
+  }
+  new_block->capacity = capacity;
+  new_block->used = 0;
+  new_block->next = _arena->head;
+
+  _arena->head = new_block;
+  _arena->stats.reserved_bytes += capacity;
+  ++_arena->stats.block_count;
+
+  return new_block;
+}
+
+lox_arena_t
+*lox_arena_create
+(
+  size_t _block_size
+)
+{
+  lox_arena_t *new_arena = calloc(1, sizeof(lox_arena_t));
+  if (new_arena == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for new arena\n");
+
+    return NULL;
+  }
+  new_arena->block_size = (_block_size > 0)
+                          ? lox_arena_align(_block_size)
+                          : LOX_ARENA_DEFAULT_BLOCK_SIZE;
+
+  return new_arena;
+}
+
+void
+*lox_arena_alloc
+(
+  lox_arena_t *_arena,
+  size_t       _size
+)
+{
+  if (_arena == NULL)
+  {
+    fprintf(stderr, "given arena wasn't allocated\n");
+
+    return NULL;
+  }
+
+  const size_t aligned_size = lox_arena_align((_size > 0) ? _size : 1);
+
+  lox_arena_block_t *block = _arena->head;
+  if (block == NULL || block->capacity - block->used < aligned_size)
+  {
+    block = lox_arena_push_block(_arena, aligned_size);
+    if (block == NULL)
+    {
+      return NULL;
+    }
+  }
+
+  void *memory = block->data + block->used;
+  block->used += aligned_size;
+
+  ++_arena->stats.allocation_count;
+  _arena->stats.allocated_bytes += _size;
+
+  return memory;
+}
+
+char
+*lox_arena_copy_string
+(
+  lox_arena_t *_arena,
+  const char  *_string,
+  size_t       _length
+)
+{
+  char *new_string = lox_arena_alloc(_arena, _length + 1);
+  if (new_string == NULL)
+  {
+    return NULL;
+  }
+
+  memcpy(new_string, _string, _length);
+  new_string[_length] = '\0';
+
+  return new_string;
+}
+
+void
+lox_arena_reset
+(
+  lox_arena_t *_arena
+)
+{
+  lox_arena_block_t *kept_block = _arena->head;
+  if (kept_block == NULL)
+  {
+    return;
+  }
+
+  lox_arena_block_t *current_block = kept_block->next;
+  while (current_block != NULL)
+  {
+    lox_arena_block_t *next_block = current_block->next;
+    free(current_block);
+    current_block = next_block;
+  }
+
+  kept_block->next = NULL;
+  kept_block->used = 0;
+
+  _arena->stats.allocation_count = 0;
+  _arena->stats.allocated_bytes = 0;
+  _arena->stats.reserved_bytes = kept_block->capacity;
+  _arena->stats.block_count = 1;
+}
+
+lox_arena_stats_t
+lox_arena_get_stats
+(
+  const lox_arena_t *_arena
+)
+{
+  return _arena->stats;
+}
+
+void
+lox_arena_clean
+(
+  lox_arena_t *_arena
+)
+{
+  if (_arena == NULL)
+  {
+    return;
+  }
+
+  lox_arena_block_t *current_block = _arena->head;
+  while (current_block != NULL)
+  {
+    lox_arena_block_t *next_block = current_block->next;
+    free(current_block);
+    current_block = next_block;
+  }
+
+  free(_arena);
+}
@@ -0,0 +1,82 @@
+/*
+ * Implements a bump allocator. Memory is handed out from large blocks
+ * and can only be released all at once.
+ */
+
+#ifndef LOX_ARENA_H
+#define LOX_ARENA_H
+
+#include "base.h"
+
+#define LOX_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define LOX_ARENA_ALIGNMENT          (sizeof(void *) > sizeof(double) ? sizeof(void *) : sizeof(double))
+
+typedef struct lox_arena_block_t lox_arena_block_t;
+typedef struct lox_arena_block_t
+{
+  lox_arena_block_t *next;
+  size_t             capacity;
+  size_t             used;
+  unsigned char      data[];
+} lox_arena_block_t;
+
+typedef struct lox_arena_stats_t
+{
+  size_t allocation_count;
+  size_t allocated_bytes;
+  size_t reserved_bytes;
+  size_t block_count;
+} lox_arena_stats_t;
+
+typedef struct lox_arena_t
+{
+  lox_arena_block_t *head;
+  size_t             block_size;
+
+  lox_arena_stats_t  stats;
+} lox_arena_t;
+
+lox_arena_t
+*lox_arena_create
+(
+  size_t _block_size
+);
+
+void
+*lox_arena_alloc
+(
+  lox_arena_t *_arena,
+  size_t       _size
+);
+
+char
+*lox_arena_copy_string
+(
+  lox_arena_t *_arena,
+  const char  *_string,
+  size_t       _length
+);
+
+/*
+ * Releases every allocation at once but keeps the most recent block
+ * around for reuse.
+ */
+void
+lox_arena_reset
+(
+  lox_arena_t *_arena
+);
+
+lox_arena_stats_t
+lox_arena_get_stats
+(
+  const lox_arena_t *_arena
+);
+
+void
+lox_arena_clean
+(
+  lox_arena_t *_arena
+);
+
+#endif // LOX_ARENA_H
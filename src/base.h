@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 #endif // LOX_BASE_H
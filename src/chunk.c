@@ -0,0 +1,259 @@
+#include "chunk.h"
+#include "memory.h"
+#include "object.h"
+
+void
+lox_chunk_init
+(
+  lox_chunk_t *_chunk
+)
+{
+  _chunk->code = NULL;
+  _chunk->count = 0;
+  _chunk->capacity = 0;
+  lox_value_array_init(&_chunk->constants);
+  _chunk->lines = NULL;
+  _chunk->line_count = 0;
+  _chunk->line_capacity = 0;
+}
+
+void
+lox_chunk_write
+(
+  lox_chunk_t *_chunk,
+  uint8_t      _byte,
+  long         _line
+)
+{
+  if (_chunk->count == _chunk->capacity)
+  {
+    _chunk->capacity = LOX_GROW_CAPACITY(_chunk->capacity);
+    _chunk->code = lox_reallocate(_chunk->code, _chunk->capacity);
+  }
+  _chunk->code[_chunk->count] = _byte;
+
+  if (_chunk->line_count == 0 || _chunk->lines[_chunk->line_count - 1].line != (uint32_t)_line)
+  {
+    if (_chunk->line_count == _chunk->line_capacity)
+    {
+      _chunk->line_capacity = LOX_GROW_CAPACITY(_chunk->line_capacity);
+      _chunk->lines = lox_reallocate(_chunk->lines, _chunk->line_capacity * sizeof(lox_line_run_t));
+    }
+    _chunk->lines[_chunk->line_count++] = (lox_line_run_t){
+      .offset = (uint32_t)_chunk->count,
+      .line = (uint32_t)_line
+    };
+  }
+
+  ++_chunk->count;
+}
+
+long
+lox_chunk_add_constant
+(
+  lox_chunk_t *_chunk,
+  lox_value_t  _value
+)
+{
+  return lox_value_array_push(&_chunk->constants, _value);
+}
+
+long
+lox_chunk_get_line
+(
+  const lox_chunk_t *_chunk,
+  long               _offset
+)
+{
+  if (_chunk->line_count == 0)
+  {
+    return 0;
+  }
+
+  // Last run starting at or before _offset
+  long low = 0;
+  long high = _chunk->line_count - 1;
+  while (low < high)
+  {
+    const long middle = low + (high - low + 1) / 2;
+    if ((long)_chunk->lines[middle].offset <= _offset)
+    {
+      low = middle;
+    }
+    else
+    {
+      high = middle - 1;
+    }
+  }
+
+  return _chunk->lines[low].line;
+}
+
+int
+lox_opcode_stack_effect
+(
+  lox_opcode_e _opcode
+)
+{
+#define LOX_OPCODE_EFFECT(_name, _effect) _effect,
+  static const int effects[LOX_OP_COUNT] = { LOX_OPCODES(LOX_OPCODE_EFFECT) };
+#undef LOX_OPCODE_EFFECT
+
+  return effects[_opcode];
+}
+
+const char
+*lox_opcode_name
+(
+  lox_opcode_e _opcode
+)
+{
+#define LOX_OPCODE_NAME(_name, _effect) #_name,
+  static const char *const names[LOX_OP_COUNT] = { LOX_OPCODES(LOX_OPCODE_NAME) };
+#undef LOX_OPCODE_NAME
+
+  return (_opcode < LOX_OP_COUNT) ? names[_opcode] : "INVALID";
+}
+
+static uint16_t
+lox_chunk_read_short
+(
+  const lox_chunk_t *_chunk,
+  long               _offset
+)
+{
+  return (uint16_t)(_chunk->code[_offset] << 8 | _chunk->code[_offset + 1]);
+}
+
+static void
+lox_chunk_debug_constant
+(
+  const lox_chunk_t *_chunk,
+  uint16_t           _constant
+)
+{
+  printf("%5u '", _constant);
+  lox_value_print(stdout, _chunk->constants.values[_constant]);
+  printf("'");
+}
+
+long
+lox_chunk_debug_instruction
+(
+  const lox_chunk_t *_chunk,
+  long               _offset
+)
+{
+  const long line = lox_chunk_get_line(_chunk, _offset);
+  if (_offset > 0 && line == lox_chunk_get_line(_chunk, _offset - 1))
+  {
+    printf("%04ld    | ", _offset);
+  }
+  else
+  {
+    printf("%04ld %4ld ", _offset, line);
+  }
+
+  const lox_opcode_e opcode = _chunk->code[_offset];
+  printf("%-14s", lox_opcode_name(opcode));
+  switch (opcode)
+  {
+    case LOX_OP_CONSTANT:
+    case LOX_OP_GET_GLOBAL:
+    case LOX_OP_DEFINE_GLOBAL:
+    case LOX_OP_SET_GLOBAL:
+    case LOX_OP_GET_PROPERTY:
+    case LOX_OP_SET_PROPERTY:
+    case LOX_OP_GET_SUPER:
+    case LOX_OP_CLASS:
+    case LOX_OP_METHOD:
+      lox_chunk_debug_constant(_chunk, lox_chunk_read_short(_chunk, _offset + 1));
+      printf("\n");
+
+      return _offset + 3;
+    case LOX_OP_GET_LOCAL:
+    case LOX_OP_SET_LOCAL:
+    case LOX_OP_GET_UPVALUE:
+    case LOX_OP_SET_UPVALUE:
+    case LOX_OP_CALL:
+      printf("%5u\n", _chunk->code[_offset + 1]);
+
+      return _offset + 2;
+    case LOX_OP_JUMP:
+    case LOX_OP_JUMP_IF_FALSE:
+    case LOX_OP_LOOP:
+    {
+      const long distance = lox_chunk_read_short(_chunk, _offset + 1);
+      const long target = (opcode == LOX_OP_LOOP) ? _offset + 3 - distance : _offset + 3 + distance;
+      printf("%5ld -> %ld\n", _offset, target);
+
+      return _offset + 3;
+    }
+    case LOX_OP_INVOKE:
+    case LOX_OP_SUPER_INVOKE:
+      lox_chunk_debug_constant(_chunk, lox_chunk_read_short(_chunk, _offset + 1));
+      printf(" (%u args)\n", _chunk->code[_offset + 3]);
+
+      return _offset + 4;
+    case LOX_OP_CLOSURE:
+    {
+      const uint16_t constant = lox_chunk_read_short(_chunk, _offset + 1);
+      lox_chunk_debug_constant(_chunk, constant);
+      printf("\n");
+
+      long offset = _offset + 3;
+      const lox_function_t *function =
+        (const lox_function_t *)lox_value_as_object(_chunk->constants.values[constant]);
+      for (int i = 0; i < function->upvalue_count; ++i)
+      {
+        printf("%04ld    |                     %s %u\n", offset,
+               _chunk->code[offset] ? "local" : "upvalue", _chunk->code[offset + 1]);
+        offset += 2;
+      }
+
+      return offset;
+    }
+    default:
+      printf("\n");
+
+      return _offset + 1;
+  }
+}
+
+void
+lox_chunk_debug
+(
+  const lox_chunk_t *_chunk,
+  const char        *_name
+)
+{
+  printf("== %s ==\n", _name);
+  for (long offset = 0; offset < _chunk->count;)
+  {
+    offset = lox_chunk_debug_instruction(_chunk, offset);
+  }
+
+  for (long i = 0; i < _chunk->constants.count; ++i)
+  {
+    const lox_value_t constant = _chunk->constants.values[i];
+    if (lox_value_is_object(constant) &&
+        lox_value_as_object(constant)->type == LOX_OBJECT_FUNCTION)
+    {
+      const lox_function_t *function = (const lox_function_t *)lox_value_as_object(constant);
+      printf("\n");
+      lox_chunk_debug(&function->chunk, function->name->chars);
+    }
+  }
+}
+
+void
+lox_chunk_clean
+(
+  lox_chunk_t *_chunk
+)
+{
+  lox_reallocate(_chunk->code, 0);
+  lox_reallocate(_chunk->lines, 0);
+  lox_value_array_clean(&_chunk->constants);
+  lox_chunk_init(_chunk);
+}
@@ -0,0 +1,184 @@
+/*
+ * Implements chunks of bytecode, what the compiler turns a function
+ * into and the VM runs.
+ *
+ * Every instruction is a one-byte opcode followed by its operands.
+ * Constants, globals and property names are referenced by a 16-bit
+ * index into the chunk's constant pool, jumps by a 16-bit distance,
+ * locals and upvalues by an 8-bit slot. Lines are kept in a separate
+ * run-length table, only looked up when an error is reported.
+ */
+
+#ifndef LOX_CHUNK_H
+#define LOX_CHUNK_H
+
+#include "base.h"
+#include "value.h"
+
+#define LOX_CHUNK_MAX_CONSTANTS (UINT16_MAX + 1)
+#define LOX_CHUNK_MAX_JUMP      UINT16_MAX
+
+/*
+ * Every opcode with its operands and its effect on the stack height.
+ * The effect of CALL, INVOKE and SUPER_INVOKE also depends on their
+ * argument count, the compiler adds that itself.
+ */
+#define LOX_OPCODES(X)                                              \
+  X(CONSTANT,       1)  /* u16 constant */                          \
+  X(NIL,            1)                                              \
+  X(TRUE,           1)                                              \
+  X(FALSE,          1)                                              \
+  X(POP,           -1)                                              \
+  X(GET_LOCAL,      1)  /* u8 slot */                               \
+  X(SET_LOCAL,      0)  /* u8 slot */                               \
+  X(GET_GLOBAL,     1)  /* u16 name */                              \
+  X(DEFINE_GLOBAL, -1)  /* u16 name */                              \
+  X(SET_GLOBAL,     0)  /* u16 name */                              \
+  X(GET_UPVALUE,    1)  /* u8 slot */                               \
+  X(SET_UPVALUE,    0)  /* u8 slot */                               \
+  X(GET_PROPERTY,   0)  /* u16 name */                              \
+  X(SET_PROPERTY,  -1)  /* u16 name */                              \
+  X(GET_SUPER,     -1)  /* u16 name */                              \
+  X(EQUAL,         -1)                                              \
+  X(GREATER,       -1)                                              \
+  X(LESS,          -1)                                              \
+  X(ADD,           -1)                                              \
+  X(SUBTRACT,      -1)                                              \
+  X(MULTIPLY,      -1)                                              \
+  X(DIVIDE,        -1)                                              \
+  X(NOT,            0)                                              \
+  X(NEGATE,         0)                                              \
+  X(PRINT,         -1)                                              \
+  X(JUMP,           0)  /* u16 forward distance */                  \
+  X(JUMP_IF_FALSE,  0)  /* u16 forward distance, keeps condition */ \
+  X(LOOP,           0)  /* u16 backward distance */                 \
+  X(CALL,           0)  /* u8 argument count */                     \
+  X(INVOKE,         0)  /* u16 name, u8 argument count */           \
+  X(SUPER_INVOKE,  -1)  /* u16 name, u8 argument count */           \
+  X(CLOSURE,        1)  /* u16 function, u8 is_local, u8 index per upvalue */ \
+  X(CLOSE_UPVALUE, -1)                                              \
+  X(RETURN,        -1)                                              \
+  X(CLASS,          1)  /* u16 name */                              \
+  X(INHERIT,       -1)                                              \
+  X(METHOD,        -1)  /* u16 name */
+
+#define LOX_OPCODE_ENUM(_name, _effect) LOX_OP_##_name,
+
+typedef enum lox_opcode_e
+{
+  LOX_OPCODES(LOX_OPCODE_ENUM)
+
+  LOX_OP_COUNT
+} lox_opcode_e;
+
+#undef LOX_OPCODE_ENUM
+
+/*
+ * Instructions from offset on were compiled from line, up to the
+ * offset of the next run.
+ */
+typedef struct lox_line_run_t
+{
+  uint32_t offset;
+  uint32_t line;
+} lox_line_run_t;
+
+typedef struct lox_chunk_t
+{
+  uint8_t           *code;
+  long               count;
+  long               capacity;
+
+  lox_value_array_t  constants;
+
+  lox_line_run_t    *lines;
+  long               line_count;
+  long               line_capacity;
+} lox_chunk_t;
+
+void
+lox_chunk_init
+(
+  lox_chunk_t *_chunk
+);
+
+/*
+ * Appends _byte, compiled from _line.
+ */
+void
+lox_chunk_write
+(
+  lox_chunk_t *_chunk,
+  uint8_t      _byte,
+  long         _line
+);
+
+/*
+ * Adds _value to the constant pool and returns its index, which may be
+ * LOX_CHUNK_MAX_CONSTANTS or more and then can't be encoded.
+ */
+long
+lox_chunk_add_constant
+(
+  lox_chunk_t *_chunk,
+  lox_value_t  _value
+);
+
+/*
+ * Line the instruction at _offset was compiled from.
+ */
+long
+lox_chunk_get_line
+(
+  const lox_chunk_t *_chunk,
+  long               _offset
+);
+
+/*
+ * Effect of _opcode on the height of the stack, see LOX_OPCODES.
+ */
+int
+lox_opcode_stack_effect
+(
+  lox_opcode_e _opcode
+);
+
+/*
+ * Name of _opcode as spelled in lox_opcode_e, without the LOX_OP_
+ * prefix.
+ */
+const char
+*lox_opcode_name
+(
+  lox_opcode_e _opcode
+);
+
+/*
+ * Prints the instruction at _offset on stdout and returns the offset
+ * of the next one.
+ */
+long
+lox_chunk_debug_instruction
+(
+  const lox_chunk_t *_chunk,
+  long               _offset
+);
+
+/*
+ * Prints every instruction of _chunk under _name, then the chunks of
+ * the functions in its constant pool.
+ */
+void
+lox_chunk_debug
+(
+  const lox_chunk_t *_chunk,
+  const char        *_name
+);
+
+void
+lox_chunk_clean
+(
+  lox_chunk_t *_chunk
+);
+
+#endif // LOX_CHUNK_H
@@ -0,0 +1,1743 @@
+#include "compiler.h"
+#include "vm.h"
+
+// Names of the hidden locals, no identifier is interned with these ids
+#define LOX_COMPILER_NO_NAME    LOX_INTERN_INVALID_ID
+#define LOX_COMPILER_THIS_NAME  (LOX_INTERN_INVALID_ID - 1)
+#define LOX_COMPILER_SUPER_NAME (LOX_INTERN_INVALID_ID - 2)
+
+typedef enum lox_function_e
+{
+  LOX_FUNCTION_SCRIPT,
+  LOX_FUNCTION_FUNCTION,
+  LOX_FUNCTION_METHOD,
+  LOX_FUNCTION_INITIALIZER
+} lox_function_e;
+
+/*
+ * depth is -1 from the declaration of a local until its initializer
+ * has been compiled, so the initializer can't read it.
+ */
+typedef struct lox_local_t
+{
+  lox_intern_id_t name;
+  int             depth;
+  bool            is_captured;
+} lox_local_t;
+
+typedef struct lox_upvalue_ref_t
+{
+  uint8_t index;
+  // Captures a local of the enclosing function rather than one of its
+  // upvalues
+  bool    is_local;
+} lox_upvalue_ref_t;
+
+/*
+ * State of a function being compiled, the enclosing ones are reached
+ * through enclosing.
+ */
+typedef struct lox_function_scope_t lox_function_scope_t;
+struct lox_function_scope_t
+{
+  lox_function_scope_t *enclosing;
+  lox_function_t       *function;
+  lox_function_e        type;
+
+  lox_local_t           locals[LOX_COMPILER_MAX_LOCALS];
+  int                   local_count;
+  lox_upvalue_ref_t     upvalues[LOX_COMPILER_MAX_UPVALUES];
+  int                   scope_depth;
+
+  // Height of the stack after the code emitted so far, which the
+  // function's max_slots is the highest of
+  int                   stack_height;
+  // Constant of every name used, so each is stored once
+  lox_table_t           name_constants;
+};
+
+typedef struct lox_class_scope_t lox_class_scope_t;
+struct lox_class_scope_t
+{
+  lox_class_scope_t *enclosing;
+  bool               has_superclass;
+};
+
+typedef struct lox_compiler_t
+{
+  lox_vm_t             *vm;
+  lox_lexer_t          *lexer;
+  const lox_token_t    *tokens;
+  // Index of the next token, never past EOF, and of the last consumed
+  long                  current;
+  long                  previous;
+
+  lox_function_scope_t *function;
+  lox_class_scope_t    *class_;
+
+  // Line of the token at line_token, located once for all the code it
+  // emits
+  long                  line;
+  long                  line_token;
+
+  int                   depth;
+  bool                  had_error;
+  bool                  is_panicking;
+} lox_compiler_t;
+
+typedef enum lox_precedence_e
+{
+  LOX_PRECEDENCE_NONE,
+  LOX_PRECEDENCE_ASSIGNMENT,  // =
+  LOX_PRECEDENCE_OR,          // or
+  LOX_PRECEDENCE_AND,         // and
+  LOX_PRECEDENCE_EQUALITY,    // == !=
+  LOX_PRECEDENCE_COMPARISON,  // < > <= >=
+  LOX_PRECEDENCE_TERM,        // + -
+  LOX_PRECEDENCE_FACTOR,      // * /
+  LOX_PRECEDENCE_UNARY,       // ! -
+  LOX_PRECEDENCE_CALL,        // . ()
+  LOX_PRECEDENCE_PRIMARY
+} lox_precedence_e;
+
+/*
+ * Both get the token that selected the rule as previous.
+ */
+typedef void (*lox_compile_fn)(lox_compiler_t *_compiler, bool _can_assign);
+
+typedef struct lox_compile_rule_t
+{
+  lox_compile_fn   prefix;
+  lox_compile_fn   infix;
+  lox_precedence_e precedence;
+} lox_compile_rule_t;
+
+static const lox_compile_rule_t
+*lox_compiler_get_rule
+(
+  lox_token_e _type
+);
+
+static void
+lox_compiler_expression
+(
+  lox_compiler_t *_compiler
+);
+
+static void
+lox_compiler_statement
+(
+  lox_compiler_t *_compiler
+);
+
+static void
+lox_compiler_declaration
+(
+  lox_compiler_t *_compiler
+);
+
+static lox_token_e
+lox_compiler_peek
+(
+  const lox_compiler_t *_compiler
+)
+{
+  return _compiler->tokens[_compiler->current].type;
+}
+
+static bool
+lox_compiler_check
+(
+  const lox_compiler_t *_compiler,
+  lox_token_e           _type
+)
+{
+  return lox_compiler_peek(_compiler) == _type;
+}
+
+static void
+lox_compiler_advance
+(
+  lox_compiler_t *_compiler
+)
+{
+  _compiler->previous = _compiler->current;
+  if (_compiler->tokens[_compiler->current].type != LOX_EOF)
+  {
+    ++_compiler->current;
+  }
+}
+
+static bool
+lox_compiler_match
+(
+  lox_compiler_t *_compiler,
+  lox_token_e     _type
+)
+{
+  if (!lox_compiler_check(_compiler, _type))
+  {
+    return false;
+  }
+  lox_compiler_advance(_compiler);
+
+  return true;
+}
+
+/*
+ * Reports the first error of a statement, the ones that follow from it
+ * are dropped until the compiler has resynchronized.
+ */
+static void
+lox_compiler_error_at
+(
+  lox_compiler_t *_compiler,
+  long            _token,
+  const char     *_message
+)
+{
+  if (_compiler->is_panicking)
+  {
+    return;
+  }
+  _compiler->is_panicking = true;
+  _compiler->had_error = true;
+
+  const lox_token_t *token = &_compiler->tokens[_token];
+  if (token->type == LOX_EOF)
+  {
+    lox_lexer_report(_compiler->lexer, token->offset, "error at end: %s", _message);
+
+    return;
+  }
+
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_compiler->lexer, token);
+  lox_lexer_report(_compiler->lexer, token->offset, "error at '%.*s': %s",
+                   (int)lexeme.length, lexeme.data, _message);
+}
+
+static void
+lox_compiler_error
+(
+  lox_compiler_t *_compiler,
+  const char     *_message
+)
+{
+  lox_compiler_error_at(_compiler, _compiler->previous, _message);
+}
+
+static void
+lox_compiler_consume
+(
+  lox_compiler_t *_compiler,
+  lox_token_e     _type,
+  const char     *_message
+)
+{
+  if (lox_compiler_check(_compiler, _type))
+  {
+    lox_compiler_advance(_compiler);
+
+    return;
+  }
+
+  lox_compiler_error_at(_compiler, _compiler->current, _message);
+}
+
+/*
+ * Counts one more level of nesting, reporting an error and returning
+ * false when there are too many for the stack. Nothing after that point
+ * can be read in its right context, so it skips to the end of the source
+ * and stays panicking rather than report what the truncation breaks.
+ */
+static bool
+lox_compiler_enter
+(
+  lox_compiler_t *_compiler
+)
+{
+  if (++_compiler->depth > LOX_COMPILER_MAX_DEPTH)
+  {
+    lox_compiler_error_at(_compiler, _compiler->current, "Code nests too deeply.");
+    _compiler->current = _compiler->lexer->token_count - 1;
+    --_compiler->depth;
+
+    return false;
+  }
+
+  return true;
+}
+
+static lox_chunk_t
+*lox_compiler_chunk
+(
+  lox_compiler_t *_compiler
+)
+{
+  return &_compiler->function->function->chunk;
+}
+
+static void
+lox_compiler_emit_byte
+(
+  lox_compiler_t *_compiler,
+  uint8_t         _byte
+)
+{
+  if (_compiler->line_token != _compiler->previous)
+  {
+    _compiler->line_token = _compiler->previous;
+    _compiler->line = lox_lexer_locate(_compiler->lexer,
+                                       _compiler->tokens[_compiler->previous].offset).line;
+  }
+
+  lox_chunk_write(lox_compiler_chunk(_compiler), _byte, _compiler->line);
+}
+
+static void
+lox_compiler_emit_short
+(
+  lox_compiler_t *_compiler,
+  uint16_t        _value
+)
+{
+  lox_compiler_emit_byte(_compiler, (uint8_t)(_value >> 8));
+  lox_compiler_emit_byte(_compiler, (uint8_t)_value);
+}
+
+static void
+lox_compiler_adjust_stack
+(
+  lox_compiler_t *_compiler,
+  int             _effect
+)
+{
+  lox_function_scope_t *scope = _compiler->function;
+  scope->stack_height += _effect;
+  if (scope->stack_height > scope->function->max_slots)
+  {
+    scope->function->max_slots = scope->stack_height;
+  }
+}
+
+static void
+lox_compiler_emit_op
+(
+  lox_compiler_t *_compiler,
+  lox_opcode_e    _opcode
+)
+{
+  lox_compiler_emit_byte(_compiler, (uint8_t)_opcode);
+  lox_compiler_adjust_stack(_compiler, lox_opcode_stack_effect(_opcode));
+}
+
+static void
+lox_compiler_emit_op_byte
+(
+  lox_compiler_t *_compiler,
+  lox_opcode_e    _opcode,
+  uint8_t         _operand
+)
+{
+  lox_compiler_emit_op(_compiler, _opcode);
+  lox_compiler_emit_byte(_compiler, _operand);
+}
+
+static void
+lox_compiler_emit_op_short
+(
+  lox_compiler_t *_compiler,
+  lox_opcode_e    _opcode,
+  uint16_t        _operand
+)
+{
+  lox_compiler_emit_op(_compiler, _opcode);
+  lox_compiler_emit_short(_compiler, _operand);
+}
+
+/*
+ * Emits a jump with a placeholder distance and returns where the
+ * distance goes, for lox_compiler_patch_jump.
+ */
+static long
+lox_compiler_emit_jump
+(
+  lox_compiler_t *_compiler,
+  lox_opcode_e    _opcode
+)
+{
+  lox_compiler_emit_op_short(_compiler, _opcode, UINT16_MAX);
+
+  return lox_compiler_chunk(_compiler)->count - 2;
+}
+
+/*
+ * Points the jump at _offset to the next instruction emitted.
+ */
+static void
+lox_compiler_patch_jump
+(
+  lox_compiler_t *_compiler,
+  long            _offset
+)
+{
+  lox_chunk_t *chunk = lox_compiler_chunk(_compiler);
+  const long distance = chunk->count - _offset - 2;
+  if (distance > LOX_CHUNK_MAX_JUMP)
+  {
+    lox_compiler_error(_compiler, "Too much code to jump over.");
+  }
+
+  chunk->code[_offset] = (uint8_t)(distance >> 8);
+  chunk->code[_offset + 1] = (uint8_t)distance;
+}
+
+static void
+lox_compiler_emit_loop
+(
+  lox_compiler_t *_compiler,
+  long            _loop_start
+)
+{
+  lox_compiler_emit_op(_compiler, LOX_OP_LOOP);
+
+  const long distance = lox_compiler_chunk(_compiler)->count - _loop_start + 2;
+  if (distance > LOX_CHUNK_MAX_JUMP)
+  {
+    lox_compiler_error(_compiler, "Loop body too large.");
+  }
+  lox_compiler_emit_short(_compiler, (uint16_t)distance);
+}
+
+/*
+ * What a function returns when it runs off its end, the instance for
+ * initializers and nil otherwise.
+ */
+static void
+lox_compiler_emit_return
+(
+  lox_compiler_t *_compiler
+)
+{
+  if (_compiler->function->type == LOX_FUNCTION_INITIALIZER)
+  {
+    lox_compiler_emit_op_byte(_compiler, LOX_OP_GET_LOCAL, 0);
+  }
+  else
+  {
+    lox_compiler_emit_op(_compiler, LOX_OP_NIL);
+  }
+  lox_compiler_emit_op(_compiler, LOX_OP_RETURN);
+}
+
+static uint16_t
+lox_compiler_make_constant
+(
+  lox_compiler_t *_compiler,
+  lox_value_t     _value
+)
+{
+  lox_gc_barrier(&_compiler->vm->gc, &_compiler->function->function->object, _value);
+  const long constant = lox_chunk_add_constant(lox_compiler_chunk(_compiler), _value);
+  if (constant >= LOX_CHUNK_MAX_CONSTANTS)
+  {
+    lox_compiler_error(_compiler, "Too many constants in one chunk.");
+
+    return 0;
+  }
+
+  return (uint16_t)constant;
+}
+
+static void
+lox_compiler_emit_constant
+(
+  lox_compiler_t *_compiler,
+  lox_value_t     _value
+)
+{
+  lox_compiler_emit_op_short(_compiler, LOX_OP_CONSTANT, lox_compiler_make_constant(_compiler, _value));
+}
+
+/*
+ * Constant holding the name of the identifier at _token, shared by
+ * every use of the name in the function.
+ */
+static uint16_t
+lox_compiler_identifier_constant
+(
+  lox_compiler_t *_compiler,
+  long            _token
+)
+{
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_compiler->lexer, &_compiler->tokens[_token]);
+  lox_string_t *name = lox_string_copy(_compiler->vm, lexeme.data, lexeme.length);
+
+  lox_table_t *name_constants = &_compiler->function->name_constants;
+  lox_value_t constant;
+  if (lox_table_get(name_constants, name, &constant))
+  {
+    return (uint16_t)lox_value_as_number(constant);
+  }
+
+  const uint16_t new_constant = lox_compiler_make_constant(_compiler,
+                                                           lox_value_object(&name->object));
+  lox_table_set(name_constants, name, lox_value_number(new_constant));
+
+  return new_constant;
+}
+
+/*
+ * Identifiers are compared by their interned id, see identifier.h.
+ */
+static lox_intern_id_t
+lox_compiler_name_id
+(
+  lox_compiler_t *_compiler,
+  long            _token
+)
+{
+  const lox_token_t *token = &_compiler->tokens[_token];
+  if (token->literal_kind == LOX_LITERAL_INTERNED)
+  {
+    return token->literal.id;
+  }
+
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_compiler->lexer, token);
+
+  return lox_intern(_compiler->lexer->interner, lexeme.data, lexeme.length);
+}
+
+static void
+lox_compiler_begin_function
+(
+  lox_compiler_t       *_compiler,
+  lox_function_scope_t *_scope,
+  lox_function_e        _type
+)
+{
+  _scope->enclosing = _compiler->function;
+  _scope->type = _type;
+  _scope->local_count = 0;
+  _scope->scope_depth = 0;
+  _scope->stack_height = 0;
+  lox_table_init(&_scope->name_constants);
+  _scope->function = lox_function_create(_compiler->vm);
+  _compiler->function = _scope;
+  // On the stack until it is done, for the collector to see
+  lox_vm_push(_compiler->vm, lox_value_object(&_scope->function->object));
+
+  if (_type != LOX_FUNCTION_SCRIPT)
+  {
+    lox_string_view_t lexeme = lox_lexer_token_lexeme(_compiler->lexer,
+                                                      &_compiler->tokens[_compiler->previous]);
+    lox_string_t *name = lox_string_copy(_compiler->vm, lexeme.data, lexeme.length);
+    lox_gc_barrier(&_compiler->vm->gc, &_scope->function->object, lox_value_object(&name->object));
+    _scope->function->name = name;
+  }
+
+  // Slot 0 holds the receiver in methods and the closure otherwise
+  lox_local_t *local = &_scope->locals[_scope->local_count++];
+  local->depth = 0;
+  local->is_captured = false;
+  local->name = (_type == LOX_FUNCTION_METHOD || _type == LOX_FUNCTION_INITIALIZER)
+                ? LOX_COMPILER_THIS_NAME
+                : LOX_COMPILER_NO_NAME;
+  lox_compiler_adjust_stack(_compiler, 1);
+}
+
+static lox_function_t
+*lox_compiler_end_function
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_emit_return(_compiler);
+
+  lox_function_scope_t *scope = _compiler->function;
+  lox_table_clean(&scope->name_constants);
+  _compiler->function = scope->enclosing;
+  lox_vm_pop(_compiler->vm);
+
+  return scope->function;
+}
+
+static void
+lox_compiler_begin_scope
+(
+  lox_compiler_t *_compiler
+)
+{
+  ++_compiler->function->scope_depth;
+}
+
+static void
+lox_compiler_end_scope
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_function_scope_t *scope = _compiler->function;
+  --scope->scope_depth;
+
+  while (scope->local_count > 0 && scope->locals[scope->local_count - 1].depth > scope->scope_depth)
+  {
+    lox_compiler_emit_op(_compiler, scope->locals[scope->local_count - 1].is_captured
+                                    ? LOX_OP_CLOSE_UPVALUE
+                                    : LOX_OP_POP);
+    --scope->local_count;
+  }
+}
+
+static int
+lox_compiler_resolve_local
+(
+  lox_compiler_t       *_compiler,
+  lox_function_scope_t *_scope,
+  lox_intern_id_t       _name
+)
+{
+  for (int i = _scope->local_count - 1; i >= 0; --i)
+  {
+    const lox_local_t *local = &_scope->locals[i];
+    if (local->name == _name)
+    {
+      if (local->depth == -1)
+      {
+        lox_compiler_error(_compiler, "Can't read local variable in its own initializer.");
+      }
+
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static int
+lox_compiler_add_upvalue
+(
+  lox_compiler_t       *_compiler,
+  lox_function_scope_t *_scope,
+  uint8_t               _index,
+  bool                  _is_local
+)
+{
+  const int upvalue_count = _scope->function->upvalue_count;
+  for (int i = 0; i < upvalue_count; ++i)
+  {
+    const lox_upvalue_ref_t *upvalue = &_scope->upvalues[i];
+    if (upvalue->index == _index && upvalue->is_local == _is_local)
+    {
+      return i;
+    }
+  }
+
+  if (upvalue_count == LOX_COMPILER_MAX_UPVALUES)
+  {
+    lox_compiler_error(_compiler, "Too many closure variables in function.");
+
+    return 0;
+  }
+
+  _scope->upvalues[upvalue_count].is_local = _is_local;
+  _scope->upvalues[upvalue_count].index = _index;
+
+  return _scope->function->upvalue_count++;
+}
+
+/*
+ * Finds _name among the variables of the functions enclosing _scope,
+ * capturing it in each function in between. Returns -1 for globals.
+ */
+static int
+lox_compiler_resolve_upvalue
+(
+  lox_compiler_t       *_compiler,
+  lox_function_scope_t *_scope,
+  lox_intern_id_t       _name
+)
+{
+  if (_scope->enclosing == NULL)
+  {
+    return -1;
+  }
+
+  const int local = lox_compiler_resolve_local(_compiler, _scope->enclosing, _name);
+  if (local != -1)
+  {
+    _scope->enclosing->locals[local].is_captured = true;
+
+    return lox_compiler_add_upvalue(_compiler, _scope, (uint8_t)local, true);
+  }
+
+  const int upvalue = lox_compiler_resolve_upvalue(_compiler, _scope->enclosing, _name);
+  if (upvalue != -1)
+  {
+    return lox_compiler_add_upvalue(_compiler, _scope, (uint8_t)upvalue, false);
+  }
+
+  return -1;
+}
+
+static void
+lox_compiler_add_local
+(
+  lox_compiler_t  *_compiler,
+  lox_intern_id_t  _name
+)
+{
+  lox_function_scope_t *scope = _compiler->function;
+  if (scope->local_count == LOX_COMPILER_MAX_LOCALS)
+  {
+    lox_compiler_error(_compiler, "Too many local variables in function.");
+
+    return;
+  }
+
+  lox_local_t *local = &scope->locals[scope->local_count++];
+  local->name = _name;
+  local->depth = -1;
+  local->is_captured = false;
+}
+
+/*
+ * Declares the variable named by the previous token as a local, unless
+ * at the top level where variables are global.
+ */
+static void
+lox_compiler_declare_variable
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_function_scope_t *scope = _compiler->function;
+  if (scope->scope_depth == 0)
+  {
+    return;
+  }
+
+  const lox_intern_id_t name = lox_compiler_name_id(_compiler, _compiler->previous);
+  for (int i = scope->local_count - 1; i >= 0; --i)
+  {
+    const lox_local_t *local = &scope->locals[i];
+    if (local->depth != -1 && local->depth < scope->scope_depth)
+    {
+      break;
+    }
+
+    if (local->name == name)
+    {
+      lox_compiler_error(_compiler, "Already a variable with this name in this scope.");
+    }
+  }
+
+  lox_compiler_add_local(_compiler, name);
+}
+
+/*
+ * Consumes a variable name and declares it. Returns the constant of
+ * its name for globals, 0 for locals which don't need one.
+ */
+static uint16_t
+lox_compiler_parse_variable
+(
+  lox_compiler_t *_compiler,
+  const char     *_message
+)
+{
+  lox_compiler_consume(_compiler, LOX_IDENTIFIER, _message);
+
+  lox_compiler_declare_variable(_compiler);
+  if (_compiler->function->scope_depth > 0)
+  {
+    return 0;
+  }
+
+  return lox_compiler_identifier_constant(_compiler, _compiler->previous);
+}
+
+static void
+lox_compiler_mark_initialized
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_function_scope_t *scope = _compiler->function;
+  if (scope->scope_depth == 0)
+  {
+    return;
+  }
+  scope->locals[scope->local_count - 1].depth = scope->scope_depth;
+}
+
+/*
+ * Makes the variable declared last usable, its value is on top of the
+ * stack. Locals simply stay there.
+ */
+static void
+lox_compiler_define_variable
+(
+  lox_compiler_t *_compiler,
+  uint16_t        _global
+)
+{
+  if (_compiler->function->scope_depth > 0)
+  {
+    lox_compiler_mark_initialized(_compiler);
+
+    return;
+  }
+
+  lox_compiler_emit_op_short(_compiler, LOX_OP_DEFINE_GLOBAL, _global);
+}
+
+static uint8_t
+lox_compiler_argument_list
+(
+  lox_compiler_t *_compiler
+)
+{
+  int argument_count = 0;
+  if (!lox_compiler_check(_compiler, LOX_RIGHT_PAREN))
+  {
+    do
+    {
+      lox_compiler_expression(_compiler);
+      if (argument_count == LOX_COMPILER_MAX_ARGUMENTS)
+      {
+        lox_compiler_error(_compiler, "Can't have more than 255 arguments.");
+      }
+      ++argument_count;
+    } while (lox_compiler_match(_compiler, LOX_COMMA));
+  }
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after arguments.");
+
+  return (uint8_t)argument_count;
+}
+
+static void
+lox_compiler_parse_precedence
+(
+  lox_compiler_t   *_compiler,
+  lox_precedence_e  _precedence
+)
+{
+  if (!lox_compiler_enter(_compiler))
+  {
+    return;
+  }
+
+  lox_compiler_advance(_compiler);
+  lox_compile_fn prefix = lox_compiler_get_rule(_compiler->tokens[_compiler->previous].type)->prefix;
+  if (prefix == NULL)
+  {
+    lox_compiler_error(_compiler, "Expect expression.");
+    --_compiler->depth;
+
+    return;
+  }
+
+  const bool can_assign = _precedence <= LOX_PRECEDENCE_ASSIGNMENT;
+  prefix(_compiler, can_assign);
+  while (_precedence <= lox_compiler_get_rule(lox_compiler_peek(_compiler))->precedence)
+  {
+    lox_compiler_advance(_compiler);
+    lox_compiler_get_rule(_compiler->tokens[_compiler->previous].type)->infix(_compiler, can_assign);
+  }
+
+  if (can_assign && lox_compiler_match(_compiler, LOX_EQUAL))
+  {
+    lox_compiler_error(_compiler, "Invalid assignment target.");
+  }
+  --_compiler->depth;
+}
+
+static void
+lox_compiler_expression
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_parse_precedence(_compiler, LOX_PRECEDENCE_ASSIGNMENT);
+}
+
+static void
+lox_compiler_number
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_token_t *token = &_compiler->tokens[_compiler->previous];
+  lox_compiler_emit_constant(_compiler, lox_value_number(token->literal.number));
+}
+
+static void
+lox_compiler_string
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  lox_string_view_t body = lox_lexer_token_string(_compiler->lexer,
+                                                  &_compiler->tokens[_compiler->previous]);
+  lox_string_t *string = lox_string_copy(_compiler->vm, body.data, body.length);
+  lox_compiler_emit_constant(_compiler, lox_value_object(&string->object));
+}
+
+static void
+lox_compiler_literal
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  switch (_compiler->tokens[_compiler->previous].type)
+  {
+    case LOX_FALSE:
+      lox_compiler_emit_op(_compiler, LOX_OP_FALSE);
+
+      break;
+    case LOX_TRUE:
+      lox_compiler_emit_op(_compiler, LOX_OP_TRUE);
+
+      break;
+    default:
+      lox_compiler_emit_op(_compiler, LOX_OP_NIL);
+
+      break;
+  }
+}
+
+static void
+lox_compiler_grouping
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  lox_compiler_expression(_compiler);
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after expression.");
+}
+
+static void
+lox_compiler_unary
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_token_e operator = _compiler->tokens[_compiler->previous].type;
+  lox_compiler_parse_precedence(_compiler, LOX_PRECEDENCE_UNARY);
+
+  lox_compiler_emit_op(_compiler, (operator == LOX_MINUS) ? LOX_OP_NEGATE : LOX_OP_NOT);
+}
+
+static void
+lox_compiler_binary
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_token_e operator = _compiler->tokens[_compiler->previous].type;
+  lox_compiler_parse_precedence(_compiler, lox_compiler_get_rule(operator)->precedence + 1);
+
+  switch (operator)
+  {
+    case LOX_BANG_EQUAL:
+      lox_compiler_emit_op(_compiler, LOX_OP_EQUAL);
+      lox_compiler_emit_op(_compiler, LOX_OP_NOT);
+
+      break;
+    case LOX_EQUAL_EQUAL:
+      lox_compiler_emit_op(_compiler, LOX_OP_EQUAL);
+
+      break;
+    case LOX_GREATER:
+      lox_compiler_emit_op(_compiler, LOX_OP_GREATER);
+
+      break;
+    case LOX_GREATER_EQUAL:
+      lox_compiler_emit_op(_compiler, LOX_OP_LESS);
+      lox_compiler_emit_op(_compiler, LOX_OP_NOT);
+
+      break;
+    case LOX_LESS:
+      lox_compiler_emit_op(_compiler, LOX_OP_LESS);
+
+      break;
+    case LOX_LESS_EQUAL:
+      lox_compiler_emit_op(_compiler, LOX_OP_GREATER);
+      lox_compiler_emit_op(_compiler, LOX_OP_NOT);
+
+      break;
+    case LOX_PLUS:
+      lox_compiler_emit_op(_compiler, LOX_OP_ADD);
+
+      break;
+    case LOX_MINUS:
+      lox_compiler_emit_op(_compiler, LOX_OP_SUBTRACT);
+
+      break;
+    case LOX_STAR:
+      lox_compiler_emit_op(_compiler, LOX_OP_MULTIPLY);
+
+      break;
+    case LOX_SLASH:
+      lox_compiler_emit_op(_compiler, LOX_OP_DIVIDE);
+
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Leaves the left operand as the result when it is falsey, and
+ * evaluates to the right one otherwise.
+ */
+static void
+lox_compiler_and
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const long end_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP_IF_FALSE);
+
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  lox_compiler_parse_precedence(_compiler, LOX_PRECEDENCE_AND);
+
+  lox_compiler_patch_jump(_compiler, end_jump);
+}
+
+static void
+lox_compiler_or
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const long else_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP_IF_FALSE);
+  const long end_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP);
+
+  lox_compiler_patch_jump(_compiler, else_jump);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  lox_compiler_parse_precedence(_compiler, LOX_PRECEDENCE_OR);
+
+  lox_compiler_patch_jump(_compiler, end_jump);
+}
+
+/*
+ * Loads or assigns the variable named _name, _token is where it was
+ * named for globals.
+ */
+static void
+lox_compiler_named_variable
+(
+  lox_compiler_t  *_compiler,
+  lox_intern_id_t  _name,
+  long             _token,
+  bool             _can_assign
+)
+{
+  lox_opcode_e get_op = LOX_OP_GET_LOCAL;
+  lox_opcode_e set_op = LOX_OP_SET_LOCAL;
+  int argument = lox_compiler_resolve_local(_compiler, _compiler->function, _name);
+  if (argument == -1)
+  {
+    argument = lox_compiler_resolve_upvalue(_compiler, _compiler->function, _name);
+    get_op = LOX_OP_GET_UPVALUE;
+    set_op = LOX_OP_SET_UPVALUE;
+  }
+
+  const bool is_assigning = _can_assign && lox_compiler_match(_compiler, LOX_EQUAL);
+  if (is_assigning)
+  {
+    lox_compiler_expression(_compiler);
+  }
+
+  if (argument == -1)
+  {
+    const uint16_t constant = lox_compiler_identifier_constant(_compiler, _token);
+    lox_compiler_emit_op_short(_compiler, is_assigning ? LOX_OP_SET_GLOBAL : LOX_OP_GET_GLOBAL,
+                               constant);
+
+    return;
+  }
+
+  lox_compiler_emit_op_byte(_compiler, is_assigning ? set_op : get_op, (uint8_t)argument);
+}
+
+static void
+lox_compiler_variable
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  lox_compiler_named_variable(_compiler, lox_compiler_name_id(_compiler, _compiler->previous),
+                              _compiler->previous, _can_assign);
+}
+
+static void
+lox_compiler_call
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  const uint8_t argument_count = lox_compiler_argument_list(_compiler);
+  lox_compiler_emit_op_byte(_compiler, LOX_OP_CALL, argument_count);
+  lox_compiler_adjust_stack(_compiler, -argument_count);
+}
+
+/*
+ * A property access followed by a call becomes one INVOKE, which
+ * doesn't create a bound method.
+ */
+static void
+lox_compiler_dot
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  lox_compiler_consume(_compiler, LOX_IDENTIFIER, "Expect property name after '.'.");
+  const uint16_t name = lox_compiler_identifier_constant(_compiler, _compiler->previous);
+
+  if (_can_assign && lox_compiler_match(_compiler, LOX_EQUAL))
+  {
+    lox_compiler_expression(_compiler);
+    lox_compiler_emit_op_short(_compiler, LOX_OP_SET_PROPERTY, name);
+  }
+  else if (lox_compiler_match(_compiler, LOX_LEFT_PAREN))
+  {
+    const uint8_t argument_count = lox_compiler_argument_list(_compiler);
+    lox_compiler_emit_op_short(_compiler, LOX_OP_INVOKE, name);
+    lox_compiler_emit_byte(_compiler, argument_count);
+    lox_compiler_adjust_stack(_compiler, -argument_count);
+  }
+  else
+  {
+    lox_compiler_emit_op_short(_compiler, LOX_OP_GET_PROPERTY, name);
+  }
+}
+
+static void
+lox_compiler_this
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  if (_compiler->class_ == NULL)
+  {
+    lox_compiler_error(_compiler, "Can't use 'this' outside of a class.");
+
+    return;
+  }
+
+  lox_compiler_named_variable(_compiler, LOX_COMPILER_THIS_NAME, _compiler->previous, false);
+}
+
+static void
+lox_compiler_super
+(
+  lox_compiler_t *_compiler,
+  bool            _can_assign
+)
+{
+  (void)_can_assign;
+  if (_compiler->class_ == NULL)
+  {
+    lox_compiler_error(_compiler, "Can't use 'super' outside of a class.");
+  }
+  else if (!_compiler->class_->has_superclass)
+  {
+    lox_compiler_error(_compiler, "Can't use 'super' in a class with no superclass.");
+  }
+
+  const long token = _compiler->previous;
+  lox_compiler_consume(_compiler, LOX_DOT, "Expect '.' after 'super'.");
+  lox_compiler_consume(_compiler, LOX_IDENTIFIER, "Expect superclass method name.");
+  const uint16_t name = lox_compiler_identifier_constant(_compiler, _compiler->previous);
+
+  lox_compiler_named_variable(_compiler, LOX_COMPILER_THIS_NAME, token, false);
+  if (lox_compiler_match(_compiler, LOX_LEFT_PAREN))
+  {
+    const uint8_t argument_count = lox_compiler_argument_list(_compiler);
+    lox_compiler_named_variable(_compiler, LOX_COMPILER_SUPER_NAME, token, false);
+    lox_compiler_emit_op_short(_compiler, LOX_OP_SUPER_INVOKE, name);
+    lox_compiler_emit_byte(_compiler, argument_count);
+    lox_compiler_adjust_stack(_compiler, -argument_count);
+  }
+  else
+  {
+    lox_compiler_named_variable(_compiler, LOX_COMPILER_SUPER_NAME, token, false);
+    lox_compiler_emit_op_short(_compiler, LOX_OP_GET_SUPER, name);
+  }
+}
+
+static const lox_compile_rule_t lox_compile_rules[LOX_TOKEN_COUNT] = {
+  [LOX_LEFT_PAREN]    = { lox_compiler_grouping, lox_compiler_call,   LOX_PRECEDENCE_CALL },
+  [LOX_DOT]           = { NULL,                  lox_compiler_dot,    LOX_PRECEDENCE_CALL },
+  [LOX_MINUS]         = { lox_compiler_unary,    lox_compiler_binary, LOX_PRECEDENCE_TERM },
+  [LOX_PLUS]          = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_TERM },
+  [LOX_SLASH]         = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_FACTOR },
+  [LOX_STAR]          = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_FACTOR },
+  [LOX_BANG]          = { lox_compiler_unary,    NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_BANG_EQUAL]    = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_EQUALITY },
+  [LOX_EQUAL_EQUAL]   = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_EQUALITY },
+  [LOX_GREATER]       = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_GREATER_EQUAL] = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_LESS]          = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_LESS_EQUAL]    = { NULL,                  lox_compiler_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_IDENTIFIER]    = { lox_compiler_variable, NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_STRING]        = { lox_compiler_string,   NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_NUMBER]        = { lox_compiler_number,   NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_AND]           = { NULL,                  lox_compiler_and,    LOX_PRECEDENCE_AND },
+  [LOX_OR]            = { NULL,                  lox_compiler_or,     LOX_PRECEDENCE_OR },
+  [LOX_FALSE]         = { lox_compiler_literal,  NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_TRUE]          = { lox_compiler_literal,  NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_NIL]           = { lox_compiler_literal,  NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_THIS]          = { lox_compiler_this,     NULL,                LOX_PRECEDENCE_NONE },
+  [LOX_SUPER]         = { lox_compiler_super,    NULL,                LOX_PRECEDENCE_NONE }
+};
+
+static const lox_compile_rule_t
+*lox_compiler_get_rule
+(
+  lox_token_e _type
+)
+{
+  return &lox_compile_rules[_type];
+}
+
+static void
+lox_compiler_block
+(
+  lox_compiler_t *_compiler
+)
+{
+  while (!lox_compiler_check(_compiler, LOX_RIGHT_BRACE) && !lox_compiler_check(_compiler, LOX_EOF))
+  {
+    lox_compiler_declaration(_compiler);
+  }
+  lox_compiler_consume(_compiler, LOX_RIGHT_BRACE, "Expect '}' after block.");
+}
+
+/*
+ * Compiles a function from its parameters on, its name being the
+ * previous token, and emits the closure creating it.
+ */
+static void
+lox_compiler_function
+(
+  lox_compiler_t *_compiler,
+  lox_function_e  _type
+)
+{
+  if (!lox_compiler_enter(_compiler))
+  {
+    return;
+  }
+
+  lox_function_scope_t scope;
+  lox_compiler_begin_function(_compiler, &scope, _type);
+  lox_compiler_begin_scope(_compiler);
+
+  lox_compiler_consume(_compiler, LOX_LEFT_PAREN, "Expect '(' after function name.");
+  if (!lox_compiler_check(_compiler, LOX_RIGHT_PAREN))
+  {
+    do
+    {
+      if (scope.function->arity == LOX_COMPILER_MAX_ARGUMENTS)
+      {
+        lox_compiler_error_at(_compiler, _compiler->current, "Can't have more than 255 parameters.");
+      }
+      ++scope.function->arity;
+
+      const uint16_t constant = lox_compiler_parse_variable(_compiler, "Expect parameter name.");
+      lox_compiler_adjust_stack(_compiler, 1);
+      lox_compiler_define_variable(_compiler, constant);
+    } while (lox_compiler_match(_compiler, LOX_COMMA));
+  }
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after parameters.");
+  lox_compiler_consume(_compiler, LOX_LEFT_BRACE, "Expect '{' before function body.");
+  lox_compiler_block(_compiler);
+
+  // The closing scope needs no POPs, returning drops the whole frame
+  lox_function_t *function = lox_compiler_end_function(_compiler);
+  lox_compiler_emit_op_short(_compiler, LOX_OP_CLOSURE,
+                             lox_compiler_make_constant(_compiler, lox_value_object(&function->object)));
+  for (int i = 0; i < function->upvalue_count; ++i)
+  {
+    lox_compiler_emit_byte(_compiler, scope.upvalues[i].is_local ? 1 : 0);
+    lox_compiler_emit_byte(_compiler, scope.upvalues[i].index);
+  }
+  --_compiler->depth;
+}
+
+static void
+lox_compiler_method
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_consume(_compiler, LOX_IDENTIFIER, "Expect method name.");
+  const long name_token = _compiler->previous;
+  const uint16_t name = lox_compiler_identifier_constant(_compiler, name_token);
+
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_compiler->lexer, &_compiler->tokens[name_token]);
+  const bool is_initializer = lexeme.length == 4 && memcmp(lexeme.data, "init", 4) == 0;
+  lox_compiler_function(_compiler, is_initializer ? LOX_FUNCTION_INITIALIZER : LOX_FUNCTION_METHOD);
+
+  lox_compiler_emit_op_short(_compiler, LOX_OP_METHOD, name);
+}
+
+static void
+lox_compiler_class_declaration
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_consume(_compiler, LOX_IDENTIFIER, "Expect class name.");
+  const long class_token = _compiler->previous;
+  const lox_intern_id_t class_name = lox_compiler_name_id(_compiler, class_token);
+  const uint16_t name = lox_compiler_identifier_constant(_compiler, class_token);
+  lox_compiler_declare_variable(_compiler);
+
+  lox_compiler_emit_op_short(_compiler, LOX_OP_CLASS, name);
+  lox_compiler_define_variable(_compiler, name);
+
+  lox_class_scope_t class_scope = {
+    .enclosing = _compiler->class_,
+    .has_superclass = false
+  };
+  _compiler->class_ = &class_scope;
+
+  if (lox_compiler_match(_compiler, LOX_LESS))
+  {
+    lox_compiler_consume(_compiler, LOX_IDENTIFIER, "Expect superclass name.");
+    lox_compiler_variable(_compiler, false);
+    if (lox_compiler_name_id(_compiler, _compiler->previous) == class_name)
+    {
+      lox_compiler_error(_compiler, "A class can't inherit from itself.");
+    }
+
+    // The superclass stays on the stack as the local methods find
+    // super in
+    lox_compiler_begin_scope(_compiler);
+    lox_compiler_add_local(_compiler, LOX_COMPILER_SUPER_NAME);
+    lox_compiler_define_variable(_compiler, 0);
+
+    lox_compiler_named_variable(_compiler, class_name, class_token, false);
+    lox_compiler_emit_op(_compiler, LOX_OP_INHERIT);
+    class_scope.has_superclass = true;
+  }
+
+  // The class stays on the stack while its methods are bound to it
+  lox_compiler_named_variable(_compiler, class_name, class_token, false);
+  lox_compiler_consume(_compiler, LOX_LEFT_BRACE, "Expect '{' before class body.");
+  while (!lox_compiler_check(_compiler, LOX_RIGHT_BRACE) && !lox_compiler_check(_compiler, LOX_EOF))
+  {
+    const long method_start = _compiler->current;
+    lox_compiler_method(_compiler);
+
+    // A broken method may not have consumed anything
+    if (_compiler->is_panicking && _compiler->current == method_start)
+    {
+      lox_compiler_advance(_compiler);
+    }
+  }
+  lox_compiler_consume(_compiler, LOX_RIGHT_BRACE, "Expect '}' after class body.");
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+
+  if (class_scope.has_superclass)
+  {
+    lox_compiler_end_scope(_compiler);
+  }
+  _compiler->class_ = class_scope.enclosing;
+}
+
+static void
+lox_compiler_fun_declaration
+(
+  lox_compiler_t *_compiler
+)
+{
+  const uint16_t global = lox_compiler_parse_variable(_compiler, "Expect function name.");
+  // A function can refer to itself, so it is usable before its body
+  lox_compiler_mark_initialized(_compiler);
+  lox_compiler_function(_compiler, LOX_FUNCTION_FUNCTION);
+  lox_compiler_define_variable(_compiler, global);
+}
+
+/*
+ * var has been consumed already. Leaves the terminator to the caller,
+ * a declaration or a for loop.
+ */
+static void
+lox_compiler_var_declaration
+(
+  lox_compiler_t *_compiler
+)
+{
+  const uint16_t global = lox_compiler_parse_variable(_compiler, "Expect variable name.");
+  if (lox_compiler_match(_compiler, LOX_EQUAL))
+  {
+    lox_compiler_expression(_compiler);
+  }
+  else
+  {
+    lox_compiler_emit_op(_compiler, LOX_OP_NIL);
+  }
+
+  lox_compiler_define_variable(_compiler, global);
+}
+
+static void
+lox_compiler_expression_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_expression(_compiler);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+}
+
+static void
+lox_compiler_print_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_expression(_compiler);
+  lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after value.");
+  lox_compiler_emit_op(_compiler, LOX_OP_PRINT);
+}
+
+static void
+lox_compiler_return_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  if (_compiler->function->type == LOX_FUNCTION_SCRIPT)
+  {
+    lox_compiler_error(_compiler, "Can't return from top-level code.");
+  }
+
+  if (lox_compiler_match(_compiler, LOX_SEMICOLON))
+  {
+    lox_compiler_emit_return(_compiler);
+
+    return;
+  }
+
+  if (_compiler->function->type == LOX_FUNCTION_INITIALIZER)
+  {
+    lox_compiler_error(_compiler, "Can't return a value from an initializer.");
+  }
+  lox_compiler_expression(_compiler);
+  lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after return value.");
+  lox_compiler_emit_op(_compiler, LOX_OP_RETURN);
+}
+
+static void
+lox_compiler_if_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_consume(_compiler, LOX_LEFT_PAREN, "Expect '(' after 'if'.");
+  lox_compiler_expression(_compiler);
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after condition.");
+
+  const long then_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP_IF_FALSE);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  lox_compiler_statement(_compiler);
+
+  const long else_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP);
+  lox_compiler_patch_jump(_compiler, then_jump);
+  // Jumping here skipped the POP of the condition above
+  lox_compiler_adjust_stack(_compiler, 1);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+
+  if (lox_compiler_match(_compiler, LOX_ELSE))
+  {
+    lox_compiler_statement(_compiler);
+  }
+  lox_compiler_patch_jump(_compiler, else_jump);
+}
+
+static void
+lox_compiler_while_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  const long loop_start = lox_compiler_chunk(_compiler)->count;
+  lox_compiler_consume(_compiler, LOX_LEFT_PAREN, "Expect '(' after 'while'.");
+  lox_compiler_expression(_compiler);
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after condition.");
+
+  const long exit_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP_IF_FALSE);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  lox_compiler_statement(_compiler);
+  lox_compiler_emit_loop(_compiler, loop_start);
+
+  lox_compiler_patch_jump(_compiler, exit_jump);
+  lox_compiler_adjust_stack(_compiler, 1);
+  lox_compiler_emit_op(_compiler, LOX_OP_POP);
+}
+
+/*
+ * The increment is compiled before the body it runs after, so the
+ * body jumps back to it and it jumps back to the condition.
+ */
+static void
+lox_compiler_for_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  lox_compiler_begin_scope(_compiler);
+  lox_compiler_consume(_compiler, LOX_LEFT_PAREN, "Expect '(' after 'for'.");
+  if (lox_compiler_match(_compiler, LOX_SEMICOLON))
+  {
+    // No initializer.
+  }
+  else
+  {
+    if (lox_compiler_match(_compiler, LOX_VAR))
+    {
+      lox_compiler_var_declaration(_compiler);
+    }
+    else
+    {
+      lox_compiler_expression_statement(_compiler);
+    }
+    lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after loop initializer.");
+  }
+
+  long loop_start = lox_compiler_chunk(_compiler)->count;
+  long exit_jump = -1;
+  if (!lox_compiler_check(_compiler, LOX_SEMICOLON))
+  {
+    lox_compiler_expression(_compiler);
+    exit_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP_IF_FALSE);
+    lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  }
+  lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after loop condition.");
+
+  if (!lox_compiler_check(_compiler, LOX_RIGHT_PAREN))
+  {
+    const long body_jump = lox_compiler_emit_jump(_compiler, LOX_OP_JUMP);
+    const long increment_start = lox_compiler_chunk(_compiler)->count;
+    lox_compiler_expression(_compiler);
+    lox_compiler_emit_op(_compiler, LOX_OP_POP);
+
+    lox_compiler_emit_loop(_compiler, loop_start);
+    loop_start = increment_start;
+    lox_compiler_patch_jump(_compiler, body_jump);
+  }
+  lox_compiler_consume(_compiler, LOX_RIGHT_PAREN, "Expect ')' after for clauses.");
+
+  lox_compiler_statement(_compiler);
+  lox_compiler_emit_loop(_compiler, loop_start);
+
+  if (exit_jump != -1)
+  {
+    lox_compiler_patch_jump(_compiler, exit_jump);
+    lox_compiler_adjust_stack(_compiler, 1);
+    lox_compiler_emit_op(_compiler, LOX_OP_POP);
+  }
+  lox_compiler_end_scope(_compiler);
+}
+
+static void
+lox_compiler_statement_at_depth
+(
+  lox_compiler_t *_compiler
+)
+{
+  if (lox_compiler_match(_compiler, LOX_PRINT))
+  {
+    lox_compiler_print_statement(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_RETURN))
+  {
+    lox_compiler_return_statement(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_IF))
+  {
+    lox_compiler_if_statement(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_WHILE))
+  {
+    lox_compiler_while_statement(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_FOR))
+  {
+    lox_compiler_for_statement(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_LEFT_BRACE))
+  {
+    lox_compiler_begin_scope(_compiler);
+    lox_compiler_block(_compiler);
+    lox_compiler_end_scope(_compiler);
+  }
+  else
+  {
+    lox_compiler_expression_statement(_compiler);
+    lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after expression.");
+  }
+}
+
+static void
+lox_compiler_statement
+(
+  lox_compiler_t *_compiler
+)
+{
+  if (!lox_compiler_enter(_compiler))
+  {
+    return;
+  }
+
+  lox_compiler_statement_at_depth(_compiler);
+  --_compiler->depth;
+}
+
+/*
+ * Skips to what looks like the start of the next statement. Always
+ * moves past _start, where the broken declaration began, so a token
+ * nothing can compile doesn't stop the compiler. Skipping to the end of
+ * the source leaves the compiler panicking, since every block still open
+ * then misses its '}' only because of the error already reported.
+ */
+static void
+lox_compiler_synchronize
+(
+  lox_compiler_t *_compiler,
+  long            _start
+)
+{
+  if (_compiler->current == _start)
+  {
+    lox_compiler_advance(_compiler);
+  }
+
+  while (!lox_compiler_check(_compiler, LOX_EOF))
+  {
+    if (_compiler->tokens[_compiler->current - 1].type == LOX_SEMICOLON)
+    {
+      _compiler->is_panicking = false;
+
+      return;
+    }
+
+    switch (lox_compiler_peek(_compiler))
+    {
+      case LOX_CLASS:
+      case LOX_FUN:
+      case LOX_VAR:
+      case LOX_FOR:
+      case LOX_IF:
+      case LOX_WHILE:
+      case LOX_PRINT:
+      case LOX_RETURN:
+        _compiler->is_panicking = false;
+
+        return;
+      default:
+        break;
+    }
+
+    lox_compiler_advance(_compiler);
+  }
+}
+
+static void
+lox_compiler_declaration
+(
+  lox_compiler_t *_compiler
+)
+{
+  const long start = _compiler->current;
+  if (lox_compiler_match(_compiler, LOX_CLASS))
+  {
+    lox_compiler_class_declaration(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_FUN))
+  {
+    lox_compiler_fun_declaration(_compiler);
+  }
+  else if (lox_compiler_match(_compiler, LOX_VAR))
+  {
+    lox_compiler_var_declaration(_compiler);
+    lox_compiler_consume(_compiler, LOX_SEMICOLON, "Expect ';' after variable declaration.");
+  }
+  else
+  {
+    lox_compiler_statement(_compiler);
+  }
+
+  if (_compiler->is_panicking)
+  {
+    lox_compiler_synchronize(_compiler, start);
+  }
+}
+
+lox_function_t
+*lox_compile
+(
+  lox_vm_t    *_vm,
+  lox_lexer_t *_lexer
+)
+{
+  // The lexer already reported what is wrong with the tokens
+  if (_lexer->had_error)
+  {
+    return NULL;
+  }
+
+  lox_compiler_t compiler = {
+    .vm = _vm,
+    .lexer = _lexer,
+    .tokens = _lexer->tokens,
+    .current = 1,
+    .previous = 0,
+    .function = NULL,
+    .class_ = NULL,
+    .line = 0,
+    .line_token = -1,
+    .depth = 0,
+    .had_error = false,
+    .is_panicking = false
+  };
+
+  lox_function_scope_t scope;
+  lox_compiler_begin_function(&compiler, &scope, LOX_FUNCTION_SCRIPT);
+  while (!lox_compiler_check(&compiler, LOX_EOF))
+  {
+    lox_compiler_declaration(&compiler);
+  }
+  lox_function_t *function = lox_compiler_end_function(&compiler);
+
+  return compiler.had_error ? NULL : function;
+}
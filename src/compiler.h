@@ -0,0 +1,37 @@
+/*
+ * Implements the compiler, which turns the tokens of a lexer straight
+ * into bytecode in a single pass, without building a syntax tree.
+ * Declarations and statements are compiled by recursive descent,
+ * expressions by precedence climbing over a table of rules indexed by
+ * token type, as in parser.h, and accept the same programs.
+ *
+ * Local variables live in stack slots resolved at compile time,
+ * globals are looked up by name at runtime. Variables of enclosing
+ * functions are captured as upvalues.
+ */
+
+#ifndef LOX_COMPILER_H
+#define LOX_COMPILER_H
+
+#include "base.h"
+#include "lexer.h"
+#include "object.h"
+
+#define LOX_COMPILER_MAX_LOCALS    (UINT8_MAX + 1)
+#define LOX_COMPILER_MAX_UPVALUES  (UINT8_MAX + 1)
+#define LOX_COMPILER_MAX_ARGUMENTS 255
+#define LOX_COMPILER_MAX_DEPTH     512
+
+/*
+ * Compiles the tokens of _lexer into the top-level function of a
+ * program, allocated in _vm. Errors are reported on stderr, and NULL
+ * returned if there were any, or if lexing reported some already.
+ */
+lox_function_t
+*lox_compile
+(
+  lox_vm_t    *_vm,
+  lox_lexer_t *_lexer
+);
+
+#endif // LOX_COMPILER_H
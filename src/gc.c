@@ -0,0 +1,766 @@
+#include "gc.h"
+#include "memory.h"
+#include "stats.h"
+#include "vm.h"
+
+void
+lox_gc_objects_push
+(
+  lox_gc_objects_t *_objects,
+  lox_object_t     *_object
+)
+{
+  if (_objects->count == _objects->capacity)
+  {
+    _objects->capacity = LOX_GROW_CAPACITY(_objects->capacity);
+    _objects->objects = lox_reallocate(_objects->objects, _objects->capacity * sizeof(lox_object_t *));
+  }
+  _objects->objects[_objects->count++] = _object;
+}
+
+static void
+lox_gc_objects_clean
+(
+  lox_gc_objects_t *_objects
+)
+{
+  lox_reallocate(_objects->objects, 0);
+  *_objects = (lox_gc_objects_t){ 0 };
+}
+
+void
+lox_gc_init
+(
+  lox_gc_t *_gc
+)
+{
+  _gc->phase = LOX_GC_PHASE_IDLE;
+  _gc->gray = (lox_gc_objects_t){ 0 };
+  _gc->strings_cursor = 0;
+  _gc->strings_capacity = 0;
+  _gc->unswept = NULL;
+  _gc->debt = 0;
+  _gc->next_cycle_bytes = LOX_GC_MIN_HEAP_BYTES;
+  _gc->growth_factor = LOX_GC_GROWTH_FACTOR;
+  _gc->nursery = lox_reallocate(NULL, LOX_GC_NURSERY_BYTES);
+  _gc->nursery_top = _gc->nursery;
+  _gc->is_nursery_full = false;
+  _gc->remembered = (lox_gc_objects_t){ 0 };
+  _gc->young_finalizable = (lox_gc_objects_t){ 0 };
+  _gc->stats = (lox_gc_stats_t){ 0 };
+}
+
+void
+lox_gc_shade
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+)
+{
+  // Young objects are found again when marking finishes
+  if (_object == NULL || _object->is_marked || lox_gc_is_young(_gc, _object))
+  {
+    return;
+  }
+  _object->is_marked = true;
+  lox_gc_objects_push(&_gc->gray, _object);
+}
+
+void
+lox_gc_remember
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+)
+{
+  _object->is_remembered = true;
+  _object->remembered_index = (uint32_t)_gc->remembered.count;
+  lox_gc_objects_push(&_gc->remembered, _object);
+}
+
+/*
+ * Drops the remembered _object, about to be freed, from the remembered
+ * objects, moving the last one into its place.
+ */
+static void
+lox_gc_forget
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+)
+{
+  lox_object_t *last = _gc->remembered.objects[--_gc->remembered.count];
+  _gc->remembered.objects[_object->remembered_index] = last;
+  last->remembered_index = _object->remembered_index;
+}
+
+void
+lox_gc_retrace
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+)
+{
+  if (lox_gc_is_young(_gc, _object))
+  {
+    return;
+  }
+
+  if (_gc->phase == LOX_GC_PHASE_MARK && _object->is_marked)
+  {
+    lox_gc_objects_push(&_gc->gray, _object);
+  }
+  if (!_object->is_remembered)
+  {
+    lox_gc_remember(_gc, _object);
+  }
+}
+
+static void
+lox_gc_shade_value
+(
+  lox_gc_t    *_gc,
+  lox_value_t  _value
+)
+{
+  if (lox_value_is_object(_value))
+  {
+    lox_gc_shade(_gc, lox_value_as_object(_value));
+  }
+}
+
+static size_t
+lox_gc_shade_table
+(
+  lox_gc_t          *_gc,
+  const lox_table_t *_table
+)
+{
+  for (long i = 0; i < _table->capacity; ++i)
+  {
+    const lox_table_entry_t *entry = &_table->entries[i];
+    if (entry->key != NULL)
+    {
+      lox_gc_shade(_gc, &entry->key->object);
+      lox_gc_shade_value(_gc, entry->value);
+    }
+  }
+
+  return _table->capacity * sizeof(lox_table_entry_t);
+}
+
+/*
+ * Shades what _object references, turning it black, and returns the
+ * bytes that took to read.
+ */
+static size_t
+lox_gc_blacken
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+)
+{
+  size_t work = lox_object_size(_object);
+  switch (_object->type)
+  {
+    case LOX_OBJECT_FUNCTION:
+    {
+      const lox_function_t *function = (const lox_function_t *)_object;
+      if (function->name != NULL)
+      {
+        lox_gc_shade(_gc, &function->name->object);
+      }
+      for (long i = 0; i < function->chunk.constants.count; ++i)
+      {
+        lox_gc_shade_value(_gc, function->chunk.constants.values[i]);
+      }
+      work += function->chunk.constants.count * sizeof(lox_value_t);
+
+      break;
+    }
+    case LOX_OBJECT_NATIVE:
+      lox_gc_shade(_gc, &((lox_native_t *)_object)->name->object);
+
+      break;
+    case LOX_OBJECT_CLOSURE:
+    {
+      const lox_closure_t *closure = (const lox_closure_t *)_object;
+      lox_gc_shade(_gc, &closure->function->object);
+      // Upvalues are NULL until the closure has captured them all
+      for (int i = 0; i < closure->upvalue_count; ++i)
+      {
+        if (closure->upvalues[i] != NULL)
+        {
+          lox_gc_shade(_gc, &closure->upvalues[i]->object);
+        }
+      }
+
+      break;
+    }
+    case LOX_OBJECT_UPVALUE:
+      lox_gc_shade_value(_gc, ((lox_upvalue_t *)_object)->closed);
+
+      break;
+    case LOX_OBJECT_CLASS:
+    {
+      const lox_class_t *class_ = (const lox_class_t *)_object;
+      lox_gc_shade(_gc, &class_->name->object);
+      lox_gc_shade_value(_gc, class_->initializer);
+      work += lox_gc_shade_table(_gc, &class_->methods);
+
+      break;
+    }
+    case LOX_OBJECT_INSTANCE:
+    {
+      const lox_instance_t *instance = (const lox_instance_t *)_object;
+      lox_gc_shade(_gc, &instance->class_->object);
+      work += lox_gc_shade_table(_gc, &instance->fields);
+
+      break;
+    }
+    case LOX_OBJECT_BOUND_METHOD:
+    {
+      const lox_bound_method_t *bound_method = (const lox_bound_method_t *)_object;
+      lox_gc_shade_value(_gc, bound_method->receiver);
+      lox_gc_shade(_gc, &bound_method->method->object);
+
+      break;
+    }
+    default:
+      break;
+  }
+
+  return work;
+}
+
+/*
+ * Shades what the program reaches without going through the heap: the
+ * stack, the closures running, which methods don't keep in their slot
+ * 0, and the upvalues still open.
+ */
+static void
+lox_gc_shade_roots
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  for (const lox_value_t *slot = _vm->stack; slot < _vm->stack_top; ++slot)
+  {
+    lox_gc_shade_value(gc, *slot);
+  }
+  for (int i = 0; i < _vm->frame_count; ++i)
+  {
+    lox_gc_shade(gc, &_vm->frames[i].closure->object);
+  }
+  for (lox_upvalue_t *upvalue = _vm->open_upvalues; upvalue != NULL; upvalue = upvalue->next_open)
+  {
+    lox_gc_shade(gc, &upvalue->object);
+  }
+  // NULL while the VM is created
+  if (_vm->init_string != NULL)
+  {
+    lox_gc_shade(gc, &_vm->init_string->object);
+  }
+}
+
+static size_t
+lox_gc_begin_cycle
+(
+  lox_vm_t *_vm
+)
+{
+  _vm->gc.phase = LOX_GC_PHASE_MARK;
+  lox_gc_shade_roots(_vm);
+
+  // Stores into globals go through the barrier, so unlike the stack
+  // they are only scanned once
+  return lox_gc_shade_table(&_vm->gc, &_vm->globals);
+}
+
+/*
+ * Runs when the gray stack is empty: shades the roots again, and what
+ * the young objects reference. Marking goes on if that found anything,
+ * otherwise it is over, and the dead strings are cleared from the table
+ * before sweeping. The objects allocated from here on are linked into
+ * the VM's list and left out of the sweep.
+ */
+static size_t
+lox_gc_rescan
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  lox_gc_shade_roots(_vm);
+  size_t work = (size_t)(_vm->stack_top - _vm->stack) * sizeof(lox_value_t);
+  // Dead young objects are traced too, they can only keep alive what
+  // was still reachable when they were allocated
+  for (uint8_t *cursor = gc->nursery; cursor < gc->nursery_top;)
+  {
+    lox_object_t *object = (lox_object_t *)cursor;
+    work += lox_gc_blacken(gc, object);
+    cursor += lox_gc_aligned_size(lox_object_size(object));
+  }
+  if (gc->gray.count > 0)
+  {
+    return work;
+  }
+
+  gc->phase = LOX_GC_PHASE_CLEAR_STRINGS;
+  gc->strings_cursor = 0;
+  gc->strings_capacity = _vm->strings.capacity;
+  gc->unswept = _vm->objects;
+  _vm->objects = NULL;
+
+  return work;
+}
+
+/*
+ * Drops the next entry of the table of strings if its string was left
+ * white, and moves on to sweeping past the last one. Strings added
+ * meanwhile are marked by lox_gc_keep_string, but growing the table
+ * moves the entries around, so it is then cleared from the start again.
+ */
+static size_t
+lox_gc_clear_string
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  lox_table_t *strings = &_vm->strings;
+  if (strings->capacity != gc->strings_capacity)
+  {
+    gc->strings_cursor = 0;
+    gc->strings_capacity = strings->capacity;
+  }
+  if (gc->strings_cursor == strings->capacity)
+  {
+    gc->phase = LOX_GC_PHASE_SWEEP;
+
+    return 0;
+  }
+
+  lox_string_t *key = strings->entries[gc->strings_cursor++].key;
+  if (key != NULL && !key->object.is_marked && !lox_gc_is_young(gc, &key->object))
+  {
+    lox_table_delete(strings, key);
+  }
+
+  return sizeof(lox_table_entry_t);
+}
+
+static void
+lox_gc_finish_cycle
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  gc->phase = LOX_GC_PHASE_IDLE;
+  gc->debt = 0;
+  gc->next_cycle_bytes = (size_t)((double)_vm->bytes_allocated * gc->growth_factor);
+  if (gc->next_cycle_bytes < LOX_GC_MIN_HEAP_BYTES)
+  {
+    gc->next_cycle_bytes = LOX_GC_MIN_HEAP_BYTES;
+  }
+  ++gc->stats.collection_count;
+}
+
+static void
+lox_gc_count_pause
+(
+  lox_gc_t *_gc,
+  double    _start
+)
+{
+  const double seconds = lox_stats_now() - _start;
+  ++_gc->stats.pause_count;
+  _gc->stats.pause_seconds += seconds;
+  if (seconds > _gc->stats.max_pause_seconds)
+  {
+    _gc->stats.max_pause_seconds = seconds;
+  }
+}
+
+/*
+ * Traces or sweeps about _budget bytes of old objects, moving on to
+ * the next phase as each one runs out of work. Starts a cycle if none
+ * is running.
+ */
+static void
+lox_gc_step
+(
+  lox_vm_t *_vm,
+  size_t    _budget
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  const double start = lox_stats_now();
+
+  size_t work = (gc->phase == LOX_GC_PHASE_IDLE) ? lox_gc_begin_cycle(_vm) : 0;
+  while (work < _budget && gc->phase != LOX_GC_PHASE_IDLE)
+  {
+    if (gc->phase == LOX_GC_PHASE_MARK)
+    {
+      work += (gc->gray.count > 0) ? lox_gc_blacken(gc, gc->gray.objects[--gc->gray.count])
+                                   : lox_gc_rescan(_vm);
+
+      continue;
+    }
+    if (gc->phase == LOX_GC_PHASE_CLEAR_STRINGS)
+    {
+      work += lox_gc_clear_string(_vm);
+
+      continue;
+    }
+
+    lox_object_t *object = gc->unswept;
+    if (object == NULL)
+    {
+      lox_gc_finish_cycle(_vm);
+
+      break;
+    }
+    gc->unswept = object->next;
+
+    const size_t size = lox_object_size(object);
+    work += size;
+    if (object->is_marked)
+    {
+      object->is_marked = false;
+      object->next = _vm->objects;
+      _vm->objects = object;
+    }
+    else
+    {
+      if (object->is_remembered)
+      {
+        lox_gc_forget(gc, object);
+      }
+      lox_object_free(_vm, object);
+      gc->stats.freed_bytes += size;
+    }
+  }
+
+  lox_gc_count_pause(gc, start);
+}
+
+/*
+ * Pays for _size bytes added to the old generation, which would then
+ * hold _heap_bytes, running a step when one is due.
+ */
+static void
+lox_gc_pay
+(
+  lox_vm_t *_vm,
+  size_t    _size,
+  size_t    _heap_bytes
+)
+{
+#ifdef LOX_GC_STRESS
+  (void)_size;
+  (void)_heap_bytes;
+  lox_gc_step(_vm, LOX_GC_STRESS_BUDGET);
+#else
+  lox_gc_t *gc = &_vm->gc;
+  if (gc->phase == LOX_GC_PHASE_IDLE && _heap_bytes <= gc->next_cycle_bytes)
+  {
+    return;
+  }
+
+  gc->debt += _size;
+  if (gc->phase == LOX_GC_PHASE_IDLE || gc->debt >= LOX_GC_STEP_BYTES)
+  {
+    lox_gc_step(_vm, gc->debt * LOX_GC_STEP_MULTIPLIER);
+    gc->debt = 0;
+  }
+#endif // LOX_GC_STRESS
+}
+
+void
+lox_gc_account
+(
+  lox_vm_t *_vm,
+  size_t    _size
+)
+{
+  lox_gc_pay(_vm, _size, _vm->bytes_allocated + _size);
+}
+
+/*
+ * Returns where the young _object lives now, copying it into the old
+ * generation the first time. The copy is remembered, for the minor
+ * collection to promote what it references in turn.
+ */
+static lox_object_t
+*lox_gc_promote
+(
+  lox_vm_t     *_vm,
+  lox_object_t *_object
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  if (!lox_gc_is_young(gc, _object))
+  {
+    return _object;
+  }
+  // The original keeps the address of its copy in next
+  if (_object->is_forwarded)
+  {
+    return _object->next;
+  }
+
+  const size_t size = lox_object_size(_object);
+  lox_object_t *copy = lox_reallocate(NULL, size);
+  memcpy(copy, _object, size);
+  copy->next = _vm->objects;
+  _vm->objects = copy;
+  _vm->bytes_allocated += size;
+  gc->stats.promoted_bytes += size;
+
+  if (copy->type == LOX_OBJECT_UPVALUE)
+  {
+    lox_upvalue_t *upvalue = (lox_upvalue_t *)copy;
+    if (upvalue->location == &((lox_upvalue_t *)_object)->closed)
+    {
+      upvalue->location = &upvalue->closed;
+    }
+  }
+
+  _object->is_forwarded = true;
+  _object->next = copy;
+
+  lox_gc_remember(gc, copy);
+  // Marking never followed it while it was young
+  if (gc->phase == LOX_GC_PHASE_MARK)
+  {
+    lox_gc_shade(gc, copy);
+  }
+  else if (copy->type == LOX_OBJECT_STRING)
+  {
+    lox_gc_keep_string(gc, copy);
+  }
+
+  return copy;
+}
+
+static void
+lox_gc_promote_value
+(
+  lox_vm_t    *_vm,
+  lox_value_t *_value
+)
+{
+  if (lox_value_is_object(*_value))
+  {
+    *_value = lox_value_object(lox_gc_promote(_vm, lox_value_as_object(*_value)));
+  }
+}
+
+static void
+lox_gc_promote_table
+(
+  lox_vm_t    *_vm,
+  lox_table_t *_table
+)
+{
+  for (long i = 0; i < _table->capacity; ++i)
+  {
+    lox_table_entry_t *entry = &_table->entries[i];
+    if (entry->key != NULL)
+    {
+      // The copy hashes the same, so its entry stays where it is
+      entry->key = (lox_string_t *)lox_gc_promote(_vm, &entry->key->object);
+      lox_gc_promote_value(_vm, &entry->value);
+    }
+  }
+}
+
+/*
+ * Promotes the young objects the old _object references.
+ */
+static void
+lox_gc_promote_references
+(
+  lox_vm_t     *_vm,
+  lox_object_t *_object
+)
+{
+  switch (_object->type)
+  {
+    case LOX_OBJECT_FUNCTION:
+    {
+      lox_function_t *function = (lox_function_t *)_object;
+      if (function->name != NULL)
+      {
+        function->name = (lox_string_t *)lox_gc_promote(_vm, &function->name->object);
+      }
+      for (long i = 0; i < function->chunk.constants.count; ++i)
+      {
+        lox_gc_promote_value(_vm, &function->chunk.constants.values[i]);
+      }
+
+      break;
+    }
+    case LOX_OBJECT_NATIVE:
+    {
+      lox_native_t *native = (lox_native_t *)_object;
+      native->name = (lox_string_t *)lox_gc_promote(_vm, &native->name->object);
+
+      break;
+    }
+    case LOX_OBJECT_CLOSURE:
+    {
+      lox_closure_t *closure = (lox_closure_t *)_object;
+      closure->function = (lox_function_t *)lox_gc_promote(_vm, &closure->function->object);
+      for (int i = 0; i < closure->upvalue_count; ++i)
+      {
+        if (closure->upvalues[i] != NULL)
+        {
+          closure->upvalues[i] = (lox_upvalue_t *)lox_gc_promote(_vm, &closure->upvalues[i]->object);
+        }
+      }
+
+      break;
+    }
+    case LOX_OBJECT_UPVALUE:
+      lox_gc_promote_value(_vm, &((lox_upvalue_t *)_object)->closed);
+
+      break;
+    case LOX_OBJECT_CLASS:
+    {
+      lox_class_t *class_ = (lox_class_t *)_object;
+      class_->name = (lox_string_t *)lox_gc_promote(_vm, &class_->name->object);
+      lox_gc_promote_value(_vm, &class_->initializer);
+      lox_gc_promote_table(_vm, &class_->methods);
+
+      break;
+    }
+    case LOX_OBJECT_INSTANCE:
+    {
+      lox_instance_t *instance = (lox_instance_t *)_object;
+      instance->class_ = (lox_class_t *)lox_gc_promote(_vm, &instance->class_->object);
+      lox_gc_promote_table(_vm, &instance->fields);
+
+      break;
+    }
+    case LOX_OBJECT_BOUND_METHOD:
+    {
+      lox_bound_method_t *bound_method = (lox_bound_method_t *)_object;
+      lox_gc_promote_value(_vm, &bound_method->receiver);
+      bound_method->method = (lox_closure_t *)lox_gc_promote(_vm, &bound_method->method->object);
+
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/*
+ * Moves the surviving young strings in the table of strings and drops
+ * the dead ones, then frees what the other dead young objects own.
+ */
+static void
+lox_gc_finalize_young
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  for (long i = 0; i < gc->young_finalizable.count; ++i)
+  {
+    lox_object_t *object = gc->young_finalizable.objects[i];
+    if (object->type == LOX_OBJECT_STRING)
+    {
+      if (object->is_forwarded)
+      {
+        lox_table_rekey(&_vm->strings, (lox_string_t *)object, (lox_string_t *)object->next);
+      }
+      else
+      {
+        lox_table_delete(&_vm->strings, (lox_string_t *)object);
+      }
+    }
+    else if (!object->is_forwarded)
+    {
+      lox_object_release(object);
+    }
+  }
+  gc->young_finalizable.count = 0;
+}
+
+void
+lox_gc_collect_young
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  const double start = lox_stats_now();
+  const size_t promoted_bytes = gc->stats.promoted_bytes;
+
+  for (lox_value_t *slot = _vm->stack; slot < _vm->stack_top; ++slot)
+  {
+    lox_gc_promote_value(_vm, slot);
+  }
+  for (int i = 0; i < _vm->frame_count; ++i)
+  {
+    _vm->frames[i].closure = (lox_closure_t *)lox_gc_promote(_vm, &_vm->frames[i].closure->object);
+  }
+  for (lox_upvalue_t **upvalue = &_vm->open_upvalues; *upvalue != NULL; upvalue = &(*upvalue)->next_open)
+  {
+    *upvalue = (lox_upvalue_t *)lox_gc_promote(_vm, &(*upvalue)->object);
+  }
+  _vm->init_string = (lox_string_t *)lox_gc_promote(_vm, &_vm->init_string->object);
+  // Stores into globals aren't remembered
+  lox_gc_promote_table(_vm, &_vm->globals);
+
+  // Promoted objects are remembered in turn, until no young object is
+  // left referenced
+  while (gc->remembered.count > 0)
+  {
+    lox_object_t *object = gc->remembered.objects[--gc->remembered.count];
+    object->is_remembered = false;
+    lox_gc_promote_references(_vm, object);
+  }
+  lox_gc_finalize_young(_vm);
+
+  gc->nursery_top = gc->nursery;
+  gc->is_nursery_full = false;
+  ++gc->stats.minor_collection_count;
+  lox_gc_count_pause(gc, start);
+
+  lox_gc_pay(_vm, gc->stats.promoted_bytes - promoted_bytes, _vm->bytes_allocated);
+}
+
+void
+lox_gc_clean
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_t *gc = &_vm->gc;
+  lox_object_t *object = gc->unswept;
+  while (object != NULL)
+  {
+    lox_object_t *next = object->next;
+    lox_object_free(_vm, object);
+    object = next;
+  }
+  gc->unswept = NULL;
+
+  for (long i = 0; i < gc->young_finalizable.count; ++i)
+  {
+    lox_object_release(gc->young_finalizable.objects[i]);
+  }
+  lox_reallocate(gc->nursery, 0);
+  gc->nursery = NULL;
+  gc->nursery_top = NULL;
+
+  lox_gc_objects_clean(&gc->gray);
+  lox_gc_objects_clean(&gc->remembered);
+  lox_gc_objects_clean(&gc->young_finalizable);
+}
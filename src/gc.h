@@ -0,0 +1,316 @@
+/*
+ * Implements the garbage collector of the VM, which splits the objects
+ * of object.h into two generations.
+ *
+ * Objects are born young, bumped off a fixed nursery. When it fills
+ * up, the next safe point of the VM, a loop or a call, runs a minor
+ * collection: the young objects the program still reaches are copied
+ * out into the old generation, and the nursery starts over empty. Its
+ * cost follows what survives, not what was allocated. Between safe
+ * points objects are allocated old, as are large ones.
+ *
+ * A minor collection finds the young objects from the roots, and from
+ * the old objects remembered to have had a young one stored in them.
+ * Every store of a reference into the heap goes through
+ * lox_gc_barrier, which remembers the old object it is stored in.
+ *
+ * The old generation is collected by an incremental mark and sweep.
+ * Marking is tri-color: white objects aren't marked, gray ones are
+ * marked and waiting on the gray stack for their references to be
+ * traced, black ones are marked and traced. A cycle starts once the
+ * old generation outgrows the size the last one left it at times the
+ * growth factor, then runs in small steps interleaved with the
+ * program, paid for by old allocations and promotions.
+ *
+ * The program keeps changing references while marking goes on, so
+ * lox_gc_barrier also shades the stored object gray. No black object
+ * can then point at a white one. The stack isn't guarded, it is
+ * scanned again whenever the gray stack runs empty, and so is the
+ * whole nursery, whose objects marking doesn't follow. What that
+ * shades is traced in further steps, marking only ends once a rescan
+ * finds nothing new, so no pause does more than one rescan of the
+ * stack and the nursery. Objects promoted while marking are shaded.
+ *
+ * Interned strings are held weakly. Those left behind by a minor
+ * collection are dropped from the VM's table of strings right away,
+ * those left white by marking in steps between marking and sweeping.
+ * Until then an old string handed out of the table again, or added to
+ * it, goes through lox_gc_keep_string, which marks it so it outlives
+ * the cycle.
+ *
+ * Building with LOX_GC_STRESS runs a step on every old allocation and
+ * a minor collection at every safe point, to shake out references the
+ * collector can't see: missing barriers with the default budget of
+ * LOX_GC_STRESS_BUDGET, objects held only in C locals with a budget of
+ * SIZE_MAX, which runs a whole cycle each time.
+ */
+
+#ifndef LOX_GC_H
+#define LOX_GC_H
+
+#include "base.h"
+#include "object.h"
+#include "value.h"
+
+#define LOX_GC_GROWTH_FACTOR   2.0
+// The old generation never starts a cycle below this size
+#define LOX_GC_MIN_HEAP_BYTES  (1024 * 1024)
+// Bytes allocated between two steps of a cycle
+#define LOX_GC_STEP_BYTES      (8 * 1024)
+// Bytes traced or swept per byte allocated, enough to finish a cycle
+// before the heap doubles again
+#define LOX_GC_STEP_MULTIPLIER 4
+
+#define LOX_GC_NURSERY_BYTES   (256 * 1024)
+// Objects above this size are allocated old
+#define LOX_GC_MAX_YOUNG_BYTES (LOX_GC_NURSERY_BYTES / 16)
+// Young objects are aligned as malloc would align them
+#define LOX_GC_ALIGNMENT       8
+
+#ifndef LOX_GC_STRESS_BUDGET
+#define LOX_GC_STRESS_BUDGET   1
+#endif
+
+typedef enum lox_gc_phase_e
+{
+  LOX_GC_PHASE_IDLE,
+  LOX_GC_PHASE_MARK,
+  LOX_GC_PHASE_CLEAR_STRINGS,
+  LOX_GC_PHASE_SWEEP
+} lox_gc_phase_e;
+
+typedef struct lox_gc_stats_t
+{
+  // Cycles of the old generation run to completion
+  long   collection_count;
+  long   minor_collection_count;
+  // Steps and minor collections, each one pauses the program
+  long   pause_count;
+  double pause_seconds;
+  double max_pause_seconds;
+  size_t freed_bytes;
+  size_t promoted_bytes;
+} lox_gc_stats_t;
+
+/*
+ * A growable array of objects, for the gray stack and the sets of the
+ * nursery.
+ */
+typedef struct lox_gc_objects_t
+{
+  lox_object_t **objects;
+  long           count;
+  long           capacity;
+} lox_gc_objects_t;
+
+void
+lox_gc_objects_push
+(
+  lox_gc_objects_t *_objects,
+  lox_object_t     *_object
+);
+
+typedef struct lox_gc_t
+{
+  lox_gc_phase_e    phase;
+  lox_gc_objects_t  gray;
+  // Next entry of the table of strings to clear, and the capacity the
+  // table had when clearing started, a grown table is cleared again
+  long              strings_cursor;
+  long              strings_capacity;
+  // The objects the sweep phase has yet to visit, survivors move back
+  // to the VM's list of objects
+  lox_object_t     *unswept;
+  // Bytes allocated since the last step, paid back by the next one
+  size_t            debt;
+  size_t            next_cycle_bytes;
+  // The old generation may grow to this many times what survived a
+  // cycle before the next one starts, above 1
+  double            growth_factor;
+
+  uint8_t          *nursery;
+  uint8_t          *nursery_top;
+  // Set when an object didn't fit, for the next safe point to collect
+  bool              is_nursery_full;
+  // Old objects that may reference young ones
+  lox_gc_objects_t  remembered;
+  // Young strings, to be unlinked from the table of strings or moved
+  // in it, and young objects owning memory outside the nursery, to
+  // have it freed if they die
+  lox_gc_objects_t  young_finalizable;
+
+  lox_gc_stats_t    stats;
+} lox_gc_t;
+
+/*
+ * Allocates the nursery.
+ */
+void
+lox_gc_init
+(
+  lox_gc_t *_gc
+);
+
+static inline bool
+lox_gc_is_young
+(
+  const lox_gc_t     *_gc,
+  const lox_object_t *_object
+)
+{
+  return (uintptr_t)_object - (uintptr_t)_gc->nursery < LOX_GC_NURSERY_BYTES;
+}
+
+static inline size_t
+lox_gc_aligned_size
+(
+  size_t _size
+)
+{
+  return (_size + LOX_GC_ALIGNMENT - 1) & ~(size_t)(LOX_GC_ALIGNMENT - 1);
+}
+
+/*
+ * Bumps _size bytes off the nursery, or returns NULL if it is full or
+ * _size too large for it.
+ */
+static inline lox_object_t
+*lox_gc_allocate_young
+(
+  lox_gc_t *_gc,
+  size_t    _size
+)
+{
+  const size_t aligned_size = lox_gc_aligned_size(_size);
+  if (aligned_size > LOX_GC_MAX_YOUNG_BYTES)
+  {
+    return NULL;
+  }
+  if (aligned_size > (size_t)(_gc->nursery + LOX_GC_NURSERY_BYTES - _gc->nursery_top))
+  {
+    _gc->is_nursery_full = true;
+
+    return NULL;
+  }
+
+  lox_object_t *object = (lox_object_t *)_gc->nursery_top;
+  _gc->nursery_top += aligned_size;
+
+  return object;
+}
+
+/*
+ * Marks _object gray if it is white and old.
+ */
+void
+lox_gc_shade
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+);
+
+/*
+ * Adds the old _object to the objects a minor collection scans.
+ */
+void
+lox_gc_remember
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+);
+
+/*
+ * Has _object traced again by both generations, after a change too
+ * wide for lox_gc_barrier such as copying a whole table into it.
+ */
+void
+lox_gc_retrace
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_object
+);
+
+/*
+ * Called with an interned string about to be handed out of the table
+ * of strings, or just added to it. While dead strings are cleared from
+ * the table, an unmarked old one there is either dead and revived, or
+ * new, and both have to survive the sweep.
+ */
+static inline void
+lox_gc_keep_string
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_string
+)
+{
+  if (_gc->phase == LOX_GC_PHASE_CLEAR_STRINGS && !lox_gc_is_young(_gc, _string))
+  {
+    _string->is_marked = true;
+  }
+}
+
+/*
+ * Called with every reference about to be stored in _container, or in
+ * the globals with a NULL _container.
+ */
+static inline void
+lox_gc_barrier
+(
+  lox_gc_t     *_gc,
+  lox_object_t *_container,
+  lox_value_t   _value
+)
+{
+  if (!lox_value_is_object(_value))
+  {
+    return;
+  }
+
+  lox_object_t *object = lox_value_as_object(_value);
+  if (lox_gc_is_young(_gc, object))
+  {
+    // The globals are a root of minor collections
+    if (_container != NULL && !_container->is_remembered && !lox_gc_is_young(_gc, _container))
+    {
+      lox_gc_remember(_gc, _container);
+    }
+  }
+  else if (_gc->phase == LOX_GC_PHASE_MARK && !object->is_marked)
+  {
+    lox_gc_shade(_gc, object);
+  }
+}
+
+/*
+ * Accounts for an old object of _size bytes about to be allocated,
+ * running a step of the collector when one is due. The new object
+ * isn't linked yet, so a step can't reach it.
+ */
+void
+lox_gc_account
+(
+  lox_vm_t *_vm,
+  size_t    _size
+);
+
+/*
+ * Runs a minor collection, leaving the nursery empty. Only the VM
+ * calls it, at points where it holds no object outside its roots.
+ */
+void
+lox_gc_collect_young
+(
+  lox_vm_t *_vm
+);
+
+/*
+ * Frees the nursery and its objects, the gray stack and every object
+ * still waiting to be swept.
+ */
+void
+lox_gc_clean
+(
+  lox_vm_t *_vm
+);
+
+#endif // LOX_GC_H
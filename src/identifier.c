@@ -1,281 +1,388 @@
 #include "identifier.h"
 
-static int
-lox_get_identifier_position
+#define LOX_FNV_OFFSET_BASIS 2166136261u
+#define LOX_FNV_PRIME        16777619u
+
+uint32_t
+lox_hash_string
 (
-  char *_name
+  const char *_string,
+  long        _length
 )
 {
-  if (_name == NULL)
+  // FNV-1a
+  uint32_t hash = LOX_FNV_OFFSET_BASIS;
+  for (long i = 0; i < _length; ++i)
   {
-    fprintf(stderr, "given identifier name wasn't allocated\n");
-
-    return -1;
+    hash ^= (uint8_t)_string[i];
+    hash *= LOX_FNV_PRIME;
   }
 
-  int name_hash = 0;
-  for (char *c = _name; *c != '\0'; ++c)
-  {
-    name_hash += (int)*c;
-  }
-
-  return name_hash % IDENTIFIER_TABLE_CAPACITY;
+  return hash;
 }
 
-lox_identifier_table_t *
-lox_create_and_populate_identifier_table
-()
+static lox_interner_slot_t
+*lox_interner_create_slots
+(
+  lox_arena_t *_arena,
+  uint32_t     _capacity
+)
 {
-  // Using calloc since malloc creates garbage data on head_slots
-  lox_identifier_table_t *new_table = calloc(1, sizeof(lox_identifier_table_t));
-  if (new_table == NULL)
+  lox_interner_slot_t *slots = lox_arena_alloc(_arena, _capacity * sizeof(lox_interner_slot_t));
+  if (slots == NULL)
   {
-    fprintf(stderr, "failed to allocate memory for new identifier table\n");
+    fprintf(stderr, "failed to allocate %u interner slots\n", _capacity);
 
     return NULL;
   }
-  new_table->identifier_count = 0;
-
-  lox_push_identifier_to_table(new_table, "and", false, LOX_AND);
-  lox_push_identifier_to_table(new_table, "class", false, LOX_CLASS);
-  lox_push_identifier_to_table(new_table, "else", false, LOX_ELSE);
-  lox_push_identifier_to_table(new_table, "false", false, LOX_FALSE);
-  lox_push_identifier_to_table(new_table, "for", false, LOX_FOR);
-  lox_push_identifier_to_table(new_table, "fun", false, LOX_FOR);
-  lox_push_identifier_to_table(new_table, "if", false, LOX_FUN);
-  lox_push_identifier_to_table(new_table, "nil", false, LOX_IF);
-  lox_push_identifier_to_table(new_table, "or", false, LOX_NIL);
-  lox_push_identifier_to_table(new_table, "print", false, LOX_OR);
-  lox_push_identifier_to_table(new_table, "return", false, LOX_PRINT);
-  lox_push_identifier_to_table(new_table, "super", false, LOX_RETURN);
-  lox_push_identifier_to_table(new_table, "this", false, LOX_SUPER);
-  lox_push_identifier_to_table(new_table, "true", false, LOX_THIS);
-  lox_push_identifier_to_table(new_table, "var", false, LOX_TRUE);
-  lox_push_identifier_to_table(new_table, "while", false, LOX_VAR);
-
-  return new_table;
+
+  for (uint32_t i = 0; i < _capacity; ++i)
+  {
+    slots[i].hash = 0;
+    slots[i].id = LOX_INTERN_INVALID_ID;
+  }
+
+  return slots;
 }
 
-lox_identifier_t *
-lox_push_identifier_to_table
+static lox_interner_slot_t
+*lox_interner_probe
 (
-  lox_identifier_table_t *_table,
-  char                   *_name,
-  bool                    _is_name_allocated,
-  lox_token_e             _type
+  const lox_interner_t *_interner,
+  const char           *_name,
+  long                  _length,
+  uint32_t              _hash
 )
 {
-  if (_table == NULL)
+  // Counters are bookkeeping, lookups stay logically const
+  LOX_STATS_ONLY(lox_interner_stats_t *stats = &((lox_interner_t *)_interner)->stats;)
+  LOX_STATS_ONLY(++stats->lookup_count;)
+
+  const uint32_t mask = _interner->slot_capacity - 1;
+  uint32_t position = _hash & mask;
+  for (;;)
   {
-    fprintf(stderr, "given table wasn't allocated\n");
+    LOX_STATS_ONLY(++stats->probe_count;)
+    lox_interner_slot_t *slot = &_interner->slots[position];
+    if (slot->id == LOX_INTERN_INVALID_ID)
+    {
+      return slot;
+    }
 
-    return NULL;
+    if (slot->hash == _hash)
+    {
+      const lox_interned_t *entry = &_interner->entries[slot->id];
+      if (entry->length == (uint32_t)_length &&
+          memcmp(entry->name, _name, _length) == 0)
+      {
+        return slot;
+      }
+    }
+
+    LOX_STATS_ONLY(++stats->collision_count;)
+    position = (position + 1) & mask;
   }
+}
 
-  lox_identifier_t *new_identifier = malloc(sizeof(lox_identifier_t));
-  if (new_identifier == NULL)
+static bool
+lox_interner_grow_slots
+(
+  lox_interner_t *_interner
+)
+{
+  const uint32_t new_capacity = _interner->slot_capacity * 2;
+  lox_interner_slot_t *new_slots = lox_interner_create_slots(_interner->arena, new_capacity);
+  if (new_slots == NULL)
   {
-    fprintf(stderr, "failed to allocate memory for new identifier");
-
-    return NULL;
+    return false;
   }
-  new_identifier->name = _name;
-  new_identifier->is_name_allocated = _is_name_allocated;
-  new_identifier->type = _type;
 
-  const int position = lox_get_identifier_position(_name);
-  if (position < 0)
+  // Entries are unique, so rehashing only needs the first empty slot
+  const uint32_t mask = new_capacity - 1;
+  for (uint32_t id = 0; id < _interner->entry_count; ++id)
   {
-    if (_is_name_allocated)
+    uint32_t position = _interner->entries[id].hash & mask;
+    while (new_slots[position].id != LOX_INTERN_INVALID_ID)
     {
-      free(new_identifier->name);
+      position = (position + 1) & mask;
     }
 
-    free(new_identifier);
-
-    return NULL;
+    new_slots[position].hash = _interner->entries[id].hash;
+    new_slots[position].id = id;
   }
 
-  lox_push_identifier_to_slot(_table, position, new_identifier);
+  // The old array stays in the arena, growth is geometric so at most
+  // as much memory as the live array is wasted this way
+  _interner->slots = new_slots;
+  _interner->slot_capacity = new_capacity;
 
-  ++_table->identifier_count;
-  return new_identifier;
+  return true;
 }
 
-void
-lox_push_identifier_to_slot
+static bool
+lox_interner_grow_entries
 (
-  lox_identifier_table_t *_table,
-  int                     _position,
-  lox_identifier_t       *_identifier
+  lox_interner_t *_interner
 )
 {
-  if (_identifier == NULL)
+  const uint32_t new_capacity = _interner->entry_capacity * 2;
+  lox_interned_t *new_entries = lox_arena_alloc(_interner->arena, new_capacity * sizeof(lox_interned_t));
+  if (new_entries == NULL)
   {
-    fprintf(stderr, "given head and/or identifier weren't allocated\n");
+    fprintf(stderr, "failed to allocate %u interner entries\n", new_capacity);
 
-    return;
+    return false;
   }
 
-  lox_identifier_t *last_identifier = NULL;
-  lox_identifier_t *current_identifier = _table->head_slots[_position];
-  while (current_identifier != NULL)
-  {
-    last_identifier = current_identifier;
-    current_identifier = current_identifier->next;
-  }
+  memcpy(new_entries, _interner->entries, _interner->entry_count * sizeof(lox_interned_t));
+  _interner->entries = new_entries;
+  _interner->entry_capacity = new_capacity;
+
+  return true;
+}
 
-  if (last_identifier == NULL)
+lox_interner_t
+*lox_create_interner
+(
+  lox_arena_t *_arena
+)
+{
+  lox_interner_t *new_interner = lox_arena_alloc(_arena, sizeof(lox_interner_t));
+  if (new_interner == NULL)
   {
-    _table->head_slots[_position] = _identifier;
+    fprintf(stderr, "failed to allocate memory for new interner\n");
+
+    return NULL;
   }
-  else
+  new_interner->arena = _arena;
+  LOX_STATS_ONLY(memset(&new_interner->stats, 0, sizeof(new_interner->stats));)
+  new_interner->entry_count = 0;
+  new_interner->entry_capacity = LOX_INTERNER_INITIAL_CAPACITY;
+  new_interner->slot_capacity = LOX_INTERNER_INITIAL_CAPACITY;
+
+  new_interner->slots = lox_interner_create_slots(_arena, new_interner->slot_capacity);
+  new_interner->entries = lox_arena_alloc(_arena, new_interner->entry_capacity * sizeof(lox_interned_t));
+  if (new_interner->slots == NULL || new_interner->entries == NULL)
   {
-    last_identifier->next = _identifier;
+    fprintf(stderr, "failed to allocate memory for interner arrays\n");
+
+    return NULL;
   }
-}
 
+  return new_interner;
+}
 
-lox_identifier_t *
-lox_find_identifier
+lox_intern_id_t
+lox_intern
 (
-  lox_identifier_table_t *_table,
-  char                   *_name
+  lox_interner_t *_interner,
+  const char     *_name,
+  long            _length
 )
 {
-  if (_table == NULL)
+  if (_interner == NULL)
   {
-    fprintf(stderr, "given table wasn't allocated\n");
+    fprintf(stderr, "given interner wasn't allocated\n");
 
-    return NULL;
+    return LOX_INTERN_INVALID_ID;
   }
 
-  const int position = lox_get_identifier_position(_name);
-  if (position < 0)
+  const uint32_t hash = lox_hash_string(_name, _length);
+  lox_interner_slot_t *slot = lox_interner_probe(_interner, _name, _length, hash);
+  if (slot->id != LOX_INTERN_INVALID_ID)
   {
-    return NULL;
+    return slot->id;
   }
 
-  lox_identifier_t *current_identifier = _table->head_slots[position];
-  while (current_identifier != NULL)
+  if ((uint64_t)(_interner->entry_count + 1) * 100 >
+      (uint64_t)_interner->slot_capacity * LOX_INTERNER_MAX_LOAD_PERCENT)
   {
-    if (current_identifier->name == _name)
+    if (!lox_interner_grow_slots(_interner))
     {
-      break;
+      return LOX_INTERN_INVALID_ID;
     }
 
-    current_identifier = current_identifier->next;
+    slot = lox_interner_probe(_interner, _name, _length, hash);
+  }
+
+  if (_interner->entry_count == _interner->entry_capacity &&
+      !lox_interner_grow_entries(_interner))
+  {
+    return LOX_INTERN_INVALID_ID;
+  }
+
+  char *name_copy = lox_arena_copy_string(_interner->arena, _name, _length);
+  if (name_copy == NULL)
+  {
+    return LOX_INTERN_INVALID_ID;
   }
 
-  return current_identifier;
+  const lox_intern_id_t id = _interner->entry_count;
+  _interner->entries[id].name = name_copy;
+  _interner->entries[id].length = (uint32_t)_length;
+  _interner->entries[id].hash = hash;
+  ++_interner->entry_count;
+
+  slot->hash = hash;
+  slot->id = id;
+
+  return id;
 }
 
-void
-lox_debug_identifier_table
+lox_intern_id_t
+lox_find_interned
 (
-  lox_identifier_table_t *_table
+  const lox_interner_t *_interner,
+  const char           *_name,
+  long                  _length
 )
 {
-  if (_table == NULL)
+  if (_interner == NULL)
   {
-    fprintf(stderr, "given table wasn't allocated\n");
+    fprintf(stderr, "given interner wasn't allocated\n");
 
-    return;
+    return LOX_INTERN_INVALID_ID;
   }
 
-  lox_identifier_t *current_head;
-  for (int i = 0; i < IDENTIFIER_TABLE_CAPACITY; ++i)
-  {
-    current_head = _table->head_slots[i];
-    lox_debug_subsequent_identifiers(current_head);
-  }
+  const uint32_t hash = lox_hash_string(_name, _length);
+
+  return lox_interner_probe(_interner, _name, _length, hash)->id;
 }
 
-void
-lox_debug_subsequent_identifiers
+const lox_interned_t
+*lox_get_interned
 (
-  lox_identifier_t *_head
+  const lox_interner_t *_interner,
+  lox_intern_id_t       _id
 )
 {
-  if (_head == NULL)
+  if (_interner == NULL || _id >= _interner->entry_count)
   {
-    return;
+    return NULL;
   }
 
-  lox_identifier_t *current_identifier = _head;
-  while (current_identifier != NULL)
-  {
-    printf("id [%d]: %s\n", current_identifier->type, current_identifier->name);
-    current_identifier = current_identifier->next;
-  }
+  return &_interner->entries[_id];
 }
 
-void
-lox_clean_identifier_table
+static lox_token_e
+lox_match_keyword
 (
-  lox_identifier_table_t *_table
+  const char  *_name,
+  const char  *_keyword,
+  long         _length,
+  lox_token_e  _type
 )
 {
-  if (_table == NULL)
-  {
-    fprintf(stderr, "given head identifier table wasn't allocated\n");
+  // The first character was already matched by the caller's switch
+  return (memcmp(_name + 1, _keyword + 1, _length - 1) == 0) ? _type : LOX_IDENTIFIER;
+}
 
-    return;
-  }
+const char
+*lox_token_name
+(
+  lox_token_e _type
+)
+{
+  static const char *const names[LOX_TOKEN_COUNT] = {
+    "LEFT_PAREN", "RIGHT_PAREN", "LEFT_BRACE", "RIGHT_BRACE",
+    "COMMA", "DOT", "MINUS", "PLUS", "SEMICOLON", "SLASH", "STAR",
+    "BANG", "BANG_EQUAL", "EQUAL", "EQUAL_EQUAL",
+    "GREATER", "GREATER_EQUAL", "LESS", "LESS_EQUAL",
+    "IDENTIFIER", "STRING", "NUMBER",
+    "AND", "CLASS", "ELSE", "FALSE", "FUN", "FOR", "IF", "NIL", "OR",
+    "PRINT", "RETURN", "SUPER", "THIS", "TRUE", "VAR", "WHILE",
+    "BOF", "EOF"
+  };
+
+  return (_type < LOX_TOKEN_COUNT) ? names[_type] : "INVALID";
+}
 
-  lox_identifier_t *current_head;
-  int freed_identifier_count = 0;
-  for (int i = 0; i < IDENTIFIER_TABLE_CAPACITY; ++i)
+lox_token_e
+lox_find_keyword
+(
+  const char *_name,
+  long        _length
+)
+{
+  switch (_length)
   {
-    current_head = _table->head_slots[i];
-    if (current_head != NULL)
-    {
-      freed_identifier_count += lox_clean_subsequent_identifiers(current_head);
-    }
-  }
+    case 2:
+      switch (_name[0])
+      {
+        case 'i': return lox_match_keyword(_name, "if", 2, LOX_IF);
+        case 'o': return lox_match_keyword(_name, "or", 2, LOX_OR);
+      }
 
-  if (freed_identifier_count != _table->identifier_count)
-  {
-    fprintf(stderr, "possible memory leak: freed only %d ids out of %d\n",
-            freed_identifier_count, _table->identifier_count);
+      break;
+    case 3:
+      switch (_name[0])
+      {
+        case 'a': return lox_match_keyword(_name, "and", 3, LOX_AND);
+        case 'f':
+          if (_name[1] == 'o')
+          {
+            return lox_match_keyword(_name, "for", 3, LOX_FOR);
+          }
+
+          return lox_match_keyword(_name, "fun", 3, LOX_FUN);
+        case 'n': return lox_match_keyword(_name, "nil", 3, LOX_NIL);
+        case 'v': return lox_match_keyword(_name, "var", 3, LOX_VAR);
+      }
+
+      break;
+    case 4:
+      switch (_name[0])
+      {
+        case 'e': return lox_match_keyword(_name, "else", 4, LOX_ELSE);
+        case 't':
+          if (_name[1] == 'h')
+          {
+            return lox_match_keyword(_name, "this", 4, LOX_THIS);
+          }
+
+          return lox_match_keyword(_name, "true", 4, LOX_TRUE);
+      }
+
+      break;
+    case 5:
+      switch (_name[0])
+      {
+        case 'c': return lox_match_keyword(_name, "class", 5, LOX_CLASS);
+        case 'f': return lox_match_keyword(_name, "false", 5, LOX_FALSE);
+        case 'p': return lox_match_keyword(_name, "print", 5, LOX_PRINT);
+        case 's': return lox_match_keyword(_name, "super", 5, LOX_SUPER);
+        case 'w': return lox_match_keyword(_name, "while", 5, LOX_WHILE);
+      }
+
+      break;
+    case 6:
+      if (_name[0] == 'r')
+      {
+        return lox_match_keyword(_name, "return", 6, LOX_RETURN);
+      }
+
+      break;
   }
 
-  free(_table);
+  return LOX_IDENTIFIER;
 }
 
-int
-lox_clean_subsequent_identifiers
+void
+lox_debug_interner
 (
-  lox_identifier_t *_head
+  const lox_interner_t *_interner
 )
 {
-  if (_head == NULL)
+  if (_interner == NULL)
   {
-    fprintf(stderr, "given identifier head node wasn't allocated\n");
+    fprintf(stderr, "given interner wasn't allocated\n");
 
-    return 0;
+    return;
   }
 
-  int freed_identifier_count = 0;
-  lox_identifier_t *current_identifier = _head;
-  lox_identifier_t *next_identifier = _head->next;
-  while (current_identifier != NULL)
+  for (lox_intern_id_t id = 0; id < _interner->entry_count; ++id)
   {
-    if (current_identifier->is_name_allocated)
-    {
-      free(current_identifier->name);
-    }
-
-    free(current_identifier);
-    current_identifier = next_identifier;
-
-    if (next_identifier != NULL)
-    {
-      next_identifier = next_identifier->next;
-    }
-
-    ++freed_identifier_count;
+    const lox_interned_t *entry = &_interner->entries[id];
+    printf("id [%u]: %.*s\n", id, (int)entry->length, entry->name);
   }
-
-  return freed_identifier_count;
-}
\ No newline at end of file
+}
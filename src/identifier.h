@@ -1,13 +1,17 @@
 /*
- * Implements a hash set.
+ * Implements the string interner, and the keyword recognizer.
  */
 
 #ifndef LOX_IDENTIFIER_H
 #define LOX_IDENTIFIER_H
 
 #include "base.h"
+#include "arena.h"
+#include "stats.h"
 
-#define IDENTIFIER_TABLE_CAPACITY 16
+#define LOX_INTERNER_INITIAL_CAPACITY 64
+#define LOX_INTERNER_MAX_LOAD_PERCENT 70
+#define LOX_INTERN_INVALID_ID         UINT32_MAX
 
 typedef enum lox_token_e
 {
@@ -28,75 +32,138 @@ typedef enum lox_token_e
   LOX_AND, LOX_CLASS, LOX_ELSE, LOX_FALSE, LOX_FUN, LOX_FOR, LOX_IF, LOX_NIL, LOX_OR,
   LOX_PRINT, LOX_RETURN, LOX_SUPER, LOX_THIS, LOX_TRUE, LOX_VAR, LOX_WHILE,
 
-  LOX_BOF, LOX_EOF
+  LOX_BOF, LOX_EOF,
+
+  LOX_TOKEN_COUNT
 } lox_token_e;
 
-typedef struct lox_identifier_t lox_identifier_t;
-typedef struct lox_identifier_t
+/*
+ * Interned strings are numbered densely from 0 in insertion order, so
+ * an id can index side tables and two names are equal iff their ids
+ * are.
+ */
+typedef uint32_t lox_intern_id_t;
+
+typedef struct lox_interned_t
 {
-  char        *name;
-  bool         is_name_allocated;
-  lox_token_e  type;
+  const char *name;
+  uint32_t    length;
+  uint32_t    hash;
+} lox_interned_t;
 
-  lox_identifier_t *next;
-} lox_id_t;
+/*
+ * A slot holds the full hash next to the id, so probing only touches
+ * the entry array once the hashes agree. Empty slots have id
+ * LOX_INTERN_INVALID_ID.
+ */
+typedef struct lox_interner_slot_t
+{
+  uint32_t        hash;
+  lox_intern_id_t id;
+} lox_interner_slot_t;
 
-typedef struct lox_identifier_table_t
+/*
+ * A lookup probes slots until it finds its name or an empty one, every
+ * other occupied slot on the way is a collision.
+ */
+typedef struct lox_interner_stats_t
 {
-  lox_identifier_t *head_slots[IDENTIFIER_TABLE_CAPACITY];
-  int               identifier_count;
-} lox_identifier_table_t;
+  uint64_t lookup_count;
+  uint64_t probe_count;
+  uint64_t collision_count;
+} lox_interner_stats_t;
 
-lox_identifier_table_t *
-lox_create_and_populate_identifier_table
-();
+/*
+ * Open addressing hash set with linear probing. The slot array doubles
+ * whenever the load factor would exceed LOX_INTERNER_MAX_LOAD_PERCENT.
+ */
+typedef struct lox_interner_t
+{
+  lox_interner_slot_t *slots;
+  uint32_t             slot_capacity;
+
+  lox_interned_t      *entries;
+  uint32_t             entry_count;
+  uint32_t             entry_capacity;
 
-lox_identifier_t *
-lox_push_identifier_to_table
+  lox_arena_t         *arena;
+
+  LOX_STATS_ONLY(lox_interner_stats_t stats;)
+} lox_interner_t;
+
+uint32_t
+lox_hash_string
 (
-  lox_identifier_table_t *_table,
-  char                   *_name,
-  bool                    _is_name_allocated,
-  lox_token_e             _type
+  const char *_string,
+  long        _length
 );
 
-void
-lox_push_identifier_to_slot
+/*
+ * The interner, its arrays and copies of the interned names all live
+ * in _arena, so they are released together with it.
+ */
+lox_interner_t
+*lox_create_interner
 (
-  lox_identifier_table_t *_table,
-  int                     _position,
-  lox_identifier_t       *_identifier
+  lox_arena_t *_arena
 );
 
-lox_identifier_t *
-lox_find_identifier
+/*
+ * Returns the id of the given name, interning a copy of it first if
+ * it wasn't seen before, or LOX_INTERN_INVALID_ID on failure.
+ */
+lox_intern_id_t
+lox_intern
 (
-  lox_identifier_table_t *_table,
-  char                   *_name
+  lox_interner_t *_interner,
+  const char     *_name,
+  long            _length
 );
 
-void
-lox_debug_identifier_table
+/*
+ * Returns the id of the given name, or LOX_INTERN_INVALID_ID if it
+ * was never interned.
+ */
+lox_intern_id_t
+lox_find_interned
 (
-  lox_identifier_table_t *_table
+  const lox_interner_t *_interner,
+  const char           *_name,
+  long                  _length
 );
 
-void
-lox_debug_subsequent_identifiers
+const lox_interned_t
+*lox_get_interned
 (
-  lox_identifier_t *_head
+  const lox_interner_t *_interner,
+  lox_intern_id_t       _id
 );
 
-void
-lox_clean_identifier_table
+/*
+ * Name of _type as spelled in lox_token_e, without the LOX_ prefix.
+ */
+const char
+*lox_token_name
+(
+  lox_token_e _type
+);
+
+/*
+ * Classifies a name as one of the reserved words, or LOX_IDENTIFIER.
+ * The lookup is a switch on length and first character fixed at compile
+ * time, it neither allocates nor copies _name.
+ */
+lox_token_e
+lox_find_keyword
 (
-  lox_identifier_table_t *_table
+  const char *_name,
+  long        _length
 );
 
-int
-lox_clean_subsequent_identifiers
+void
+lox_debug_interner
 (
-  lox_identifier_t *_head
+  const lox_interner_t *_interner
 );
 
 #endif // LOX_IDENTIFIER_H
@@ -1,12 +1,83 @@
+#include <float.h>
+#include <stdarg.h>
+
 #include "lexer.h"
 
+typedef enum lox_char_class_e
+{
+  LOX_CHAR_INVALID = 0,
+  LOX_CHAR_WHITESPACE,
+  LOX_CHAR_COMMENT,
+  LOX_CHAR_SINGLE,
+  LOX_CHAR_OPERATOR,
+  LOX_CHAR_QUOTE,
+  LOX_CHAR_DIGIT,
+  LOX_CHAR_ALPHA
+} lox_char_class_e;
+
+static const uint8_t lox_char_classes[256] = {
+  [' '] = LOX_CHAR_WHITESPACE, ['\t'] = LOX_CHAR_WHITESPACE,
+  ['\r'] = LOX_CHAR_WHITESPACE, ['\n'] = LOX_CHAR_WHITESPACE,
+
+  ['#'] = LOX_CHAR_COMMENT,
+
+  ['('] = LOX_CHAR_SINGLE, [')'] = LOX_CHAR_SINGLE, ['{'] = LOX_CHAR_SINGLE,
+  ['}'] = LOX_CHAR_SINGLE, [','] = LOX_CHAR_SINGLE, ['.'] = LOX_CHAR_SINGLE,
+  ['-'] = LOX_CHAR_SINGLE, ['+'] = LOX_CHAR_SINGLE, [';'] = LOX_CHAR_SINGLE,
+  ['*'] = LOX_CHAR_SINGLE, ['/'] = LOX_CHAR_SINGLE,
+
+  ['!'] = LOX_CHAR_OPERATOR, ['='] = LOX_CHAR_OPERATOR,
+  ['<'] = LOX_CHAR_OPERATOR, ['>'] = LOX_CHAR_OPERATOR,
+
+  ['"'] = LOX_CHAR_QUOTE,
+
+  ['0'] = LOX_CHAR_DIGIT, ['1'] = LOX_CHAR_DIGIT, ['2'] = LOX_CHAR_DIGIT,
+  ['3'] = LOX_CHAR_DIGIT, ['4'] = LOX_CHAR_DIGIT, ['5'] = LOX_CHAR_DIGIT,
+  ['6'] = LOX_CHAR_DIGIT, ['7'] = LOX_CHAR_DIGIT, ['8'] = LOX_CHAR_DIGIT,
+  ['9'] = LOX_CHAR_DIGIT,
+
+  ['a'] = LOX_CHAR_ALPHA, ['b'] = LOX_CHAR_ALPHA, ['c'] = LOX_CHAR_ALPHA,
+  ['d'] = LOX_CHAR_ALPHA, ['e'] = LOX_CHAR_ALPHA, ['f'] = LOX_CHAR_ALPHA,
+  ['g'] = LOX_CHAR_ALPHA, ['h'] = LOX_CHAR_ALPHA, ['i'] = LOX_CHAR_ALPHA,
+  ['j'] = LOX_CHAR_ALPHA, ['k'] = LOX_CHAR_ALPHA, ['l'] = LOX_CHAR_ALPHA,
+  ['m'] = LOX_CHAR_ALPHA, ['n'] = LOX_CHAR_ALPHA, ['o'] = LOX_CHAR_ALPHA,
+  ['p'] = LOX_CHAR_ALPHA, ['q'] = LOX_CHAR_ALPHA, ['r'] = LOX_CHAR_ALPHA,
+  ['s'] = LOX_CHAR_ALPHA, ['t'] = LOX_CHAR_ALPHA, ['u'] = LOX_CHAR_ALPHA,
+  ['v'] = LOX_CHAR_ALPHA, ['w'] = LOX_CHAR_ALPHA, ['x'] = LOX_CHAR_ALPHA,
+  ['y'] = LOX_CHAR_ALPHA, ['z'] = LOX_CHAR_ALPHA,
+  ['A'] = LOX_CHAR_ALPHA, ['B'] = LOX_CHAR_ALPHA, ['C'] = LOX_CHAR_ALPHA,
+  ['D'] = LOX_CHAR_ALPHA, ['E'] = LOX_CHAR_ALPHA, ['F'] = LOX_CHAR_ALPHA,
+  ['G'] = LOX_CHAR_ALPHA, ['H'] = LOX_CHAR_ALPHA, ['I'] = LOX_CHAR_ALPHA,
+  ['J'] = LOX_CHAR_ALPHA, ['K'] = LOX_CHAR_ALPHA, ['L'] = LOX_CHAR_ALPHA,
+  ['M'] = LOX_CHAR_ALPHA, ['N'] = LOX_CHAR_ALPHA, ['O'] = LOX_CHAR_ALPHA,
+  ['P'] = LOX_CHAR_ALPHA, ['Q'] = LOX_CHAR_ALPHA, ['R'] = LOX_CHAR_ALPHA,
+  ['S'] = LOX_CHAR_ALPHA, ['T'] = LOX_CHAR_ALPHA, ['U'] = LOX_CHAR_ALPHA,
+  ['V'] = LOX_CHAR_ALPHA, ['W'] = LOX_CHAR_ALPHA, ['X'] = LOX_CHAR_ALPHA,
+  ['Y'] = LOX_CHAR_ALPHA, ['Z'] = LOX_CHAR_ALPHA,
+  ['_'] = LOX_CHAR_ALPHA
+};
+
+/*
+ * Token of every LOX_CHAR_SINGLE character, and of the one-character
+ * form of every LOX_CHAR_OPERATOR one. The two-character form always
+ * follows it in lox_token_e.
+ */
+static const uint8_t lox_char_tokens[256] = {
+  ['('] = LOX_LEFT_PAREN, [')'] = LOX_RIGHT_PAREN, ['{'] = LOX_LEFT_BRACE,
+  ['}'] = LOX_RIGHT_BRACE, [','] = LOX_COMMA, ['.'] = LOX_DOT,
+  ['-'] = LOX_MINUS, ['+'] = LOX_PLUS, [';'] = LOX_SEMICOLON,
+  ['*'] = LOX_STAR, ['/'] = LOX_SLASH,
+
+  ['!'] = LOX_BANG, ['='] = LOX_EQUAL, ['<'] = LOX_LESS, ['>'] = LOX_GREATER
+};
+
 static bool
 lox_lexer_verify_digit
 (
   char _digit
 )
 {
-  return (_digit >= '0' && _digit <= '9');
+  return lox_char_classes[(uint8_t)_digit] == LOX_CHAR_DIGIT;
 }
 
 static bool
@@ -15,502 +86,751 @@ lox_lexer_verify_alpha
   char _char
 )
 {
-  return (_char >= 'a' && _char <= 'z') ||
-         (_char >= 'A' && _char <= 'Z') ||
-         (_char == '_');
+  return lox_char_classes[(uint8_t)_char] == LOX_CHAR_ALPHA;
+}
+
+/*
+ * Every power of ten a double holds exactly.
+ */
+static const double lox_exact_powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Parses digits with at most one '.' straight from the source, without
+ * looking at the locale. When the digits make an integer of at most
+ * 2^53 and there are at most 22 of them after the point, both it and
+ * the power of ten are exact doubles, so the single division rounds
+ * correctly (Clinger's fast path). Returns false for anything else,
+ * which strtod has to handle.
+ */
+static bool
+lox_lexer_parse_number
+(
+  const char *_digits,
+  long        _length,
+  double     *_number
+)
+{
+#if FLT_EVAL_METHOD == 0
+  const uint64_t max_exact_integer = (uint64_t)1 << 53;
+
+  uint64_t mantissa = 0;
+  long fraction_length = -1;
+  for (long i = 0; i < _length; ++i)
+  {
+    if (_digits[i] == '.')
+    {
+      fraction_length = 0;
+
+      continue;
+    }
+
+    mantissa = mantissa * 10 + (uint64_t)(_digits[i] - '0');
+    if (mantissa > max_exact_integer)
+    {
+      return false;
+    }
+
+    if (fraction_length >= 0)
+    {
+      ++fraction_length;
+    }
+  }
+
+  if (fraction_length <= 0)
+  {
+    *_number = (double)mantissa;
+
+    return true;
+  }
+
+  if (fraction_length < (long)(sizeof(lox_exact_powers_of_ten) / sizeof(double)))
+  {
+    *_number = (double)mantissa / lox_exact_powers_of_ten[fraction_length];
+
+    return true;
+  }
+#else
+  (void)_digits;
+  (void)_length;
+  (void)_number;
+#endif
+
+  return false;
+}
+
+bool
+lox_lexer_reserve_tokens
+(
+  lox_lexer_t *_lexer,
+  long         _capacity
+)
+{
+  if (_capacity <= _lexer->token_capacity)
+  {
+    return true;
+  }
+
+  long new_capacity = (_lexer->token_capacity > 0)
+                      ? _lexer->token_capacity
+                      : LOX_LEXER_INITIAL_TOKEN_CAPACITY;
+  while (new_capacity < _capacity)
+  {
+    new_capacity *= 2;
+  }
+
+  // Tokens from a token cache aren't ours to realloc, they get copied out
+  const bool is_cached = _lexer->token_cache.data != NULL;
+  lox_token_t *new_tokens = realloc(is_cached ? NULL : _lexer->tokens,
+                                    new_capacity * sizeof(lox_token_t));
+  if (new_tokens == NULL)
+  {
+    fprintf(stderr, "failed to grow token buffer to %ld tokens\n", new_capacity);
+
+    return false;
+  }
+
+  if (is_cached)
+  {
+    memcpy(new_tokens, _lexer->tokens, _lexer->token_count * sizeof(lox_token_t));
+    lox_source_close(&_lexer->token_cache);
+  }
+
+  _lexer->tokens = new_tokens;
+  _lexer->token_capacity = new_capacity;
+  LOX_STATS_ONLY(++_lexer->stats.token_buffer_growth_count;)
+  LOX_STATS_ONLY(_lexer->stats.token_buffer_bytes += new_capacity * sizeof(lox_token_t);)
+
+  return true;
+}
+
+/*
+ * Whether _char is past the end of the current window while more input
+ * will follow it, i.e. whether the token being scanned may continue.
+ */
+static bool
+lox_lexer_hits_window_end
+(
+  const lox_lexer_t *_lexer,
+  const char        *_char
+)
+{
+  return _lexer->has_more_input && _char >= _lexer->source + _lexer->source_length;
+}
+
+static char
+lox_lexer_peek
+(
+  const lox_lexer_t *_lexer,
+  const char        *_char
+)
+{
+  return (_char < _lexer->source + _lexer->source_length) ? *_char : '\0';
 }
 
 lox_token_t
 *lox_push_token
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_last_token,
   lox_token_e  _type,
-  char        *_lexeme,
-  bool         _is_lexeme_allocated,
-  void        *_literal
+  long         _offset,
+  long         _length
 )
 {
-  lox_token_t *new_token = malloc(sizeof(lox_token_t));
-  if (new_token == NULL)
+  if (!lox_lexer_reserve_tokens(_lexer, _lexer->token_count + 1))
   {
-    fprintf(stderr, "failed to allocate memory for new token\n");
-
     return NULL;
   }
 
-  new_token->type = _type;
-  new_token->lexeme = _lexeme;
-  new_token->is_lexeme_allocated = _is_lexeme_allocated;
-  new_token->literal = _literal;
-  new_token->line = _lexer->line_count;
-  new_token->next = NULL;
+  LOX_STATS_ONLY(++_lexer->stats.token_counts[_type];)
 
-  if (_last_token != NULL)
-    _last_token->next = new_token;
+  lox_token_t *new_token = &_lexer->tokens[_lexer->token_count];
+  new_token->type = _type;
+  new_token->offset = _offset;
+  new_token->length = _length;
+  new_token->literal_kind = LOX_LITERAL_NONE;
+  new_token->literal.number = 0.0;
 
   ++_lexer->token_count;
 
   return new_token;
 }
 
-lox_lexer_t
-*lox_lexer_analyze_source
+lox_token_t
+*lox_lexer_get_token
 (
-  char *_source
+  lox_lexer_t *_lexer,
+  long         _index
 )
+{
+  if (_index < 0 || _index >= _lexer->token_count)
+  {
+    return NULL;
+  }
+
+  return &_lexer->tokens[_index];
+}
+
+lox_lexer_t
+*lox_lexer_create
+(void)
 {
   lox_lexer_t *new_lexer = malloc(sizeof(lox_lexer_t));
   if (new_lexer == NULL)
   {
     fprintf(stderr, "failed to allocate memory for new lexer\n");
-    
+
+    return NULL;
+  }
+  new_lexer->tokens = NULL;
+  new_lexer->token_count = 0;
+  new_lexer->token_capacity = 0;
+  memset(&new_lexer->token_cache, 0, sizeof(new_lexer->token_cache));
+  new_lexer->source = "";
+  new_lexer->source_length = 0;
+  new_lexer->has_more_input = false;
+  new_lexer->is_in_comment = false;
+  new_lexer->is_speculative = false;
+  new_lexer->had_error = false;
+  LOX_STATS_ONLY(memset(&new_lexer->stats, 0, sizeof(new_lexer->stats));)
+  lox_line_index_init(&new_lexer->line_index);
+  new_lexer->source_line = 0;
+  new_lexer->source_column = 0;
+  new_lexer->kernels = lox_simd_get_kernels();
+  new_lexer->interner = NULL;
+
+  new_lexer->arena = lox_arena_create(LOX_ARENA_DEFAULT_BLOCK_SIZE);
+  if (new_lexer->arena == NULL)
+  {
+    free(new_lexer);
+
     return NULL;
   }
-  new_lexer->line_count = 0;
 
-  new_lexer->identifier_table = lox_create_and_populate_identifier_table();
-  if (new_lexer->identifier_table == NULL)
+  new_lexer->interner = lox_create_interner(new_lexer->arena);
+  if (new_lexer->interner == NULL)
   {
+    lox_lexer_clean(new_lexer);
+
     return NULL;
   }
 
-  new_lexer->head = lox_push_token(new_lexer,
-                                   NULL,
-                                   LOX_BOF,
-                                   "",
-                                   false,
-                                   NULL);
-  if (new_lexer->head == NULL)
+  return new_lexer;
+}
+
+lox_lexer_t
+*lox_lexer_analyze_source
+(
+  const char *_source,
+  long        _source_length
+)
+{
+  lox_lexer_t *new_lexer = lox_lexer_create();
+  if (new_lexer == NULL)
   {
     return NULL;
   }
 
-  new_lexer->source = _source;
-  lox_token_t *last_token = lox_lexer_scan_tokens(new_lexer);
+  if (!lox_lexer_reset(new_lexer, _source, _source_length))
+  {
+    lox_lexer_clean(new_lexer);
 
-  lox_push_token(new_lexer,
-                 last_token,
-                 LOX_EOF,
-                 "",
-                 false,
-                 NULL);
+    return NULL;
+  }
 
   return new_lexer;
 }
 
-lox_token_t
-*lox_lexer_scan_tokens
+bool
+lox_lexer_reset
 (
-  lox_lexer_t *_lexer
+  lox_lexer_t *_lexer,
+  const char  *_source,
+  long         _source_length
 )
 {
-  lox_token_t *current_token = _lexer->head;
-  long char_count = 0;
-  char *current_char = _lexer->source;
-  while (*current_char != '\0' && char_count < strlen(_lexer->source))
+  if (_source_length > LOX_LEXER_MAX_SOURCE_LENGTH)
   {
-    switch (*current_char)
-    {
-      case ' ':
-      case '\r':
-      case '\t':
-      case '#':
-        break;
-      case '\n':
-        ++_lexer->line_count;
-
-        break;
-      case '(':
-        lox_push_token(_lexer, current_token, LOX_LEFT_PAREN,
-                       "(", false, NULL);
-
-        break;
-      case ')':
-        lox_push_token(_lexer, current_token, LOX_RIGHT_PAREN,
-                       ")", false, NULL);
-
-        break;
-      case '{':
-        lox_push_token(_lexer, current_token, LOX_LEFT_BRACE,
-                       "{", false, NULL);
-
-        break;
-      case '}':
-        lox_push_token(_lexer, current_token, LOX_RIGHT_BRACE,
-                       "}", false, NULL);
-
-        break;
-      case ',':
-        lox_push_token(_lexer, current_token, LOX_COMMA,
-                       ",", false, NULL);
-
-        break;
-      case '.':
-        lox_push_token(_lexer, current_token, LOX_DOT,
-                       ".", false, NULL);
-
-        break;
-      case '-':
-        lox_push_token(_lexer, current_token, LOX_MINUS,
-                       "-", false, NULL);
-
-        break;
-      case '+':
-        lox_push_token(_lexer, current_token, LOX_PLUS,
-                       "+", false, NULL);
-
-        break;
-      case ';':
-        lox_push_token(_lexer, current_token, LOX_SEMICOLON,
-                       ";", false, NULL);
-
-        break;
-      case '*':
-        lox_push_token(_lexer, current_token, LOX_STAR,
-                       "*", false, NULL);
-
-        break;
-      case '/':
-        lox_push_token(_lexer, current_token, LOX_SLASH,
-                       "/", false, NULL);
-
-        break;
-      case '!':
-      {
-        int chars_to_skip = lox_lexer_scan_long_lexeme(_lexer, current_token, current_char,
-                                                       "!=", LOX_BANG, LOX_BANG_EQUAL);
-        char_count += chars_to_skip;
-      } break;
-      case '=':
-      {
-        int chars_to_skip = lox_lexer_scan_long_lexeme(_lexer, current_token, current_char,
-                                                       "==", LOX_EQUAL, LOX_EQUAL_EQUAL);
+    fprintf(stderr, "source of %ld bytes is longer than %ld bytes\n",
+            _source_length, LOX_LEXER_MAX_SOURCE_LENGTH);
 
-        char_count += chars_to_skip;
-      } break;
-      case '<':
-      {
-        int chars_to_skip = lox_lexer_scan_long_lexeme(_lexer, current_token, current_char,
-                                                       "<=", LOX_LESS, LOX_LESS_EQUAL);
+    return false;
+  }
 
-        char_count += chars_to_skip;
-      } break;
-      case '>':
-      {
-        int chars_to_skip = lox_lexer_scan_long_lexeme(_lexer, current_token, current_char,
-                                                       ">=", LOX_GREATER, LOX_GREATER_EQUAL);
+  // Mapped tokens can't be written to, the next push allocates a buffer
+  if (_lexer->token_cache.data != NULL)
+  {
+    lox_source_close(&_lexer->token_cache);
+    _lexer->tokens = NULL;
+    _lexer->token_capacity = 0;
+  }
+  _lexer->token_count = 0;
 
-        char_count += chars_to_skip;
-      } break;
-      case '"':
-      {
-        int chars_to_skip = lox_lexer_scan_string(_lexer, current_token, current_char);
+  // The interner lives in the arena, so it goes away with the names
+  lox_arena_reset(_lexer->arena);
+  _lexer->interner = lox_create_interner(_lexer->arena);
+  if (_lexer->interner == NULL)
+  {
+    return false;
+  }
 
-        char_count += chars_to_skip;
-      } break;
-      default:
-      {
-        if (lox_lexer_verify_digit(*current_char))
-        {
-          int chars_to_skip = lox_lexer_scan_number(_lexer, current_token, current_char);
+  _lexer->source = _source;
+  _lexer->source_length = _source_length;
+  _lexer->has_more_input = false;
+  _lexer->is_in_comment = false;
+  _lexer->is_speculative = false;
+  _lexer->had_error = false;
+  _lexer->source_line = 0;
+  _lexer->source_column = 0;
+  lox_line_index_invalidate(&_lexer->line_index);
+
+  if (lox_push_token(_lexer, LOX_BOF, 0, 0) == NULL)
+  {
+    return false;
+  }
 
-          char_count += chars_to_skip;
-        }
-        else if (lox_lexer_verify_alpha(*current_char))
-        {
-          int chars_to_skip = lox_lexer_scan_identifier(_lexer, current_token, current_char);
+  // Programs average five to six bytes a token, so this underestimates
+  // and the buffer grows geometrically from there, without committing
+  // memory that the tokens never reach
+  lox_lexer_reserve_tokens(_lexer, _source_length / LOX_LEXER_BYTES_PER_TOKEN_GUESS + 2);
+  LOX_STATS_ONLY(const double scan_start = lox_stats_now();)
+  lox_lexer_scan_tokens(_lexer);
+  LOX_STATS_ONLY(_lexer->stats.phase_seconds[LOX_LEXER_PHASE_SCAN] += lox_stats_now() - scan_start;)
 
-          char_count += chars_to_skip;
-        }
-        else
-        {
-          fprintf(stderr, "unexpected character %c\n", *current_char);
-        }
-      } break;
-    }
+  return lox_push_token(_lexer, LOX_EOF, _source_length, 0) != NULL;
+}
+
+void
+lox_lexer_scan_tokens
+(
+  lox_lexer_t *_lexer
+)
+{
+  const long source_length = _lexer->source_length;
+  long char_count = 0;
+  while (char_count < source_length)
+  {
+    char_count += lox_lexer_scan_token(_lexer, char_count);
+  }
+  LOX_STATS_ONLY(_lexer->stats.scanned_bytes += char_count;)
+}
+
+long
+lox_lexer_scan_token
+(
+  lox_lexer_t *_lexer,
+  long         _offset
+)
+{
+  const char *current_char = _lexer->source + _offset;
+  const char *source_end = _lexer->source + _lexer->source_length;
+  if (_lexer->is_in_comment)
+  {
+    return lox_lexer_scan_comment(_lexer, current_char);
+  }
 
-    if (current_token->next != NULL)
+  long chars_to_skip = 0;
+  switch (lox_char_classes[(uint8_t)*current_char])
+  {
+    case LOX_CHAR_WHITESPACE:
+      // Whitespace produces no token, the whole run is consumed at once
+      return _lexer->kernels->skip_whitespace(current_char, source_end) - current_char;
+    case LOX_CHAR_COMMENT:
+      return lox_lexer_scan_comment(_lexer, current_char);
+    case LOX_CHAR_SINGLE:
+      lox_push_token(_lexer, lox_char_tokens[(uint8_t)*current_char], _offset, 1);
+
+      break;
+    case LOX_CHAR_OPERATOR:
     {
-      current_token = current_token->next;
-    }
+      const lox_token_e short_token = lox_char_tokens[(uint8_t)*current_char];
+      chars_to_skip = lox_lexer_scan_long_lexeme(_lexer, current_char,
+                                                 short_token, short_token + 1);
+    } break;
+    case LOX_CHAR_QUOTE:
+      chars_to_skip = lox_lexer_scan_string(_lexer, current_char);
+
+      break;
+    case LOX_CHAR_DIGIT:
+      chars_to_skip = lox_lexer_scan_number(_lexer, current_char);
+
+      break;
+    case LOX_CHAR_ALPHA:
+      chars_to_skip = lox_lexer_scan_identifier(_lexer, current_char);
+
+      break;
+    default:
+      if (_lexer->is_speculative)
+      {
+        return LOX_LEXER_INCOMPLETE;
+      }
+      lox_lexer_report(_lexer, _offset, "unexpected character %c", *current_char);
 
-    ++char_count;
-    current_char = _lexer->source + char_count;
+      break;
   }
 
-  return current_token;
+  if (chars_to_skip == LOX_LEXER_INCOMPLETE)
+  {
+    return LOX_LEXER_INCOMPLETE;
+  }
+
+  return chars_to_skip + 1;
 }
 
-int
+long
 lox_lexer_scan_long_lexeme
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme,
-  char        *_compare,
+  const char  *_lexeme,
   lox_token_e  _short_token,
   lox_token_e  _long_token
 )
 {
-  bool has_compare = lox_lexer_look_ahead_and_match(_lexeme, _compare + 1);
-
-  const unsigned long compare_length = strlen(_compare);
-  char *lexeme = calloc(compare_length, sizeof(char));
-  if (lexeme == NULL)
+  if (lox_lexer_hits_window_end(_lexer, _lexeme + 1))
   {
-    fprintf(stderr, "failed to allocate memory for %c lexeme\n", *_lexeme);
-
-    return -1;
+    return LOX_LEXER_INCOMPLETE;
   }
 
+  bool has_compare = lox_lexer_look_ahead_and_match(_lexer, _lexeme, "=");
+
   lox_token_e token_type = _long_token;
-  int chars_to_skip = (int)(compare_length);
-  if (has_compare)
-  {
-    sprintf(lexeme, "%s", _compare);
-  }
-  else
+  long chars_to_skip = 1;
+  long lexeme_length = 2;
+  if (!has_compare)
   {
     token_type = _short_token;
-    *lexeme = *_compare;
     chars_to_skip = 0;
+    lexeme_length = 1;
   }
 
-  lox_push_token(_lexer, _current_token,
-                 token_type, lexeme,
-                 true, NULL);
+  lox_push_token(_lexer, token_type, _lexeme - _lexer->source, lexeme_length);
 
   return chars_to_skip;
 }
 
-int
+long
+lox_lexer_scan_comment
+(
+  lox_lexer_t *_lexer,
+  const char  *_lexeme
+)
+{
+  const char *source_end = _lexer->source + _lexer->source_length;
+  const char *line_end = _lexer->kernels->find_line_end(_lexeme, source_end);
+
+  // The comment goes on in the next window, which must skip to its end too
+  _lexer->is_in_comment = _lexer->has_more_input && line_end >= source_end;
+
+  return line_end - _lexeme;
+}
+
+long
 lox_lexer_scan_string
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme
+  const char  *_lexeme
 )
 {
   if (*_lexeme != '"')
   {
     fprintf(stderr, "given lexeme isn't a string\n");
 
-    return -1;
+    return 0;
   }
 
-  int string_length = 0;
-  char *current_char = _lexeme + 1;
-  bool should_continue_reading = true;
-  while (should_continue_reading)
-  {
-    if (*current_char == '"' || *current_char == '\0')
-    {
-      should_continue_reading = false;
-
-      continue;
-    }
+  const char *source_end = _lexer->source + _lexer->source_length;
+  const char *current_char = _lexer->kernels->find_string_end(_lexeme + 1, source_end);
+  const long string_length = current_char - (_lexeme + 1);
 
-    ++string_length;
-    ++current_char;
+  if (lox_lexer_hits_window_end(_lexer, current_char))
+  {
+    return LOX_LEXER_INCOMPLETE;
   }
 
-  if (*current_char == '\0')
+  if (current_char >= source_end)
   {
-    fprintf(stderr, "unterminated string\n");
+    lox_lexer_report(_lexer, _lexeme - _lexer->source, "unterminated string");
 
-    return -1;
+    // Nothing after an unterminated quote can be lexed meaningfully
+    return string_length;
   }
 
-  char *string_buffer = calloc(string_length, sizeof(char));
-  if (string_buffer == NULL)
+  // The lexeme keeps both quotes, see lox_lexer_token_string for the body
+  lox_token_t *token = lox_push_token(_lexer, LOX_STRING, _lexeme - _lexer->source,
+                                      string_length + 2);
+  if (token != NULL && _lexer->interner != NULL)
   {
-    fprintf(stderr, "failed to allocate memory while reading string\n");
-
-    return -1;
+    token->literal_kind = LOX_LITERAL_INTERNED;
+    token->literal.id = lox_intern(_lexer->interner, _lexeme + 1, string_length);
   }
-  strncpy(string_buffer, (_lexeme + 1), string_length);
-
-  lox_push_token(_lexer, _current_token, LOX_STRING,
-                 "string", false, (void *)string_buffer);
 
   return string_length + 1;
 }
 
-int
+long
 lox_lexer_scan_number
-  (
-    lox_lexer_t *_lexer,
-    lox_token_t *_current_token,
-    char        *_lexeme
+(
+  lox_lexer_t *_lexer,
+  const char  *_lexeme
 )
 {
   if (!lox_lexer_verify_digit(*_lexeme))
   {
     fprintf(stderr, "given lexeme isn't a number\n");
 
-    return -1;
+    return 0;
   }
 
-  int number_length = 0;
-  char *current_char = _lexeme;
-  bool should_continue_reading = true;
-  while (should_continue_reading)
+  const char *source_end = _lexer->source + _lexer->source_length;
+  const char *current_char = _lexer->kernels->skip_digits(_lexeme + 1, source_end);
+  if (lox_lexer_peek(_lexer, current_char) == '.' &&
+      lox_lexer_verify_digit(lox_lexer_peek(_lexer, current_char + 1)))
   {
-    if (!lox_lexer_verify_digit(*current_char))
+    current_char = _lexer->kernels->skip_digits(current_char + 2, source_end);
+  }
+  const long number_length = current_char - _lexeme;
+
+  // A trailing '.' needs the next character to tell if it's a fraction
+  if (lox_lexer_hits_window_end(_lexer, current_char) ||
+      (*current_char == '.' && lox_lexer_hits_window_end(_lexer, current_char + 1)))
+  {
+    return LOX_LEXER_INCOMPLETE;
+  }
+
+  double number;
+  if (!lox_lexer_parse_number(_lexeme, number_length, &number))
+  {
+    // strtod needs a terminated buffer, so the digits get copied once more.
+    // It follows LC_NUMERIC, which lox leaves at "C"
+    char short_buffer[64];
+    char *number_buffer = short_buffer;
+    if (number_length >= (long)sizeof(short_buffer))
     {
-      if (*current_char == '.' && lox_lexer_verify_digit(*(current_char + 1)))
+      // Long literals are rare, they get a buffer of their own
+      number_buffer = malloc(number_length + 1);
+      if (number_buffer == NULL)
       {
-        ++number_length;
-        ++current_char;
-      }
-      else
-      {
-        should_continue_reading = false;
+        if (_lexer->is_speculative)
+        {
+          return LOX_LEXER_INCOMPLETE;
+        }
+        lox_lexer_report(_lexer, _lexeme - _lexer->source, "out of memory reading number literal");
 
-        continue;
+        return number_length - 1;
       }
     }
+    memcpy(number_buffer, _lexeme, number_length);
+    number_buffer[number_length] = '\0';
 
-    ++number_length;
-    ++current_char;
-  }
-
-  char *number_buffer = calloc(number_length, sizeof(char));
-  if (number_buffer == NULL)
-  {
-    fprintf(stderr, "failed to allocate memory for number lexeme\n");
-
-    return -1;
+    number = strtod(number_buffer, NULL);
+    if (number_buffer != short_buffer)
+    {
+      free(number_buffer);
+    }
   }
-  strncpy(number_buffer, _lexeme, number_length);
 
-  char *temp_buffer;
-  double *parsed_number = malloc(sizeof(double));
-  if (parsed_number == NULL)
+  lox_token_t *token = lox_push_token(_lexer, LOX_NUMBER, _lexeme - _lexer->source, number_length);
+  if (token != NULL)
   {
-    fprintf(stderr, "failed to allocate memory for number\n");
-
-    return -1;
+    token->literal_kind = LOX_LITERAL_NUMBER;
+    token->literal.number = number;
   }
-  *parsed_number = strtod(number_buffer, &temp_buffer);
-
-  lox_push_token(_lexer, _current_token, LOX_NUMBER,
-                 "number", false, (void *)parsed_number);
 
-  free(number_buffer);
-
-  return number_length;
+  return number_length - 1;
 }
 
-int
+long
 lox_lexer_scan_identifier
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme
+  const char  *_lexeme
 )
 {
   if (!lox_lexer_verify_alpha(*_lexeme))
   {
-    fprintf(stderr, "given lexeme isn't alpha");
+    fprintf(stderr, "given lexeme isn't alpha\n");
 
-    return -1;
+    return 0;
   }
 
-  int identifier_length = 0;
-  char *current_char = _lexeme;
-  while (lox_lexer_verify_alpha(*current_char) ||
-         lox_lexer_verify_digit(*current_char))
+  const char *source_end = _lexer->source + _lexer->source_length;
+  const char *current_char = _lexer->kernels->skip_identifier(_lexeme + 1, source_end);
+  const long identifier_length = current_char - _lexeme;
+
+  if (lox_lexer_hits_window_end(_lexer, current_char))
   {
-    ++current_char;
-    ++identifier_length;
+    return LOX_LEXER_INCOMPLETE;
   }
 
-  char *identifier_name_buffer = calloc(identifier_length, sizeof(char));
-  if (identifier_name_buffer == NULL)
-  {
-    fprintf(stderr, "failed to allocate memory for identifier buffer\n");
+  lox_token_e token_type = lox_find_keyword(_lexeme, identifier_length);
 
-    return -1;
-  }
-  strncpy(identifier_name_buffer, _lexeme, identifier_length);
-  
-  lox_identifier_t *identifier = lox_find_identifier(_lexer->identifier_table, identifier_name_buffer);
-  if (identifier == NULL)
+  lox_token_t *token = lox_push_token(_lexer, token_type, _lexeme - _lexer->source,
+                                      identifier_length);
+  if (token != NULL && token_type == LOX_IDENTIFIER && _lexer->interner != NULL)
   {
-    lox_push_token(_lexer, _current_token, LOX_IDENTIFIER, "id", false, identifier_name_buffer);
+    token->literal_kind = LOX_LITERAL_INTERNED;
+    token->literal.id = lox_intern(_lexer->interner, _lexeme, identifier_length);
   }
-  else
-  {
-    lox_push_token(_lexer, _current_token, identifier->type, "id", false, identifier->name);
 
-    free(identifier_name_buffer);
+  return identifier_length - 1;
+}
+
+lox_string_view_t
+lox_lexer_token_lexeme
+(
+  const lox_lexer_t *_lexer,
+  const lox_token_t *_token
+)
+{
+  lox_string_view_t view = {
+    .data = _lexer->source + _token->offset,
+    .length = _token->length
+  };
+
+  return view;
+}
+
+lox_string_view_t
+lox_lexer_token_string
+(
+  const lox_lexer_t *_lexer,
+  const lox_token_t *_token
+)
+{
+  lox_string_view_t view = lox_lexer_token_lexeme(_lexer, _token);
+  if (_token->type == LOX_STRING && view.length >= 2)
+  {
+    ++view.data;
+    view.length -= 2;
   }
 
-  return identifier_length;
+  return view;
 }
 
 bool
 lox_lexer_look_ahead_and_match(
-  char *_lexeme,
-  char *_compare
+  const lox_lexer_t *_lexer,
+  const char        *_lexeme,
+  const char        *_compare
 )
 {
-  unsigned long length_ahead = strlen(_compare);
-  bool has_compare = strncmp((_lexeme + 1), _compare, length_ahead) == 0;
+  const long length_ahead = (long)strlen(_compare);
+  const long length_left = _lexer->source_length - (_lexeme + 1 - _lexer->source);
+  bool has_compare = length_ahead <= length_left &&
+                     strncmp((_lexeme + 1), _compare, length_ahead) == 0;
 
   return has_compare;
 }
 
+lox_location_t
+lox_lexer_locate
+(
+  lox_lexer_t *_lexer,
+  long         _offset
+)
+{
+  lox_location_t location = { .line = 0, .column = 0 };
+  if (!lox_line_index_is_built_for(&_lexer->line_index, _lexer->source,
+                                   _lexer->source_length) &&
+      !lox_line_index_build(&_lexer->line_index, _lexer->source,
+                            _lexer->source_length, _lexer->kernels))
+  {
+    return location;
+  }
+
+  location = lox_line_index_locate(&_lexer->line_index, _offset);
+  if (location.line == 1)
+  {
+    location.column += _lexer->source_column;
+  }
+  location.line += _lexer->source_line;
+
+  return location;
+}
+
+void
+lox_lexer_report
+(
+  lox_lexer_t *_lexer,
+  long         _offset,
+  const char  *_format,
+  ...
+)
+{
+  _lexer->had_error = true;
+  const lox_location_t location = lox_lexer_locate(_lexer, _offset);
+  fprintf(stderr, "%ld:%ld: ", location.line, location.column);
+
+  va_list arguments;
+  va_start(arguments, _format);
+  vfprintf(stderr, _format, arguments);
+  va_end(arguments);
+
+  fputc('\n', stderr);
+}
+
+void
+lox_lexer_debug_token
+(
+  const lox_lexer_t *_lexer,
+  long               _index,
+  const lox_token_t *_token
+)
+{
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_lexer, _token);
+  if (_token->literal_kind == LOX_LITERAL_NUMBER)
+  {
+    printf("tok [%ld]: %.*s %.17g\n", _index, (int)lexeme.length, lexeme.data,
+           _token->literal.number);
+  }
+  else
+  {
+    printf("tok [%ld]: %.*s\n", _index, (int)lexeme.length, lexeme.data);
+  }
+}
+
 void
 lox_lexer_debug_tokens
 (
   lox_lexer_t *_lexer
 )
 {
-  lox_token_t *current_token = _lexer->head;
-  long token_count = 0;
-  while (current_token != NULL && token_count < _lexer->token_count)
+  for (long i = 0; i < _lexer->token_count; ++i)
   {
-    printf("tok [%p]: %s %p\n", current_token, current_token->lexeme,
-           (current_token->literal != NULL) ? current_token->literal : NULL);
-
-    current_token = current_token->next;
-    ++token_count;
+    lox_lexer_debug_token(_lexer, i, &_lexer->tokens[i]);
   }
 }
 
 void
-lox_lexer_clean
+lox_lexer_release_tokens
 (
   lox_lexer_t *_lexer
 )
 {
-  lox_clean_identifier_table(_lexer->identifier_table);
-
-  lox_token_t *current_token, *next_token;
-  current_token = _lexer->head;
-  next_token = current_token->next;
-  while (current_token != NULL)
+  if (_lexer->token_cache.data != NULL)
   {
-    if (current_token->is_lexeme_allocated)
-    {
-      free(current_token->lexeme);
-    }
-
-    if (current_token->literal != NULL &&
-        current_token->type == LOX_IDENTIFIER)
-    {
-      free(current_token->literal);
-    }
+    lox_source_close(&_lexer->token_cache);
+  }
+  else
+  {
+    free(_lexer->tokens);
+  }
 
-    free(current_token);
-    current_token = next_token;
+  _lexer->tokens = NULL;
+  _lexer->token_count = 0;
+  _lexer->token_capacity = 0;
+}
 
-    if (next_token != NULL)
-    {
-      next_token = next_token->next;
-    }
-  }
-}
\ No newline at end of file
+void
+lox_lexer_clean
+(
+  lox_lexer_t *_lexer
+)
+{
+  lox_arena_clean(_lexer->arena);
+  lox_line_index_clean(&_lexer->line_index);
+  lox_lexer_release_tokens(_lexer);
+  free(_lexer);
+}
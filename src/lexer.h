@@ -2,94 +2,308 @@
 #define LOX_LEXER_H
 
 #include "base.h"
+#include "arena.h"
 #include "identifier.h"
+#include "line_index.h"
+#include "simd.h"
+#include "source.h"
 
-typedef struct lox_token_t lox_token_t;
-typedef struct lox_token_t
+#define LOX_LEXER_INITIAL_TOKEN_CAPACITY 256
+#define LOX_LEXER_BYTES_PER_TOKEN_GUESS  8
+#define LOX_LEXER_INCOMPLETE             (-1)
+// Token offsets are 32-bit
+#define LOX_LEXER_MAX_SOURCE_LENGTH      ((long)UINT32_MAX)
+
+/*
+ * Non-owning view into a buffer, not necessarily NUL-terminated.
+ */
+typedef struct lox_string_view_t
 {
-  lox_token_e  type;
-  char        *lexeme;
-  bool         is_lexeme_allocated;
-  void        *literal;
-  long         line;
+  const char *data;
+  long        length;
+} lox_string_view_t;
 
-  lox_token_t *next;
+typedef enum lox_literal_e
+{
+  LOX_LITERAL_NONE,
+  LOX_LITERAL_NUMBER,
+  // Name of an identifier, or body of a string
+  LOX_LITERAL_INTERNED
+} lox_literal_e;
+
+typedef union lox_literal_t
+{
+  double          number;
+  lox_intern_id_t id;
+} lox_literal_t;
+
+/*
+ * A token doesn't own its text: offset and length slice the lexer's
+ * source, see lox_lexer_token_lexeme, and lox_lexer_locate turns the
+ * offset into a line and column. Its literal is stored inline and
+ * literal_kind tells which member, if any, is set. type and
+ * literal_kind hold a lox_token_e and a lox_literal_e in a byte each,
+ * which with 32-bit positions keeps a token at 24 bytes.
+ */
+typedef struct lox_token_t
+{
+  uint8_t       type;
+  uint8_t       literal_kind;
+  uint32_t      offset;
+  uint32_t      length;
+  lox_literal_t literal;
 } lox_token_t;
 
+_Static_assert(sizeof(lox_token_t) <= 24, "lox_token_t should fit in 24 bytes");
+
+typedef enum lox_lexer_phase_e
+{
+  LOX_LEXER_PHASE_SCAN,
+  // Only taken by lox_lexer_analyze_source_parallel
+  LOX_LEXER_PHASE_STITCH,
+  LOX_LEXER_PHASE_GATHER,
+
+  LOX_LEXER_PHASE_COUNT
+} lox_lexer_phase_e;
+
+/*
+ * Counters kept with LOX_STATS, see stats.h. Tokens are counted as
+ * they are pushed, so lexers that rescan text count it again.
+ */
+typedef struct lox_lexer_stats_t
+{
+  uint64_t token_counts[LOX_TOKEN_COUNT];
+  uint64_t scanned_bytes;
+  uint64_t token_buffer_growth_count;
+  uint64_t token_buffer_bytes;
+  double   phase_seconds[LOX_LEXER_PHASE_COUNT];
+} lox_lexer_stats_t;
+
+/*
+ * Tokens are stored contiguously and addressed by position, so
+ * pointers returned by lox_push_token are only valid until the
+ * next push. The interner lives in the lexer's arena and is released
+ * together with it.
+ */
 typedef struct lox_lexer_t
 {
-  lox_token_t *head;
+  lox_token_t *tokens;
+  long         token_count;
+  long         token_capacity;
+  // Mapped file the tokens point into when loaded by
+  // lox_token_cache_load, they are read-only until the next push
+  lox_source_t token_cache;
+
+  lox_arena_t    *arena;
+  lox_interner_t *interner;
+  const char *source;
+  long        source_length;
+  // Set when source is a window and more text follows it
+  bool        has_more_input;
+  // Set when a comment ran to the end of the previous window
+  bool        is_in_comment;
+  // Set when source may start inside a string, see lexer_parallel.h
+  bool        is_speculative;
+  // Set by lox_lexer_report, the tokens are then not fit to compile
+  bool        had_error;
 
-  lox_identifier_table_t *identifier_table;
-  char *source;
+  const lox_simd_kernels_t *kernels;
 
-  long token_count;
-  long line_count;
+  // Built by lox_lexer_locate on first use
+  lox_line_index_t line_index;
+  // Line and column before source[0] when source is a window, both 0
+  // for the start of the input
+  long             source_line;
+  long             source_column;
+
+  LOX_STATS_ONLY(lox_lexer_stats_t stats;)
 } lox_lexer_t;
 
+/*
+ * Grows the token buffer to hold at least _capacity tokens, copying
+ * them out of a token cache first if need be.
+ */
+bool
+lox_lexer_reserve_tokens
+(
+  lox_lexer_t *_lexer,
+  long         _capacity
+);
+
 lox_token_t
 *lox_push_token
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_last_token,
   lox_token_e  _type,
-  char        *_lexeme,
-  bool         _is_lexeme_allocated,
-  void        *_literal
+  long         _offset,
+  long         _length
+);
+
+lox_token_t
+*lox_lexer_get_token
+(
+  lox_lexer_t *_lexer,
+  long         _index
 );
 
+/*
+ * Creates a lexer without any source or tokens.
+ */
+lox_lexer_t
+*lox_lexer_create
+(void);
+
+/*
+ * _source doesn't need to be NUL-terminated and must outlive the
+ * lexer, tokens keep pointing into it. It can be at most
+ * LOX_LEXER_MAX_SOURCE_LENGTH bytes long.
+ */
 lox_lexer_t
 *lox_lexer_analyze_source
 (
-  char *_source
+  const char *_source,
+  long  _source_length
 );
 
-lox_token_t
-*lox_lexer_scan_tokens
+/*
+ * Lexes _source with an existing lexer, dropping its previous tokens
+ * and interned names but keeping the token buffer, the arena's last
+ * block and the line index allocated, so lexing many small sources
+ * doesn't set a lexer up for each. Same requirements on _source as
+ * lox_lexer_analyze_source. Returns false if it couldn't be lexed.
+ */
+bool
+lox_lexer_reset
+(
+  lox_lexer_t *_lexer,
+  const char  *_source,
+  long         _source_length
+);
+
+void
+lox_lexer_scan_tokens
 (
   lox_lexer_t *_lexer
 );
 
-int
+/*
+ * Scans whatever starts at _offset, pushing at most one token, and
+ * returns how many characters were consumed. Returns
+ * LOX_LEXER_INCOMPLETE without pushing anything when has_more_input is
+ * set and the token may continue past the end of the source, or when
+ * is_speculative is set and the text at _offset is malformed.
+ */
+long
+lox_lexer_scan_token
+(
+  lox_lexer_t *_lexer,
+  long         _offset
+);
+
+/*
+ * The scan functions push the token starting at _lexeme and return
+ * how many characters past _lexeme it spans, or LOX_LEXER_INCOMPLETE.
+ * lox_lexer_scan_long_lexeme picks _long_token when _lexeme is followed
+ * by '='.
+ */
+long
 lox_lexer_scan_long_lexeme
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme,
-  char        *_compare,
+  const char  *_lexeme,
   lox_token_e  _short_token,
   lox_token_e  _long_token
 );
 
-int
+/*
+ * Skips a comment up to, not including, its newline. Unlike the scan
+ * functions around it, pushes nothing and returns the characters
+ * consumed from _lexeme itself.
+ */
+long
+lox_lexer_scan_comment
+(
+  lox_lexer_t *_lexer,
+  const char  *_lexeme
+);
+
+long
 lox_lexer_scan_string
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme
+  const char  *_lexeme
 );
 
-int
+long
 lox_lexer_scan_number
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme
+  const char  *_lexeme
 );
 
-int
+long
 lox_lexer_scan_identifier
 (
   lox_lexer_t *_lexer,
-  lox_token_t *_current_token,
-  char        *_lexeme
+  const char  *_lexeme
+);
+
+lox_string_view_t
+lox_lexer_token_lexeme
+(
+  const lox_lexer_t *_lexer,
+  const lox_token_t *_token
+);
+
+/*
+ * Same as lox_lexer_token_lexeme, minus the quotes of string tokens.
+ */
+lox_string_view_t
+lox_lexer_token_string
+(
+  const lox_lexer_t *_lexer,
+  const lox_token_t *_token
 );
 
 bool
 lox_lexer_look_ahead_and_match
 (
-  char *_lexeme,
-  char *_compare
+  const lox_lexer_t *_lexer,
+  const char        *_lexeme,
+  const char        *_compare
+);
+
+/*
+ * Line and column of _offset in the input, building the line index if
+ * the source changed since it was last used. Returns line 0 if the
+ * index can't be built.
+ */
+lox_location_t
+lox_lexer_locate
+(
+  lox_lexer_t *_lexer,
+  long         _offset
+);
+
+/*
+ * Prints a diagnostic prefixed with the line and column of _offset,
+ * and sets had_error.
+ */
+void
+lox_lexer_report
+(
+  lox_lexer_t *_lexer,
+  long         _offset,
+  const char  *_format,
+  ...
+);
+
+void
+lox_lexer_debug_token
+(
+  const lox_lexer_t *_lexer,
+  long               _index,
+  const lox_token_t *_token
 );
 
 void
@@ -98,6 +312,16 @@ lox_lexer_debug_tokens
   lox_lexer_t *_lexer
 );
 
+/*
+ * Frees the tokens, or unmaps them if they came from a token cache,
+ * leaving the lexer with none. Its source and interner stay.
+ */
+void
+lox_lexer_release_tokens
+(
+  lox_lexer_t *_lexer
+);
+
 void
 lox_lexer_clean
 (
@@ -0,0 +1,26 @@
+#include "lexer_batch.h"
+
+long
+lox_lexer_analyze_batch
+(
+  lox_lexer_t             *_lexer,
+  const lox_string_view_t *_sources,
+  long                     _source_count,
+  lox_lexer_batch_fn       _visit,
+  void                    *_context
+)
+{
+  for (long i = 0; i < _source_count; ++i)
+  {
+    if (!lox_lexer_reset(_lexer, _sources[i].data, _sources[i].length))
+    {
+      fprintf(stderr, "failed to lex source %ld of the batch\n", i);
+
+      return i;
+    }
+
+    _visit(_context, i, _lexer);
+  }
+
+  return _source_count;
+}
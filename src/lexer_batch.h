@@ -0,0 +1,33 @@
+/*
+ * Implements lexing of many small sources with a single lexer, for
+ * callers going through thousands of short scripts at a time.
+ */
+
+#ifndef LOX_LEXER_BATCH_H
+#define LOX_LEXER_BATCH_H
+
+#include "base.h"
+#include "lexer.h"
+
+/*
+ * Called once _lexer holds the tokens of _sources[_source_index]. They
+ * are only valid until it returns, the next source reuses the lexer.
+ */
+typedef void (*lox_lexer_batch_fn)(void *_context, long _source_index, lox_lexer_t *_lexer);
+
+/*
+ * Lexes _sources in order with lox_lexer_reset on _lexer, calling
+ * _visit after each one. Returns how many sources were lexed, which is
+ * less than _source_count if one of them couldn't be.
+ */
+long
+lox_lexer_analyze_batch
+(
+  lox_lexer_t             *_lexer,
+  const lox_string_view_t *_sources,
+  long                     _source_count,
+  lox_lexer_batch_fn       _visit,
+  void                    *_context
+);
+
+#endif // LOX_LEXER_BATCH_H
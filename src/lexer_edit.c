@@ -0,0 +1,197 @@
+#include "lexer_edit.h"
+
+// Characters past its end a token may have looked at, for the '.' and
+// digit that make "1." a fraction
+#define LOX_LEXER_EDIT_LOOKAHEAD 2
+
+/*
+ * Index of the last token that ends far enough before _offset for its
+ * scan not to have looked at it, or 0 (BOF) if there is none. Tokens
+ * are sorted by offset and don't overlap, so their ends are sorted too.
+ * Lexing restarts at that token's start.
+ */
+static long
+lox_lexer_edit_find_restart
+(
+  const lox_lexer_t *_lexer,
+  long               _offset
+)
+{
+  // BOF and EOF are never re-lexed from
+  long low = 1;
+  long high = _lexer->token_count - 1;
+  while (low < high)
+  {
+    const long middle = low + (high - low) / 2;
+    const lox_token_t *token = &_lexer->tokens[middle];
+    if ((long)token->offset + token->length + LOX_LEXER_EDIT_LOOKAHEAD <= _offset)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low - 1;
+}
+
+/*
+ * Moves the old tokens from _old_index on to _new_index, shifting them
+ * by the edit. This pass over the whole tail dominates the cost of an
+ * edit, so it is kept to a memmove, skipped when the token count didn't
+ * change, and one tight loop.
+ */
+static void
+lox_lexer_edit_shift_tail
+(
+  lox_lexer_t *_lexer,
+  long         _old_index,
+  long         _new_index,
+  long         _offset_delta
+)
+{
+  const long tail_count = _lexer->token_count - _old_index;
+  lox_token_t *tail = _lexer->tokens + _new_index;
+  if (_new_index != _old_index)
+  {
+    memmove(tail, _lexer->tokens + _old_index, tail_count * sizeof(lox_token_t));
+  }
+
+  for (long i = 0; i < tail_count; ++i)
+  {
+    tail[i].offset += _offset_delta;
+  }
+}
+
+bool
+lox_lexer_apply_edit
+(
+  lox_lexer_t      *_lexer,
+  const char       *_source,
+  long              _source_length,
+  lox_lexer_edit_t  _edit
+)
+{
+  // At least BOF and EOF, which released or never lexed tokens lack
+  if (_lexer->token_count < 2)
+  {
+    fprintf(stderr, "lexer has no tokens to edit\n");
+
+    return false;
+  }
+
+  const long edit_end = _edit.offset + _edit.removed_length;
+  const long offset_delta = _edit.inserted_length - _edit.removed_length;
+  if (_edit.offset < 0 || _edit.removed_length < 0 || _edit.inserted_length < 0 ||
+      edit_end > _lexer->source_length ||
+      _source_length != _lexer->source_length + offset_delta)
+  {
+    fprintf(stderr, "edit doesn't match the source\n");
+
+    return false;
+  }
+
+  if (_source_length > LOX_LEXER_MAX_SOURCE_LENGTH)
+  {
+    fprintf(stderr, "source of %ld bytes is longer than %ld bytes\n",
+            _source_length, LOX_LEXER_MAX_SOURCE_LENGTH);
+
+    return false;
+  }
+
+  // Mapped tokens are read-only, they get copied out here
+  if (!lox_lexer_reserve_tokens(_lexer, _lexer->token_count + 1))
+  {
+    return false;
+  }
+
+  // Errors aren't tied to tokens, so once there was one the whole source
+  // is lexed again to tell whether the edit fixed it. Otherwise the
+  // tokens left as they are lexed cleanly, and only the re-lexed ones
+  // can report an error
+  const bool had_error = _lexer->had_error;
+  const long restart_index = had_error ? 0 : lox_lexer_edit_find_restart(_lexer, _edit.offset);
+  long first_new_index = 1;
+  long position = 0;
+  if (restart_index > 0)
+  {
+    first_new_index = restart_index;
+    position = _lexer->tokens[restart_index].offset;
+  }
+
+  // First old token that may be resynchronized with, EOF at the latest
+  long old_index = had_error ? _lexer->token_count - 1 : first_new_index;
+  while (_lexer->tokens[old_index].offset < edit_end)
+  {
+    ++old_index;
+  }
+
+  // New tokens are pushed to a scratch buffer, the old ones are needed
+  // to find where the two streams meet again
+  lox_token_t *old_tokens = _lexer->tokens;
+  const long old_token_count = _lexer->token_count;
+  const long old_token_capacity = _lexer->token_capacity;
+  const char *old_source = _lexer->source;
+  const long old_source_length = _lexer->source_length;
+
+  _lexer->tokens = NULL;
+  _lexer->token_count = 0;
+  _lexer->token_capacity = 0;
+  _lexer->source = _source;
+  _lexer->source_length = _source_length;
+  // The text may have changed in place, at the same address and length
+  lox_line_index_invalidate(&_lexer->line_index);
+  _lexer->is_in_comment = false;
+  _lexer->has_more_input = false;
+  _lexer->had_error = false;
+
+  for (;;)
+  {
+    while (old_tokens[old_index].offset + offset_delta < position)
+    {
+      ++old_index;
+    }
+
+    // Lexing from the same text at a token start can only repeat it
+    if (old_tokens[old_index].offset + offset_delta == position)
+    {
+      break;
+    }
+
+    const long consumed = lox_lexer_scan_token(_lexer, position);
+    LOX_STATS_ONLY(_lexer->stats.scanned_bytes += consumed;)
+    position += consumed;
+  }
+
+  lox_token_t *new_tokens = _lexer->tokens;
+  const long new_token_count = _lexer->token_count;
+
+  const long tail_index = first_new_index + new_token_count;
+  const long token_count = tail_index + (old_token_count - old_index);
+
+  _lexer->tokens = old_tokens;
+  _lexer->token_count = old_token_count;
+  _lexer->token_capacity = old_token_capacity;
+  if (!lox_lexer_reserve_tokens(_lexer, token_count))
+  {
+    free(new_tokens);
+    _lexer->source = old_source;
+    _lexer->source_length = old_source_length;
+    _lexer->had_error = had_error;
+
+    return false;
+  }
+
+  lox_lexer_edit_shift_tail(_lexer, old_index, tail_index, offset_delta);
+  if (new_token_count > 0)
+  {
+    memcpy(_lexer->tokens + first_new_index, new_tokens, new_token_count * sizeof(lox_token_t));
+  }
+  free(new_tokens);
+
+  _lexer->token_count = token_count;
+
+  return true;
+}
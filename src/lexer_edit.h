@@ -0,0 +1,47 @@
+/*
+ * Implements re-lexing of edited sources, for editors that keep the
+ * tokens of a file up to date as it is typed.
+ */
+
+#ifndef LOX_LEXER_EDIT_H
+#define LOX_LEXER_EDIT_H
+
+#include "base.h"
+#include "lexer.h"
+
+/*
+ * Replacement of removed_length bytes at offset by inserted_length
+ * new ones, in coordinates of the source before the edit.
+ */
+typedef struct lox_lexer_edit_t
+{
+  long offset;
+  long removed_length;
+  long inserted_length;
+} lox_lexer_edit_t;
+
+/*
+ * Brings the tokens of _lexer up to date with _source, the text it was
+ * lexed from with _edit applied, inserted bytes included. Lexing
+ * restarts at the last token that can't have seen the edit and stops
+ * as soon as a token starts where an old one after the edit did; the
+ * tokens past that point are only shifted. The result is the same as
+ * lexing _source from scratch, except for intern ids: names keep the
+ * ids they already had, and those that went away stay interned.
+ * had_error is brought up to date too, which takes lexing all of
+ * _source again when the old text had an error.
+ *
+ * Returns false, leaving the lexer untouched, if _edit doesn't match
+ * the two sources, the lexer has no tokens, or the token buffer can't
+ * grow.
+ */
+bool
+lox_lexer_apply_edit
+(
+  lox_lexer_t      *_lexer,
+  const char       *_source,
+  long              _source_length,
+  lox_lexer_edit_t  _edit
+);
+
+#endif // LOX_LEXER_EDIT_H
@@ -0,0 +1,490 @@
+#include <unistd.h>
+
+#include "lexer_parallel.h"
+#include "thread_pool.h"
+
+/*
+ * A slice of the source lexed on its own. stop is where its lexer gave
+ * up: end, or the start of a token it couldn't finish or make sense of.
+ */
+typedef struct lox_lexer_chunk_t
+{
+  long             start;
+  long             end;
+  long             stop;
+
+  lox_lexer_t     *lexer;
+  // Names interned before stop, the only ones its tokens refer to
+  uint32_t         interned_count;
+  // Chunk-local intern id to the result's one
+  lox_intern_id_t *id_map;
+} lox_lexer_chunk_t;
+
+/*
+ * A run of tokens to copy into the result, with the intern id fixups
+ * they need on the way.
+ */
+typedef struct lox_token_segment_t
+{
+  const lox_lexer_t     *lexer;
+  long                   first_token;
+  long                   token_count;
+  long                   result_index;
+  const lox_intern_id_t *id_map;
+} lox_token_segment_t;
+
+typedef struct lox_parallel_job_t
+{
+  const char *source;
+  long        source_length;
+
+  lox_lexer_chunk_t *chunks;
+  long               chunk_count;
+
+  lox_token_segment_t *segments;
+  long                 segment_count;
+
+  // Lexes serially whatever the chunks got wrong
+  lox_lexer_t *repair_lexer;
+  lox_lexer_t *result;
+} lox_parallel_job_t;
+
+static int
+lox_lexer_parallel_thread_count
+(
+  int _thread_count
+)
+{
+  if (_thread_count > 0)
+  {
+    return _thread_count;
+  }
+
+  const long core_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return (core_count > 0) ? (int)core_count : 1;
+}
+
+/*
+ * Cuts the source right after the first newline following each of
+ * _chunk_count evenly spaced offsets. Returns the number of non-empty
+ * chunks, which is smaller when lines are longer than chunks.
+ */
+static long
+lox_lexer_parallel_split
+(
+  lox_parallel_job_t *_job,
+  long                _chunk_count
+)
+{
+  const lox_simd_kernels_t *kernels = lox_simd_get_kernels();
+  const char *source_end = _job->source + _job->source_length;
+
+  long chunk_count = 0;
+  long start = 0;
+  for (long i = 1; i <= _chunk_count && start < _job->source_length; ++i)
+  {
+    long end = _job->source_length;
+    if (i < _chunk_count)
+    {
+      long split = i * (_job->source_length / _chunk_count);
+      if (split < start)
+      {
+        split = start;
+      }
+
+      const char *line_end = kernels->find_line_end(_job->source + split, source_end);
+      end = (line_end < source_end) ? line_end - _job->source + 1 : _job->source_length;
+    }
+
+    _job->chunks[chunk_count].start = start;
+    _job->chunks[chunk_count].end = end;
+    ++chunk_count;
+
+    start = end;
+  }
+
+  return chunk_count;
+}
+
+static void
+lox_lexer_parallel_scan_chunk
+(
+  void *_job,
+  long  _chunk_index
+)
+{
+  lox_parallel_job_t *job = _job;
+  lox_lexer_chunk_t *chunk = &job->chunks[_chunk_index];
+
+  chunk->stop = chunk->start;
+  chunk->lexer = lox_lexer_create();
+  if (chunk->lexer == NULL)
+  {
+    // The serial pass lexes the whole chunk instead
+    return;
+  }
+
+  lox_lexer_t *lexer = chunk->lexer;
+  lexer->source = job->source;
+  lexer->source_length = chunk->end;
+  // Tokens running into the next chunk, unterminated strings included,
+  // are left to the serial pass
+  lexer->has_more_input = true;
+  lexer->is_speculative = true;
+
+  long offset = chunk->start;
+  while (offset < chunk->end)
+  {
+    const long consumed = lox_lexer_scan_token(lexer, offset);
+    if (consumed == LOX_LEXER_INCOMPLETE)
+    {
+      break;
+    }
+
+    offset += consumed;
+  }
+
+  chunk->stop = offset;
+  chunk->interned_count = lexer->interner->entry_count;
+  LOX_STATS_ONLY(lexer->stats.scanned_bytes += offset - chunk->start;)
+}
+
+static void
+lox_lexer_parallel_push_segment
+(
+  lox_parallel_job_t    *_job,
+  const lox_lexer_t     *_lexer,
+  long                   _first_token,
+  const lox_intern_id_t *_id_map
+)
+{
+  const long token_count = _lexer->token_count - _first_token;
+  if (token_count == 0)
+  {
+    return;
+  }
+
+  lox_token_segment_t *segment = &_job->segments[_job->segment_count++];
+  segment->lexer = _lexer;
+  segment->first_token = _first_token;
+  segment->token_count = token_count;
+  segment->id_map = _id_map;
+}
+
+/*
+ * Interns the names of a chunk into the result in the order the chunk
+ * first saw them, which is the order a serial lexer would have.
+ */
+static bool
+lox_lexer_parallel_map_ids
+(
+  lox_parallel_job_t *_job,
+  lox_lexer_chunk_t  *_chunk
+)
+{
+  if (_chunk->interned_count == 0)
+  {
+    return true;
+  }
+
+  _chunk->id_map = malloc(_chunk->interned_count * sizeof(lox_intern_id_t));
+  if (_chunk->id_map == NULL)
+  {
+    fprintf(stderr, "failed to allocate intern id map of %u entries\n", _chunk->interned_count);
+
+    return false;
+  }
+
+  const lox_interner_t *chunk_interner = _chunk->lexer->interner;
+  for (uint32_t i = 0; i < _chunk->interned_count; ++i)
+  {
+    const lox_interned_t *interned = &chunk_interner->entries[i];
+    _chunk->id_map[i] = lox_intern(_job->result->interner, interned->name, interned->length);
+  }
+
+  return true;
+}
+
+/*
+ * Walks the source in order, taking the tokens of every chunk that
+ * starts where the previous token ended, and lexing serially from
+ * wherever a chunk stopped early up to the next chunk start a token
+ * boundary falls on.
+ */
+static bool
+lox_lexer_parallel_stitch
+(
+  lox_parallel_job_t *_job
+)
+{
+  lox_lexer_t *repair_lexer = _job->repair_lexer;
+  repair_lexer->source = _job->source;
+
+  long position = 0;
+  long chunk_index = 0;
+  while (position < _job->source_length)
+  {
+    lox_lexer_chunk_t *chunk = &_job->chunks[chunk_index];
+    if (chunk_index < _job->chunk_count && chunk->start == position && chunk->lexer != NULL)
+    {
+      if (!lox_lexer_parallel_map_ids(_job, chunk))
+      {
+        return false;
+      }
+      lox_lexer_parallel_push_segment(_job, chunk->lexer, 0, chunk->id_map);
+
+      position = chunk->stop;
+      ++chunk_index;
+
+      continue;
+    }
+
+    long window_index = chunk_index;
+    while (window_index < _job->chunk_count && _job->chunks[window_index].start <= position)
+    {
+      ++window_index;
+    }
+
+    const long first_token = repair_lexer->token_count;
+    while (true)
+    {
+      repair_lexer->has_more_input = window_index < _job->chunk_count;
+      repair_lexer->source_length = repair_lexer->has_more_input
+                                    ? _job->chunks[window_index].start
+                                    : _job->source_length;
+      if (position >= repair_lexer->source_length)
+      {
+        break;
+      }
+
+      const long consumed = lox_lexer_scan_token(repair_lexer, position);
+      if (consumed == LOX_LEXER_INCOMPLETE)
+      {
+        // The token crosses this chunk too, so it's skipped as well
+        ++window_index;
+
+        continue;
+      }
+
+      position += consumed;
+      LOX_STATS_ONLY(repair_lexer->stats.scanned_bytes += consumed;)
+    }
+
+    lox_lexer_parallel_push_segment(_job, repair_lexer, first_token, NULL);
+    chunk_index = window_index;
+  }
+
+  return true;
+}
+
+static void
+lox_lexer_parallel_copy_segment
+(
+  void *_job,
+  long  _segment_index
+)
+{
+  lox_parallel_job_t *job = _job;
+  const lox_token_segment_t *segment = &job->segments[_segment_index];
+
+  const lox_token_t *source_tokens = segment->lexer->tokens + segment->first_token;
+  lox_token_t *result_tokens = job->result->tokens + segment->result_index;
+  for (long i = 0; i < segment->token_count; ++i)
+  {
+    lox_token_t token = source_tokens[i];
+    if (segment->id_map != NULL && token.literal_kind == LOX_LITERAL_INTERNED)
+    {
+      token.literal.id = segment->id_map[token.literal.id];
+    }
+
+    result_tokens[i] = token;
+  }
+}
+
+/*
+ * Moves the segments into one token array framed by BOF and EOF.
+ */
+static bool
+lox_lexer_parallel_gather
+(
+  lox_parallel_job_t *_job,
+  lox_thread_pool_t  *_pool
+)
+{
+  lox_lexer_t *result = _job->result;
+
+  long token_count = 1;
+  for (long i = 0; i < _job->segment_count; ++i)
+  {
+    _job->segments[i].result_index = token_count;
+    token_count += _job->segments[i].token_count;
+  }
+
+  result->tokens = malloc((token_count + 1) * sizeof(lox_token_t));
+  if (result->tokens == NULL)
+  {
+    fprintf(stderr, "failed to allocate %ld tokens\n", token_count + 1);
+
+    return false;
+  }
+  result->token_capacity = token_count + 1;
+
+  lox_push_token(result, LOX_BOF, 0, 0);
+  lox_thread_pool_run(_pool, lox_lexer_parallel_copy_segment, _job, _job->segment_count);
+  result->token_count = token_count;
+
+  lox_push_token(result, LOX_EOF, _job->source_length, 0);
+
+  return true;
+}
+
+#ifdef LOX_STATS
+/*
+ * Adds the work the helper lexers did to the result's counters.
+ */
+static void
+lox_lexer_parallel_merge_stats
+(
+  lox_lexer_t       *_result,
+  const lox_lexer_t *_lexer
+)
+{
+  if (_result == NULL)
+  {
+    return;
+  }
+
+  lox_lexer_stats_t *stats = &_result->stats;
+  for (int i = 0; i < LOX_TOKEN_COUNT; ++i)
+  {
+    stats->token_counts[i] += _lexer->stats.token_counts[i];
+  }
+  stats->scanned_bytes += _lexer->stats.scanned_bytes;
+  stats->token_buffer_growth_count += _lexer->stats.token_buffer_growth_count;
+  stats->token_buffer_bytes += _lexer->stats.token_buffer_bytes;
+
+  // The repair lexer shares the result's interner
+  if (_lexer->interner != _result->interner)
+  {
+    lox_interner_stats_t *interner_stats = &_result->interner->stats;
+    interner_stats->lookup_count += _lexer->interner->stats.lookup_count;
+    interner_stats->probe_count += _lexer->interner->stats.probe_count;
+    interner_stats->collision_count += _lexer->interner->stats.collision_count;
+  }
+}
+#endif
+
+/*
+ * Releases everything but the result.
+ */
+static void
+lox_lexer_parallel_clean_job
+(
+  lox_parallel_job_t *_job
+)
+{
+  for (long i = 0; i < _job->chunk_count; ++i)
+  {
+    lox_lexer_chunk_t *chunk = &_job->chunks[i];
+    if (chunk->lexer != NULL)
+    {
+      LOX_STATS_ONLY(lox_lexer_parallel_merge_stats(_job->result, chunk->lexer);)
+      lox_lexer_clean(chunk->lexer);
+    }
+    free(chunk->id_map);
+  }
+
+  if (_job->repair_lexer != NULL)
+  {
+    LOX_STATS_ONLY(lox_lexer_parallel_merge_stats(_job->result, _job->repair_lexer);)
+    lox_lexer_clean(_job->repair_lexer);
+  }
+
+  free(_job->segments);
+  free(_job->chunks);
+}
+
+lox_lexer_t
+*lox_lexer_analyze_source_parallel
+(
+  const char *_source,
+  long        _source_length,
+  int         _thread_count
+)
+{
+  const int thread_count = lox_lexer_parallel_thread_count(_thread_count);
+
+  long chunk_count = (long)thread_count * LOX_LEXER_PARALLEL_CHUNKS_PER_THREAD;
+  if (chunk_count > _source_length / LOX_LEXER_PARALLEL_MIN_CHUNK_SIZE)
+  {
+    chunk_count = _source_length / LOX_LEXER_PARALLEL_MIN_CHUNK_SIZE;
+  }
+
+  // Too long sources are rejected there too
+  if (thread_count < 2 || chunk_count < 2 || _source_length > LOX_LEXER_MAX_SOURCE_LENGTH)
+  {
+    return lox_lexer_analyze_source(_source, _source_length);
+  }
+
+  lox_parallel_job_t job = {
+    .source = _source,
+    .source_length = _source_length
+  };
+
+  // Every chunk, and every gap a serial repair fills, is one segment
+  job.chunks = calloc(chunk_count, sizeof(lox_lexer_chunk_t));
+  job.segments = calloc(2 * chunk_count + 1, sizeof(lox_token_segment_t));
+  job.repair_lexer = lox_lexer_create();
+  job.result = lox_lexer_create();
+  lox_thread_pool_t *pool = lox_thread_pool_create(thread_count);
+  if (job.chunks == NULL || job.segments == NULL || job.repair_lexer == NULL ||
+      job.result == NULL || pool == NULL)
+  {
+    fprintf(stderr, "failed to set up parallel lexing\n");
+    lox_lexer_parallel_clean_job(&job);
+    if (job.result != NULL)
+    {
+      lox_lexer_clean(job.result);
+    }
+    if (pool != NULL)
+    {
+      lox_thread_pool_clean(pool);
+    }
+
+    return NULL;
+  }
+
+  // The repair lexer interns straight into the result
+  job.repair_lexer->interner = job.result->interner;
+  job.result->source = _source;
+  job.result->source_length = _source_length;
+
+  LOX_STATS_ONLY(double *phase_seconds = job.result->stats.phase_seconds;)
+  LOX_STATS_ONLY(double phase_start = lox_stats_now();)
+  job.chunk_count = lox_lexer_parallel_split(&job, chunk_count);
+  lox_thread_pool_run(pool, lox_lexer_parallel_scan_chunk, &job, job.chunk_count);
+  LOX_STATS_ONLY(phase_seconds[LOX_LEXER_PHASE_SCAN] += lox_stats_now() - phase_start;)
+
+  LOX_STATS_ONLY(phase_start = lox_stats_now();)
+  const bool is_stitched = lox_lexer_parallel_stitch(&job);
+  LOX_STATS_ONLY(phase_seconds[LOX_LEXER_PHASE_STITCH] += lox_stats_now() - phase_start;)
+
+  LOX_STATS_ONLY(phase_start = lox_stats_now();)
+  bool is_gathered = is_stitched && lox_lexer_parallel_gather(&job, pool);
+  LOX_STATS_ONLY(phase_seconds[LOX_LEXER_PHASE_GATHER] += lox_stats_now() - phase_start;)
+
+  // Chunks stop short of what they can't lex, the repair pass reports it
+  job.result->had_error = job.repair_lexer->had_error;
+
+  lox_thread_pool_clean(pool);
+  lox_lexer_parallel_clean_job(&job);
+  if (!is_gathered)
+  {
+    lox_lexer_clean(job.result);
+
+    return NULL;
+  }
+
+  return job.result;
+}
@@ -0,0 +1,34 @@
+/*
+ * Implements lexing of large sources across threads.
+ *
+ * The source is cut right after newlines, and every chunk is lexed on
+ * its own as if no string literal crossed its start. That guess is
+ * checked in source order afterwards: wherever a chunk turns out to
+ * end inside a token, the text from there to the next chunk the lexer
+ * agrees with is lexed again serially. The result is the same as
+ * lox_lexer_analyze_source's, token for token and id for id.
+ */
+
+#ifndef LOX_LEXER_PARALLEL_H
+#define LOX_LEXER_PARALLEL_H
+
+#include "base.h"
+#include "lexer.h"
+
+#define LOX_LEXER_PARALLEL_CHUNKS_PER_THREAD 4
+#define LOX_LEXER_PARALLEL_MIN_CHUNK_SIZE    (256 * 1024)
+
+/*
+ * Same as lox_lexer_analyze_source on _thread_count threads, or on
+ * every online core when _thread_count is 0. Sources too small to be
+ * worth splitting are lexed on the calling thread.
+ */
+lox_lexer_t
+*lox_lexer_analyze_source_parallel
+(
+  const char *_source,
+  long        _source_length,
+  int         _thread_count
+);
+
+#endif // LOX_LEXER_PARALLEL_H
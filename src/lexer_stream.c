@@ -0,0 +1,271 @@
+#include "lexer_stream.h"
+
+/*
+ * Moves the lexer's line and column past the first _length bytes of
+ * the window, which are about to be discarded.
+ */
+static void
+lox_lexer_stream_advance_location
+(
+  lox_lexer_stream_t *_stream,
+  long                _length
+)
+{
+  lox_lexer_t *lexer = _stream->lexer;
+  const char *consumed_end = _stream->window + _length;
+  const char *line_start = _stream->window;
+  const char *line_end = lexer->kernels->find_line_end(line_start, consumed_end);
+  while (line_end < consumed_end)
+  {
+    ++lexer->source_line;
+    lexer->source_column = 0;
+    line_start = line_end + 1;
+    line_end = lexer->kernels->find_line_end(line_start, consumed_end);
+  }
+
+  lexer->source_column += consumed_end - line_start;
+}
+
+/*
+ * Moves the unconsumed tail of the window to its start and reads more
+ * input behind it. Returns false if nothing could be read.
+ */
+static bool
+lox_lexer_stream_refill
+(
+  lox_lexer_stream_t *_stream
+)
+{
+  const long unconsumed = _stream->window_length - _stream->position;
+  if (_stream->position > 0)
+  {
+    lox_lexer_stream_advance_location(_stream, _stream->position);
+    memmove(_stream->window, _stream->window + _stream->position, unconsumed);
+    _stream->window_offset += _stream->position;
+    _stream->window_length = unconsumed;
+    _stream->position = 0;
+  }
+
+  bool has_read = false;
+  while (!_stream->is_input_exhausted && _stream->window_length < _stream->window_capacity)
+  {
+    long read_count = _stream->read(_stream->read_context,
+                                    _stream->window + _stream->window_length,
+                                    _stream->window_capacity - _stream->window_length);
+    if (read_count < 0)
+    {
+      fprintf(stderr, "failed to read lexer input\n");
+      _stream->is_input_exhausted = true;
+
+      break;
+    }
+
+    if (read_count == 0)
+    {
+      _stream->is_input_exhausted = true;
+
+      break;
+    }
+
+    _stream->window_length += read_count;
+    has_read = true;
+  }
+
+  _stream->lexer->source = _stream->window;
+  _stream->lexer->source_length = _stream->window_length;
+  _stream->lexer->has_more_input = !_stream->is_input_exhausted;
+  lox_line_index_invalidate(&_stream->lexer->line_index);
+
+  return has_read;
+}
+
+static void
+lox_lexer_stream_emit
+(
+  lox_lexer_stream_t *_stream,
+  lox_token_t        *_token,
+  lox_token_e         _type
+)
+{
+  _token->type = _type;
+  _token->offset = (uint32_t)_stream->position;
+  _token->length = 0;
+  _token->literal_kind = LOX_LITERAL_NONE;
+  _token->literal.number = 0.0;
+}
+
+lox_lexer_stream_t
+*lox_lexer_stream_create
+(
+  lox_lexer_read_fn  _read,
+  void              *_read_context,
+  long               _window_capacity
+)
+{
+  // Tokens are offsets into the window, so only the window is limited
+  if (_window_capacity > LOX_LEXER_MAX_SOURCE_LENGTH)
+  {
+    fprintf(stderr, "stream window of %ld bytes is larger than %ld bytes\n",
+            _window_capacity, LOX_LEXER_MAX_SOURCE_LENGTH);
+
+    return NULL;
+  }
+
+  lox_lexer_stream_t *new_stream = malloc(sizeof(lox_lexer_stream_t));
+  if (new_stream == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for new lexer stream\n");
+
+    return NULL;
+  }
+  new_stream->window_capacity = (_window_capacity > 0)
+                                ? _window_capacity
+                                : LOX_LEXER_STREAM_WINDOW_SIZE;
+  new_stream->window_length = 0;
+  new_stream->window_offset = 0;
+  new_stream->position = 0;
+  new_stream->read = _read;
+  new_stream->read_context = _read_context;
+  new_stream->is_input_exhausted = false;
+  new_stream->has_emitted_bof = false;
+  new_stream->has_emitted_eof = false;
+
+  new_stream->window = malloc(new_stream->window_capacity);
+  new_stream->lexer = lox_lexer_create();
+  if (new_stream->window == NULL || new_stream->lexer == NULL)
+  {
+    fprintf(stderr, "failed to allocate lexer stream window\n");
+    lox_lexer_stream_clean(new_stream);
+
+    return NULL;
+  }
+
+  // Interning every name would make memory grow with the input
+  new_stream->lexer->interner = NULL;
+  new_stream->lexer->has_more_input = true;
+
+  return new_stream;
+}
+
+long
+lox_lexer_stream_read_file
+(
+  void *_file,
+  char *_buffer,
+  long  _capacity
+)
+{
+  size_t read_count = fread(_buffer, sizeof(char), _capacity, (FILE *)_file);
+  if (read_count == 0 && ferror((FILE *)_file))
+  {
+    return -1;
+  }
+
+  return (long)read_count;
+}
+
+bool
+lox_lexer_next_token
+(
+  lox_lexer_stream_t *_stream,
+  lox_token_t        *_token
+)
+{
+  if (_stream->has_emitted_eof)
+  {
+    return false;
+  }
+
+  if (!_stream->has_emitted_bof)
+  {
+    lox_lexer_stream_emit(_stream, _token, LOX_BOF);
+    _stream->has_emitted_bof = true;
+
+    return true;
+  }
+
+  // Whatever the previous token pointed at isn't needed anymore
+  lox_lexer_t *lexer = _stream->lexer;
+  lexer->token_count = 0;
+  lox_arena_reset(lexer->arena);
+
+  while (lexer->token_count == 0)
+  {
+    if (_stream->position == _stream->window_length)
+    {
+      if (_stream->is_input_exhausted || !lox_lexer_stream_refill(_stream))
+      {
+        lox_lexer_stream_emit(_stream, _token, LOX_EOF);
+        _stream->has_emitted_eof = true;
+
+        return true;
+      }
+
+      continue;
+    }
+
+    long consumed = lox_lexer_scan_token(lexer, _stream->position);
+    if (consumed == LOX_LEXER_INCOMPLETE)
+    {
+      if (_stream->position == 0 && _stream->window_length == _stream->window_capacity)
+      {
+        fprintf(stderr, "token at offset %lld doesn't fit in a %ld byte window\n",
+                (long long)_stream->window_offset, _stream->window_capacity);
+
+        return false;
+      }
+
+      // Nothing new to read just drops has_more_input, so the retry completes
+      lox_lexer_stream_refill(_stream);
+
+      continue;
+    }
+
+    _stream->position += consumed;
+    LOX_STATS_ONLY(lexer->stats.scanned_bytes += consumed;)
+  }
+
+  *_token = lexer->tokens[0];
+
+  return true;
+}
+
+int64_t
+lox_lexer_stream_offset
+(
+  const lox_lexer_stream_t *_stream,
+  const lox_token_t        *_token
+)
+{
+  return _stream->window_offset + _token->offset;
+}
+
+lox_string_view_t
+lox_lexer_stream_lexeme
+(
+  const lox_lexer_stream_t *_stream,
+  const lox_token_t        *_token
+)
+{
+  lox_string_view_t view = {
+    .data = _stream->window + _token->offset,
+    .length = _token->length
+  };
+
+  return view;
+}
+
+void
+lox_lexer_stream_clean
+(
+  lox_lexer_stream_t *_stream
+)
+{
+  if (_stream->lexer != NULL)
+  {
+    lox_lexer_clean(_stream->lexer);
+  }
+
+  free(_stream->window);
+  free(_stream);
+}
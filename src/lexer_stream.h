@@ -0,0 +1,101 @@
+/*
+ * Implements a pull-based lexer over a refillable fixed-size window,
+ * for inputs that shouldn't be resident all at once.
+ */
+
+#ifndef LOX_LEXER_STREAM_H
+#define LOX_LEXER_STREAM_H
+
+#include "base.h"
+#include "lexer.h"
+
+#define LOX_LEXER_STREAM_WINDOW_SIZE (64 * 1024)
+
+/*
+ * Fills at most _capacity bytes of _buffer and returns how many were
+ * written, 0 at the end of the input or a negative value on failure.
+ */
+typedef long (*lox_lexer_read_fn)(void *_context, char *_buffer, long _capacity);
+
+/*
+ * Tokens handed out by lox_lexer_next_token have offsets into the
+ * current window, and are only valid until the next call, after which
+ * the window may have moved. lox_lexer_stream_offset turns them into
+ * 64-bit offsets into the whole input, which isn't limited to
+ * LOX_LEXER_MAX_SOURCE_LENGTH. Stream tokens aren't interned, which
+ * keeps memory bounded by the window size.
+ */
+typedef struct lox_lexer_stream_t
+{
+  lox_lexer_t       *lexer;
+
+  char              *window;
+  long               window_capacity;
+  long               window_length;
+  // Offset of the window's first byte in the whole input
+  int64_t            window_offset;
+  long               position;
+
+  lox_lexer_read_fn  read;
+  void              *read_context;
+  bool               is_input_exhausted;
+  bool               has_emitted_bof;
+  bool               has_emitted_eof;
+} lox_lexer_stream_t;
+
+lox_lexer_stream_t
+*lox_lexer_stream_create
+(
+  lox_lexer_read_fn  _read,
+  void              *_read_context,
+  long               _window_capacity
+);
+
+/*
+ * lox_lexer_read_fn over a FILE *, passed as the read context.
+ */
+long
+lox_lexer_stream_read_file
+(
+  void *_file,
+  char *_buffer,
+  long  _capacity
+);
+
+/*
+ * Writes the next token to _token. Returns false once LOX_EOF was
+ * already returned, or when the input can't be lexed any further,
+ * e.g. a single token longer than the window.
+ */
+bool
+lox_lexer_next_token
+(
+  lox_lexer_stream_t *_stream,
+  lox_token_t        *_token
+);
+
+/*
+ * Offset of _token, as returned by the last lox_lexer_next_token, from
+ * the start of the input.
+ */
+int64_t
+lox_lexer_stream_offset
+(
+  const lox_lexer_stream_t *_stream,
+  const lox_token_t        *_token
+);
+
+lox_string_view_t
+lox_lexer_stream_lexeme
+(
+  const lox_lexer_stream_t *_stream,
+  const lox_token_t        *_token
+);
+
+void
+lox_lexer_stream_clean
+(
+  lox_lexer_stream_t *_stream
+);
+
+#endif // LOX_LEXER_STREAM_H
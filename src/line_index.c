@@ -0,0 +1,142 @@
+#include "line_index.h"
+
+void
+lox_line_index_init
+(
+  lox_line_index_t *_index
+)
+{
+  _index->line_starts = NULL;
+  _index->line_count = 0;
+  _index->line_capacity = 0;
+  _index->source = NULL;
+  _index->source_length = 0;
+}
+
+static bool
+lox_line_index_push
+(
+  lox_line_index_t *_index,
+  long              _line_start
+)
+{
+  if (_index->line_count == _index->line_capacity)
+  {
+    long new_capacity = (_index->line_capacity > 0)
+                        ? _index->line_capacity * 2
+                        : LOX_LINE_INDEX_INITIAL_CAPACITY;
+    uint32_t *new_line_starts = realloc(_index->line_starts,
+                                        new_capacity * sizeof(uint32_t));
+    if (new_line_starts == NULL)
+    {
+      fprintf(stderr, "failed to grow line index to %ld lines\n", new_capacity);
+
+      return false;
+    }
+
+    _index->line_starts = new_line_starts;
+    _index->line_capacity = new_capacity;
+  }
+
+  _index->line_starts[_index->line_count++] = (uint32_t)_line_start;
+
+  return true;
+}
+
+bool
+lox_line_index_build
+(
+  lox_line_index_t         *_index,
+  const char               *_source,
+  long                      _source_length,
+  const lox_simd_kernels_t *_kernels
+)
+{
+  lox_line_index_invalidate(_index);
+  _index->line_count = 0;
+
+  if (!lox_line_index_push(_index, 0))
+  {
+    return false;
+  }
+
+  const char *source_end = _source + _source_length;
+  const char *line_end = _kernels->find_line_end(_source, source_end);
+  while (line_end < source_end)
+  {
+    if (!lox_line_index_push(_index, line_end + 1 - _source))
+    {
+      return false;
+    }
+    line_end = _kernels->find_line_end(line_end + 1, source_end);
+  }
+
+  _index->source = _source;
+  _index->source_length = _source_length;
+
+  return true;
+}
+
+bool
+lox_line_index_is_built_for
+(
+  const lox_line_index_t *_index,
+  const char             *_source,
+  long                    _source_length
+)
+{
+  return _index->source != NULL &&
+         _index->source == _source &&
+         _index->source_length == _source_length;
+}
+
+void
+lox_line_index_invalidate
+(
+  lox_line_index_t *_index
+)
+{
+  _index->source = NULL;
+  _index->source_length = 0;
+}
+
+lox_location_t
+lox_line_index_locate
+(
+  const lox_line_index_t *_index,
+  long                    _offset
+)
+{
+  // Last line starting at or before _offset
+  long low = 0;
+  long high = _index->line_count;
+  while (high - low > 1)
+  {
+    const long middle = low + (high - low) / 2;
+    if ((long)_index->line_starts[middle] <= _offset)
+    {
+      low = middle;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  lox_location_t location = {
+    .line = low + 1,
+    .column = _offset - (long)_index->line_starts[low] + 1
+  };
+
+  return location;
+}
+
+void
+lox_line_index_clean
+(
+  lox_line_index_t *_index
+)
+{
+  free(_index->line_starts);
+  lox_line_index_init(_index);
+}
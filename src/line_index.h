@@ -0,0 +1,88 @@
+/*
+ * Maps byte offsets of a source to lines and columns. Tokens only keep
+ * their offset, the index is built with one newline scan the first
+ * time a position is needed and searched from then on.
+ */
+
+#ifndef LOX_LINE_INDEX_H
+#define LOX_LINE_INDEX_H
+
+#include "base.h"
+#include "simd.h"
+
+#define LOX_LINE_INDEX_INITIAL_CAPACITY 64
+
+/*
+ * Both start at 1, columns count bytes.
+ */
+typedef struct lox_location_t
+{
+  long line;
+  long column;
+} lox_location_t;
+
+typedef struct lox_line_index_t
+{
+  // Offset of the first character of every line, line_starts[0] is 0
+  uint32_t   *line_starts;
+  long        line_count;
+  long        line_capacity;
+  // What the index was built from, NULL while it isn't built
+  const char *source;
+  long        source_length;
+} lox_line_index_t;
+
+void
+lox_line_index_init
+(
+  lox_line_index_t *_index
+);
+
+bool
+lox_line_index_build
+(
+  lox_line_index_t         *_index,
+  const char               *_source,
+  long                      _source_length,
+  const lox_simd_kernels_t *_kernels
+);
+
+/*
+ * Whether the index was built from exactly this source.
+ */
+bool
+lox_line_index_is_built_for
+(
+  const lox_line_index_t *_index,
+  const char             *_source,
+  long                    _source_length
+);
+
+/*
+ * Forgets what the index was built from, keeping its memory for the
+ * next build. Needed when the source changes in place.
+ */
+void
+lox_line_index_invalidate
+(
+  lox_line_index_t *_index
+);
+
+/*
+ * Binary searches the line _offset is on. An offset past the end lands
+ * on the last line.
+ */
+lox_location_t
+lox_line_index_locate
+(
+  const lox_line_index_t *_index,
+  long                    _offset
+);
+
+void
+lox_line_index_clean
+(
+  lox_line_index_t *_index
+);
+
+#endif // LOX_LINE_INDEX_H
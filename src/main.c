@@ -1,12 +1,76 @@
 #include "base.h"
+#include "compiler.h"
 #include "lexer.h"
+#include "lexer_parallel.h"
+#include "lexer_stream.h"
+#include "parser.h"
+#include "source.h"
+#include "token_cache.h"
+#include "token_pack.h"
+#include "vm.h"
 
-FILE *parse_args(
-  char *_file_name
+typedef struct lox_options_t
+{
+  const char *path;
+  bool        is_streaming;
+  // 1 lexes on the main thread, 0 on every core
+  int         thread_count;
+  bool        is_caching;
+  // NULL picks lox_token_cache_default_directory
+  const char *cache_directory;
+  bool        is_printing_stats;
+  bool        is_packing;
+  bool        is_printing_ast;
+  bool        is_running;
+  bool        is_disassembling;
+  double      gc_growth_factor;
+} lox_options_t;
+
+// What the token cache did for this run, only reported by --stats
+typedef enum lox_cache_outcome_e
+{
+  LOX_CACHE_OUTCOME_OFF,
+  LOX_CACHE_OUTCOME_HIT,
+  LOX_CACHE_OUTCOME_STORED,
+  LOX_CACHE_OUTCOME_NOT_STORED
+} lox_cache_outcome_e;
+
+typedef enum lox_driver_phase_e
+{
+  LOX_DRIVER_PHASE_LOAD,
+  LOX_DRIVER_PHASE_LEX,
+  LOX_DRIVER_PHASE_OUTPUT,
+
+  LOX_DRIVER_PHASE_COUNT
+} lox_driver_phase_e;
+
+lox_options_t parse_args(
+  int    _argc,
+  char **_argv
+);
+
+int lex_streaming(
+  const char *_path
+);
+
+lox_lexer_t *lex_source(
+  const lox_options_t *_options,
+  const lox_source_t  *_source,
+  lox_cache_outcome_e *_cache_outcome
+);
+
+int run_program(
+  const lox_options_t *_options,
+  lox_lexer_t         *_lexer,
+  lox_gc_stats_t      *_gc_stats
 );
 
-char *read_file_content(
-  FILE *_file
+void print_stats(
+  lox_lexer_t               *_lexer,
+  const lox_packed_tokens_t *_packed,
+  const double              *_phase_seconds,
+  lox_cache_outcome_e        _cache_outcome,
+  const lox_gc_stats_t      *_gc_stats
 );
 
 int main(
@@ -14,67 +78,416 @@ int main(
   char **_argv
 )
 {
-  FILE *file = parse_args(_argv[1]);
-  if (file == NULL)
+  lox_options_t options = parse_args(_argc, _argv);
+  if (options.is_streaming)
   {
-    return EXIT_FAILURE;
+    return lex_streaming(options.path);
   }
 
-  char *source = read_file_content(file);
-  if (source == NULL)
+  double phase_seconds[LOX_DRIVER_PHASE_COUNT] = { 0 };
+  double phase_start = lox_stats_now();
+
+  lox_source_t source;
+  if (!lox_source_open(&source, options.path))
   {
     return EXIT_FAILURE;
   }
+  phase_seconds[LOX_DRIVER_PHASE_LOAD] = lox_stats_now() - phase_start;
 
-  lox_lexer_t *lexer = lox_lexer_analyze_source(source);
+  phase_start = lox_stats_now();
+  lox_cache_outcome_e cache_outcome = LOX_CACHE_OUTCOME_OFF;
+  lox_lexer_t *lexer = lex_source(&options, &source, &cache_outcome);
   if (lexer == NULL)
   {
+    lox_source_close(&source);
+
     return EXIT_FAILURE;
   }
 
-  lox_debug_identifier_table(lexer->identifier_table);
-  lox_lexer_debug_tokens(lexer);
+  // The wide tokens go away once packed, only the packed ones are kept.
+  // The parser and the compiler read the wide ones, so --ast, --run and
+  // --disassemble don't pack
+  const bool is_compiling = options.is_printing_ast || options.is_running ||
+                            options.is_disassembling;
+  lox_packed_tokens_t *packed = NULL;
+  if (options.is_packing && !is_compiling)
+  {
+    packed = lox_packed_tokens_create(lexer);
+    if (packed == NULL)
+    {
+      lox_lexer_clean(lexer);
+      lox_source_close(&source);
+
+      return EXIT_FAILURE;
+    }
+  }
+  phase_seconds[LOX_DRIVER_PHASE_LEX] = lox_stats_now() - phase_start;
 
+  int exit_status = EXIT_SUCCESS;
+  lox_gc_stats_t gc_stats;
+  const lox_gc_stats_t *ran_gc_stats = NULL;
+  phase_start = lox_stats_now();
+  if (options.is_running || options.is_disassembling)
+  {
+    exit_status = run_program(&options, lexer, &gc_stats);
+    ran_gc_stats = &gc_stats;
+  }
+  else if (options.is_printing_ast)
+  {
+    lox_ast_t *ast = lox_parse(lexer);
+    if (ast == NULL)
+    {
+      lox_lexer_clean(lexer);
+      lox_source_close(&source);
+
+      return EXIT_FAILURE;
+    }
+    lox_ast_debug(lexer, ast);
+    // The tree is printed anyway, the errors were reported as found
+    if (ast->error_count > 0)
+    {
+      exit_status = EXIT_FAILURE;
+    }
+    lox_ast_clean(ast);
+  }
+  else if (packed != NULL)
+  {
+    lox_debug_interner(lexer->interner);
+    lox_packed_tokens_debug(lexer, packed);
+  }
+  else
+  {
+    lox_debug_interner(lexer->interner);
+    lox_lexer_debug_tokens(lexer);
+  }
+  phase_seconds[LOX_DRIVER_PHASE_OUTPUT] = lox_stats_now() - phase_start;
+  // The tokens are still printed after a lexer error, but the run fails
+  if (lexer->had_error)
+  {
+    exit_status = EXIT_FAILURE;
+  }
+
+  if (options.is_printing_stats)
+  {
+    print_stats(lexer, packed, phase_seconds, cache_outcome, ran_gc_stats);
+  }
+
+  if (packed != NULL)
+  {
+    lox_packed_tokens_clean(packed);
+  }
   lox_lexer_clean(lexer);
+  lox_source_close(&source);
 
-  return EXIT_SUCCESS;
+  return exit_status;
 }
 
-FILE *parse_args(
-  char *_file_name
+/*
+ * usage: lox [--stream] [--threads <n>] [--no-cache] [--cache-dir <dir>]
+ *            [--packed] [--ast] [--run] [--disassemble]
+ *            [--gc-growth <factor>] [--stats] [path]
+ * Without a path, or with "-", the program is read from stdin.
+ * Tokens of a program read from a file are cached in --cache-dir, by
+ * default $XDG_CACHE_HOME/lox or ~/.cache/lox, see token_cache.h,
+ * unless --no-cache is given. --stats prints counters
+ * as JSON on stderr once done, it doesn't apply to --stream. --packed
+ * keeps the tokens in the compact encoding of token_pack.h. --ast parses
+ * the program and prints its syntax tree instead of the tokens. --run
+ * compiles the program to bytecode and runs it, --disassemble prints
+ * the bytecode instead. --gc-growth sets how many times what survived
+ * a garbage collection the old generation grows to before the next,
+ * see gc.h.
+ */
+lox_options_t parse_args(
+  int    _argc,
+  char **_argv
 )
 {
-  FILE *input_file = fopen(_file_name, "r");
-  if (input_file == NULL)
+  lox_options_t options = {
+    .path = NULL,
+    .is_streaming = false,
+    .thread_count = 1,
+    .is_caching = true,
+    .cache_directory = NULL,
+    .is_printing_stats = false,
+    .is_packing = false,
+    .is_printing_ast = false,
+    .is_running = false,
+    .is_disassembling = false,
+    .gc_growth_factor = LOX_GC_GROWTH_FACTOR
+  };
+
+  for (int i = 1; i < _argc; ++i)
   {
-    fprintf(stderr, "failed to open source file\n");
+    if (strcmp(_argv[i], "--stream") == 0)
+    {
+      options.is_streaming = true;
+    }
+    else if (strcmp(_argv[i], "--stats") == 0)
+    {
+      options.is_printing_stats = true;
+    }
+    else if (strcmp(_argv[i], "--no-cache") == 0)
+    {
+      options.is_caching = false;
+    }
+    else if (strcmp(_argv[i], "--packed") == 0)
+    {
+      options.is_packing = true;
+    }
+    else if (strcmp(_argv[i], "--ast") == 0)
+    {
+      options.is_printing_ast = true;
+    }
+    else if (strcmp(_argv[i], "--run") == 0)
+    {
+      options.is_running = true;
+    }
+    else if (strcmp(_argv[i], "--disassemble") == 0)
+    {
+      options.is_disassembling = true;
+    }
+    else if (strcmp(_argv[i], "--cache-dir") == 0 && i + 1 < _argc)
+    {
+      options.cache_directory = _argv[++i];
+    }
+    else if (strcmp(_argv[i], "--threads") == 0 && i + 1 < _argc)
+    {
+      options.thread_count = (int)strtol(_argv[++i], NULL, 10);
+    }
+    else if (strcmp(_argv[i], "--gc-growth") == 0 && i + 1 < _argc)
+    {
+      options.gc_growth_factor = strtod(_argv[++i], NULL);
+    }
+    else
+    {
+      options.path = _argv[i];
+    }
+  }
 
-    return NULL;
+  return options;
+}
+
+/*
+ * Lexes the program, or loads its tokens from the cache when they were
+ * stored for the exact same text, refreshing the cache otherwise. The
+ * cache stays out of the way: when it can't be used the program is
+ * just lexed, and _cache_outcome tells --stats what happened.
+ */
+lox_lexer_t *lex_source(
+  const lox_options_t *_options,
+  const lox_source_t  *_source,
+  lox_cache_outcome_e *_cache_outcome
+)
+{
+  *_cache_outcome = LOX_CACHE_OUTCOME_OFF;
+  char *cache_path = NULL;
+  uint64_t source_hash = 0;
+  if (_options->is_caching && _options->path != NULL && strcmp(_options->path, "-") != 0)
+  {
+    char *default_directory = (_options->cache_directory == NULL)
+                              ? lox_token_cache_default_directory() : NULL;
+    const char *cache_directory = (_options->cache_directory != NULL)
+                                  ? _options->cache_directory : default_directory;
+    if (cache_directory != NULL)
+    {
+      cache_path = lox_token_cache_path(cache_directory, _options->path);
+    }
+    free(default_directory);
   }
 
-  return input_file;
+  if (cache_path != NULL)
+  {
+    source_hash = lox_token_cache_hash(_source->data, _source->length);
+    lox_lexer_t *cached_lexer = lox_token_cache_load(cache_path, _source->data,
+                                                     _source->length, source_hash);
+    if (cached_lexer != NULL)
+    {
+      *_cache_outcome = LOX_CACHE_OUTCOME_HIT;
+      free(cache_path);
+
+      return cached_lexer;
+    }
+  }
+
+  lox_lexer_t *lexer = (_options->thread_count != 1)
+                       ? lox_lexer_analyze_source_parallel(_source->data, _source->length,
+                                                           _options->thread_count)
+                       : lox_lexer_analyze_source(_source->data, _source->length);
+
+  if (lexer != NULL && cache_path != NULL)
+  {
+    *_cache_outcome = lox_token_cache_store(cache_path, lexer, source_hash)
+                      ? LOX_CACHE_OUTCOME_STORED : LOX_CACHE_OUTCOME_NOT_STORED;
+  }
+  free(cache_path);
+
+  return lexer;
+}
+
+/*
+ * Compiles the program and runs it, or prints its bytecode with
+ * --disassemble. The collector's stats are written to _gc_stats.
+ */
+int run_program(
+  const lox_options_t *_options,
+  lox_lexer_t         *_lexer,
+  lox_gc_stats_t      *_gc_stats
+)
+{
+  if (!(_options->gc_growth_factor > 1.0))
+  {
+    fprintf(stderr, "--gc-growth expects a factor above 1\n");
+
+    return EXIT_FAILURE;
+  }
+
+  lox_vm_t *vm = lox_vm_create();
+  vm->gc.growth_factor = _options->gc_growth_factor;
+  int exit_status = EXIT_SUCCESS;
+  if (_options->is_disassembling)
+  {
+    lox_function_t *function = lox_compile(vm, _lexer);
+    if (function != NULL)
+    {
+      lox_chunk_debug(&function->chunk, "<script>");
+    }
+    else
+    {
+      exit_status = EXIT_FAILURE;
+    }
+  }
+  else if (lox_vm_interpret(vm, _lexer) != LOX_INTERPRET_OK)
+  {
+    exit_status = EXIT_FAILURE;
+  }
+  *_gc_stats = vm->gc.stats;
+  lox_vm_clean(vm);
+
+  return exit_status;
+}
+
+/*
+ * Prints what the run cost as one JSON object on stderr. Counters from
+ * the hot paths are only there when built with LOX_STATS, see stats.h,
+ * those of the garbage collector when the program was run.
+ */
+void print_stats(
+  lox_lexer_t               *_lexer,
+  const lox_packed_tokens_t *_packed,
+  const double              *_phase_seconds,
+  lox_cache_outcome_e        _cache_outcome,
+  const lox_gc_stats_t      *_gc_stats
+)
+{
+  static const char *cache_outcome_names[] = {
+    [LOX_CACHE_OUTCOME_OFF] = "off",
+    [LOX_CACHE_OUTCOME_HIT] = "hit",
+    [LOX_CACHE_OUTCOME_STORED] = "stored",
+    [LOX_CACHE_OUTCOME_NOT_STORED] = "not_stored"
+  };
+
+  const lox_arena_stats_t arena_stats = lox_arena_get_stats(_lexer->arena);
+  const long token_count = (_packed != NULL) ? _packed->token_count : _lexer->token_count;
+  const size_t token_bytes = (_packed != NULL)
+                             ? lox_packed_tokens_size(_packed)
+                             : _lexer->token_count * sizeof(lox_token_t);
+
+  fprintf(stderr, "{\n  \"stats_enabled\": %s,\n", LOX_STATS_ENABLED ? "true" : "false");
+  fprintf(stderr, "  \"source_bytes\": %ld,\n  \"lines\": %ld,\n  \"tokens\": %ld,\n",
+          _lexer->source_length, lox_lexer_locate(_lexer, _lexer->source_length).line,
+          token_count);
+  fprintf(stderr, "  \"token_bytes\": %zu,\n", token_bytes);
+  fprintf(stderr, "  \"interned\": %u,\n", _lexer->interner->entry_count);
+  fprintf(stderr, "  \"token_cache\": \"%s\",\n", cache_outcome_names[_cache_outcome]);
+  fprintf(stderr, "  \"phase_seconds\": {\"load\": %.9f, \"lex\": %.9f, \"output\": %.9f},\n",
+          _phase_seconds[LOX_DRIVER_PHASE_LOAD], _phase_seconds[LOX_DRIVER_PHASE_LEX],
+          _phase_seconds[LOX_DRIVER_PHASE_OUTPUT]);
+  fprintf(stderr, "  \"arena\": {\"allocations\": %zu, \"allocated_bytes\": %zu, "
+          "\"reserved_bytes\": %zu, \"blocks\": %zu}",
+          arena_stats.allocation_count, arena_stats.allocated_bytes,
+          arena_stats.reserved_bytes, arena_stats.block_count);
+  if (_gc_stats != NULL)
+  {
+    fprintf(stderr, ",\n  \"gc\": {\"collections\": %ld, \"minor_collections\": %ld, \"pauses\": %ld, "
+            "\"pause_seconds\": %.9f, \"max_pause_seconds\": %.9f, \"freed_bytes\": %zu, "
+            "\"promoted_bytes\": %zu}",
+            _gc_stats->collection_count, _gc_stats->minor_collection_count, _gc_stats->pause_count,
+            _gc_stats->pause_seconds, _gc_stats->max_pause_seconds, _gc_stats->freed_bytes,
+            _gc_stats->promoted_bytes);
+  }
+
+#ifdef LOX_STATS
+  const lox_lexer_stats_t *stats = &_lexer->stats;
+  const lox_interner_stats_t *interner_stats = &_lexer->interner->stats;
+
+  fprintf(stderr, ",\n  \"scanned_bytes\": %llu,\n",
+          (unsigned long long)stats->scanned_bytes);
+  fprintf(stderr, "  \"token_buffer\": {\"growths\": %llu, \"allocated_bytes\": %llu},\n",
+          (unsigned long long)stats->token_buffer_growth_count,
+          (unsigned long long)stats->token_buffer_bytes);
+  fprintf(stderr, "  \"interner\": {\"lookups\": %llu, \"probes\": %llu, \"collisions\": %llu},\n",
+          (unsigned long long)interner_stats->lookup_count,
+          (unsigned long long)interner_stats->probe_count,
+          (unsigned long long)interner_stats->collision_count);
+  fprintf(stderr, "  \"lexer_phase_seconds\": {\"scan\": %.9f, \"stitch\": %.9f, \"gather\": %.9f},\n",
+          stats->phase_seconds[LOX_LEXER_PHASE_SCAN], stats->phase_seconds[LOX_LEXER_PHASE_STITCH],
+          stats->phase_seconds[LOX_LEXER_PHASE_GATHER]);
+
+  fprintf(stderr, "  \"tokens_by_type\": {");
+  for (int type = 0; type < LOX_TOKEN_COUNT; ++type)
+  {
+    fprintf(stderr, "%s\"%s\": %llu", (type > 0) ? ", " : "", lox_token_name(type),
+            (unsigned long long)stats->token_counts[type]);
+  }
+  fprintf(stderr, "}");
+#endif
+
+  fprintf(stderr, "\n}\n");
 }
 
-char *read_file_content(FILE *_file)
+/*
+ * Prints tokens as they are lexed, without loading the whole program.
+ */
+int lex_streaming(
+  const char *_path
+)
 {
-  long file_size;
-  char *content_buffer;
+  FILE *input_file = stdin;
+  if (_path != NULL && strcmp(_path, "-") != 0)
+  {
+    input_file = fopen(_path, "r");
+    if (input_file == NULL)
+    {
+      fprintf(stderr, "failed to open source file\n");
 
-  fseek(_file, 0L, SEEK_END);
-  file_size = ftell(_file);
-  fseek(_file, 0L, SEEK_SET);
+      return EXIT_FAILURE;
+    }
+  }
 
-  content_buffer = malloc(file_size * sizeof(char));
-  if (content_buffer == NULL)
+  lox_lexer_stream_t *stream = lox_lexer_stream_create(lox_lexer_stream_read_file, input_file,
+                                                       LOX_LEXER_STREAM_WINDOW_SIZE);
+  if (stream == NULL)
   {
-    fprintf(stderr, "failed to allocate memory for file buffer");
-    fclose(_file);
+    return EXIT_FAILURE;
+  }
 
-    return NULL;
+  lox_token_t token;
+  long token_count = 0;
+  while (lox_lexer_next_token(stream, &token))
+  {
+    lox_string_view_t lexeme = lox_lexer_stream_lexeme(stream, &token);
+    printf("tok [%ld]: %.*s\n", token_count, (int)lexeme.length, lexeme.data);
+
+    ++token_count;
   }
 
-  fread(content_buffer, sizeof(char), file_size, _file);
-  fclose(_file);
+  const bool is_lexed = stream->has_emitted_eof && !stream->lexer->had_error;
+  lox_lexer_stream_clean(stream);
+  if (input_file != stdin)
+  {
+    fclose(input_file);
+  }
 
-  return content_buffer;
-}
\ No newline at end of file
+  return is_lexed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,25 @@
+#include "memory.h"
+
+void
+*lox_reallocate
+(
+  void   *_pointer,
+  size_t  _size
+)
+{
+  if (_size == 0)
+  {
+    free(_pointer);
+
+    return NULL;
+  }
+
+  void *new_pointer = realloc(_pointer, _size);
+  if (new_pointer == NULL)
+  {
+    fprintf(stderr, "out of memory, failed to allocate %zu bytes\n", _size);
+    exit(EXIT_FAILURE);
+  }
+
+  return new_pointer;
+}
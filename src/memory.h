@@ -0,0 +1,28 @@
+/*
+ * Implements the allocator behind the runtime: the VM's stacks and
+ * tables, chunks of bytecode and the objects programs create.
+ *
+ * Unlike the lexer, which reports allocation failures to its caller,
+ * the runtime can run out of memory in the middle of any instruction,
+ * so lox_reallocate reports the failure and exits instead.
+ */
+
+#ifndef LOX_MEMORY_H
+#define LOX_MEMORY_H
+
+#include "base.h"
+
+#define LOX_GROW_CAPACITY(_capacity) ((_capacity) < 8 ? 8 : (_capacity) * 2)
+
+/*
+ * Resizes _pointer to _size bytes, or frees it when _size is 0 and
+ * returns NULL.
+ */
+void
+*lox_reallocate
+(
+  void   *_pointer,
+  size_t  _size
+);
+
+#endif // LOX_MEMORY_H
@@ -0,0 +1,358 @@
+#include "object.h"
+#include "gc.h"
+#include "memory.h"
+#include "vm.h"
+
+static lox_object_t
+*lox_object_allocate
+(
+  lox_vm_t     *_vm,
+  size_t        _size,
+  lox_object_e  _type
+)
+{
+  lox_object_t *object = lox_gc_allocate_young(&_vm->gc, _size);
+  if (object != NULL)
+  {
+    object->next = NULL;
+    // Strings are in the table of strings, the others own memory
+    if (_type == LOX_OBJECT_STRING || _type == LOX_OBJECT_FUNCTION || _type == LOX_OBJECT_CLASS ||
+        _type == LOX_OBJECT_INSTANCE)
+    {
+      lox_gc_objects_push(&_vm->gc.young_finalizable, object);
+    }
+  }
+  else
+  {
+    lox_gc_account(_vm, _size);
+
+    object = lox_reallocate(NULL, _size);
+    object->next = _vm->objects;
+    _vm->objects = object;
+    _vm->bytes_allocated += _size;
+  }
+  object->type = _type;
+  object->is_marked = false;
+  object->is_remembered = false;
+  object->is_forwarded = false;
+  // Its creator stores young objects in it without the barrier
+  if (_type != LOX_OBJECT_STRING && !lox_gc_is_young(&_vm->gc, object))
+  {
+    lox_gc_remember(&_vm->gc, object);
+  }
+
+  return object;
+}
+
+size_t
+lox_object_size
+(
+  const lox_object_t *_object
+)
+{
+  switch (_object->type)
+  {
+    case LOX_OBJECT_STRING:
+      return sizeof(lox_string_t) + ((const lox_string_t *)_object)->length + 1;
+    case LOX_OBJECT_FUNCTION:
+      return sizeof(lox_function_t);
+    case LOX_OBJECT_NATIVE:
+      return sizeof(lox_native_t);
+    case LOX_OBJECT_CLOSURE:
+      return sizeof(lox_closure_t) +
+             ((const lox_closure_t *)_object)->upvalue_count * sizeof(lox_upvalue_t *);
+    case LOX_OBJECT_UPVALUE:
+      return sizeof(lox_upvalue_t);
+    case LOX_OBJECT_CLASS:
+      return sizeof(lox_class_t);
+    case LOX_OBJECT_INSTANCE:
+      return sizeof(lox_instance_t);
+    case LOX_OBJECT_BOUND_METHOD:
+      return sizeof(lox_bound_method_t);
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Allocates a string of _length characters, for the caller to fill,
+ * without interning it yet.
+ */
+static lox_string_t
+*lox_string_allocate
+(
+  lox_vm_t *_vm,
+  long      _length
+)
+{
+  lox_string_t *string = (lox_string_t *)lox_object_allocate(_vm, sizeof(lox_string_t) + _length + 1,
+                                                             LOX_OBJECT_STRING);
+  string->length = (uint32_t)_length;
+  string->chars[_length] = '\0';
+
+  return string;
+}
+
+lox_string_t
+*lox_string_copy
+(
+  lox_vm_t   *_vm,
+  const char *_chars,
+  long        _length
+)
+{
+  const uint32_t hash = lox_hash_string(_chars, _length);
+  lox_string_t *interned = lox_table_find_string(&_vm->strings, _chars, _length, hash);
+  if (interned != NULL)
+  {
+    lox_gc_keep_string(&_vm->gc, &interned->object);
+
+    return interned;
+  }
+
+  lox_string_t *string = lox_string_allocate(_vm, _length);
+  memcpy(string->chars, _chars, _length);
+  string->hash = hash;
+  lox_table_set(&_vm->strings, string, lox_value_nil());
+  lox_gc_keep_string(&_vm->gc, &string->object);
+
+  return string;
+}
+
+lox_string_t
+*lox_string_concatenate
+(
+  lox_vm_t           *_vm,
+  const lox_string_t *_a,
+  const lox_string_t *_b
+)
+{
+  const long length = (long)_a->length + _b->length;
+  char *chars = lox_reallocate(NULL, length + 1);
+  memcpy(chars, _a->chars, _a->length);
+  memcpy(chars + _a->length, _b->chars, _b->length);
+
+  lox_string_t *string = lox_string_copy(_vm, chars, length);
+  lox_reallocate(chars, 0);
+
+  return string;
+}
+
+lox_function_t
+*lox_function_create
+(
+  lox_vm_t *_vm
+)
+{
+  lox_function_t *function = (lox_function_t *)lox_object_allocate(_vm, sizeof(lox_function_t),
+                                                                    LOX_OBJECT_FUNCTION);
+  function->arity = 0;
+  function->upvalue_count = 0;
+  function->max_slots = 0;
+  function->name = NULL;
+  lox_chunk_init(&function->chunk);
+
+  return function;
+}
+
+lox_native_t
+*lox_native_create
+(
+  lox_vm_t      *_vm,
+  lox_native_fn  _function,
+  int            _arity,
+  lox_string_t  *_name
+)
+{
+  lox_native_t *native = (lox_native_t *)lox_object_allocate(_vm, sizeof(lox_native_t),
+                                                             LOX_OBJECT_NATIVE);
+  native->function = _function;
+  native->arity = _arity;
+  native->name = _name;
+
+  return native;
+}
+
+lox_closure_t
+*lox_closure_create
+(
+  lox_vm_t       *_vm,
+  lox_function_t *_function
+)
+{
+  const size_t size = sizeof(lox_closure_t) + _function->upvalue_count * sizeof(lox_upvalue_t *);
+  lox_closure_t *closure = (lox_closure_t *)lox_object_allocate(_vm, size, LOX_OBJECT_CLOSURE);
+  closure->function = _function;
+  closure->upvalue_count = _function->upvalue_count;
+  for (int i = 0; i < closure->upvalue_count; ++i)
+  {
+    closure->upvalues[i] = NULL;
+  }
+
+  return closure;
+}
+
+lox_upvalue_t
+*lox_upvalue_create
+(
+  lox_vm_t    *_vm,
+  lox_value_t *_slot
+)
+{
+  lox_upvalue_t *upvalue = (lox_upvalue_t *)lox_object_allocate(_vm, sizeof(lox_upvalue_t),
+                                                                LOX_OBJECT_UPVALUE);
+  upvalue->location = _slot;
+  upvalue->closed = lox_value_nil();
+  upvalue->next_open = NULL;
+
+  return upvalue;
+}
+
+lox_class_t
+*lox_class_create
+(
+  lox_vm_t     *_vm,
+  lox_string_t *_name
+)
+{
+  lox_class_t *class_ = (lox_class_t *)lox_object_allocate(_vm, sizeof(lox_class_t),
+                                                           LOX_OBJECT_CLASS);
+  class_->name = _name;
+  lox_table_init(&class_->methods);
+  class_->initializer = lox_value_nil();
+
+  return class_;
+}
+
+lox_instance_t
+*lox_instance_create
+(
+  lox_vm_t    *_vm,
+  lox_class_t *_class
+)
+{
+  lox_instance_t *instance = (lox_instance_t *)lox_object_allocate(_vm, sizeof(lox_instance_t),
+                                                                   LOX_OBJECT_INSTANCE);
+  instance->class_ = _class;
+  lox_table_init(&instance->fields);
+
+  return instance;
+}
+
+lox_bound_method_t
+*lox_bound_method_create
+(
+  lox_vm_t      *_vm,
+  lox_value_t    _receiver,
+  lox_closure_t *_method
+)
+{
+  lox_bound_method_t *bound_method =
+    (lox_bound_method_t *)lox_object_allocate(_vm, sizeof(lox_bound_method_t),
+                                              LOX_OBJECT_BOUND_METHOD);
+  bound_method->receiver = _receiver;
+  bound_method->method = _method;
+
+  return bound_method;
+}
+
+void
+lox_object_release
+(
+  lox_object_t *_object
+)
+{
+  switch (_object->type)
+  {
+    case LOX_OBJECT_FUNCTION:
+      lox_chunk_clean(&((lox_function_t *)_object)->chunk);
+
+      break;
+    case LOX_OBJECT_CLASS:
+      lox_table_clean(&((lox_class_t *)_object)->methods);
+
+      break;
+    case LOX_OBJECT_INSTANCE:
+      lox_table_clean(&((lox_instance_t *)_object)->fields);
+
+      break;
+    default:
+      break;
+  }
+}
+
+void
+lox_object_free
+(
+  lox_vm_t     *_vm,
+  lox_object_t *_object
+)
+{
+  _vm->bytes_allocated -= lox_object_size(_object);
+  lox_object_release(_object);
+  lox_reallocate(_object, 0);
+}
+
+static void
+lox_function_print
+(
+  FILE                 *_file,
+  const lox_function_t *_function
+)
+{
+  if (_function->name == NULL)
+  {
+    fprintf(_file, "<script>");
+
+    return;
+  }
+  fprintf(_file, "<fn %s>", _function->name->chars);
+}
+
+void
+lox_object_print
+(
+  FILE               *_file,
+  const lox_object_t *_object
+)
+{
+  switch (_object->type)
+  {
+    case LOX_OBJECT_STRING:
+      fprintf(_file, "%s", ((const lox_string_t *)_object)->chars);
+
+      break;
+    case LOX_OBJECT_FUNCTION:
+      lox_function_print(_file, (const lox_function_t *)_object);
+
+      break;
+    case LOX_OBJECT_NATIVE:
+      fprintf(_file, "<native fn %s>", ((const lox_native_t *)_object)->name->chars);
+
+      break;
+    case LOX_OBJECT_CLOSURE:
+      lox_function_print(_file, ((const lox_closure_t *)_object)->function);
+
+      break;
+    case LOX_OBJECT_UPVALUE:
+      fprintf(_file, "upvalue");
+
+      break;
+    case LOX_OBJECT_CLASS:
+      fprintf(_file, "%s", ((const lox_class_t *)_object)->name->chars);
+
+      break;
+    case LOX_OBJECT_INSTANCE:
+      fprintf(_file, "%s instance", ((const lox_instance_t *)_object)->class_->name->chars);
+
+      break;
+    case LOX_OBJECT_BOUND_METHOD:
+      lox_function_print(_file, ((const lox_bound_method_t *)_object)->method->function);
+
+      break;
+    default:
+      fprintf(_file, "<object>");
+
+      break;
+  }
+}
@@ -0,0 +1,254 @@
+/*
+ * Implements the objects programs create on the heap: strings,
+ * functions, closures and the upvalues they capture, classes,
+ * instances and bound methods.
+ *
+ * Every object starts with a lox_object_t header. Objects are
+ * allocated in the nursery of the collector of gc.h when they fit, or
+ * else linked into the VM's list of objects, where the collector finds
+ * them once they are old and the VM frees what is left when it is
+ * cleaned.
+ */
+
+#ifndef LOX_OBJECT_H
+#define LOX_OBJECT_H
+
+#include "base.h"
+#include "chunk.h"
+#include "table.h"
+#include "value.h"
+
+typedef struct lox_vm_t lox_vm_t;
+
+typedef enum lox_object_e
+{
+  LOX_OBJECT_STRING,
+  LOX_OBJECT_FUNCTION,
+  LOX_OBJECT_NATIVE,
+  LOX_OBJECT_CLOSURE,
+  LOX_OBJECT_UPVALUE,
+  LOX_OBJECT_CLASS,
+  LOX_OBJECT_INSTANCE,
+  LOX_OBJECT_BOUND_METHOD,
+
+  LOX_OBJECT_COUNT
+} lox_object_e;
+
+struct lox_object_t
+{
+  // The next old object, or the copy of a forwarded young one
+  lox_object_t *next;
+  uint8_t       type;
+  // Set from the time the collector finds the object until it sweeps it
+  bool          is_marked;
+  // Set while the object is in the collector's remembered objects
+  bool          is_remembered;
+  // Set once a young object has been copied into the old generation
+  bool          is_forwarded;
+  // Where it is in the remembered objects, while is_remembered
+  uint32_t      remembered_index;
+};
+
+/*
+ * Strings are interned, see lox_string_copy, and keep their text
+ * NUL-terminated in the same allocation.
+ */
+struct lox_string_t
+{
+  lox_object_t object;
+  uint32_t     length;
+  uint32_t     hash;
+  char         chars[];
+};
+
+typedef struct lox_function_t
+{
+  lox_object_t  object;
+  int           arity;
+  int           upvalue_count;
+  // Most stack slots the function uses, its locals included
+  int           max_slots;
+  lox_chunk_t   chunk;
+  // NULL for the top level of a program
+  lox_string_t *name;
+} lox_function_t;
+
+typedef lox_value_t (*lox_native_fn)(int _argument_count, lox_value_t *_arguments);
+
+typedef struct lox_native_t
+{
+  lox_object_t   object;
+  lox_native_fn  function;
+  int            arity;
+  lox_string_t  *name;
+} lox_native_t;
+
+/*
+ * Points at the variable it captured while that is on the stack, and
+ * at closed once the variable has gone out of scope. Upvalues still
+ * on the stack are linked in next_open, sorted by their slot.
+ */
+typedef struct lox_upvalue_t lox_upvalue_t;
+struct lox_upvalue_t
+{
+  lox_object_t   object;
+  lox_value_t   *location;
+  lox_value_t    closed;
+  lox_upvalue_t *next_open;
+};
+
+typedef struct lox_closure_t
+{
+  lox_object_t    object;
+  lox_function_t *function;
+  int             upvalue_count;
+  lox_upvalue_t  *upvalues[];
+} lox_closure_t;
+
+typedef struct lox_class_t
+{
+  lox_object_t  object;
+  lox_string_t *name;
+  lox_table_t   methods;
+  // The init method, looked up once instead of on every construction
+  lox_value_t   initializer;
+} lox_class_t;
+
+typedef struct lox_instance_t
+{
+  lox_object_t  object;
+  lox_class_t  *class_;
+  lox_table_t   fields;
+} lox_instance_t;
+
+typedef struct lox_bound_method_t
+{
+  lox_object_t   object;
+  lox_value_t    receiver;
+  lox_closure_t *method;
+} lox_bound_method_t;
+
+static inline bool
+lox_value_is_object_type
+(
+  lox_value_t  _value,
+  lox_object_e _type
+)
+{
+  return lox_value_is_object(_value) && lox_value_as_object(_value)->type == _type;
+}
+
+/*
+ * Returns the interned string with the given text, copying it into a
+ * new string if there is none yet.
+ */
+lox_string_t
+*lox_string_copy
+(
+  lox_vm_t   *_vm,
+  const char *_chars,
+  long        _length
+);
+
+/*
+ * Returns the interned string that is _a followed by _b.
+ */
+lox_string_t
+*lox_string_concatenate
+(
+  lox_vm_t           *_vm,
+  const lox_string_t *_a,
+  const lox_string_t *_b
+);
+
+lox_function_t
+*lox_function_create
+(
+  lox_vm_t *_vm
+);
+
+lox_native_t
+*lox_native_create
+(
+  lox_vm_t      *_vm,
+  lox_native_fn  _function,
+  int            _arity,
+  lox_string_t  *_name
+);
+
+/*
+ * Creates a closure of _function with room for its upvalues, all
+ * NULL until the VM captures them.
+ */
+lox_closure_t
+*lox_closure_create
+(
+  lox_vm_t       *_vm,
+  lox_function_t *_function
+);
+
+lox_upvalue_t
+*lox_upvalue_create
+(
+  lox_vm_t    *_vm,
+  lox_value_t *_slot
+);
+
+lox_class_t
+*lox_class_create
+(
+  lox_vm_t     *_vm,
+  lox_string_t *_name
+);
+
+lox_instance_t
+*lox_instance_create
+(
+  lox_vm_t    *_vm,
+  lox_class_t *_class
+);
+
+lox_bound_method_t
+*lox_bound_method_create
+(
+  lox_vm_t      *_vm,
+  lox_value_t    _receiver,
+  lox_closure_t *_method
+);
+
+/*
+ * Bytes _object takes, the ones it owns besides other objects aside.
+ */
+size_t
+lox_object_size
+(
+  const lox_object_t *_object
+);
+
+/*
+ * Frees what _object owns besides other objects, but not _object.
+ */
+void
+lox_object_release
+(
+  lox_object_t *_object
+);
+
+/*
+ * Frees the old _object and whatever it owns besides other objects.
+ */
+void
+lox_object_free
+(
+  lox_vm_t     *_vm,
+  lox_object_t *_object
+);
+
+void
+lox_object_print
+(
+  FILE               *_file,
+  const lox_object_t *_object
+);
+
+#endif // LOX_OBJECT_H
@@ -0,0 +1,1417 @@
+#include "parser.h"
+
+typedef struct lox_parser_t
+{
+  lox_lexer_t       *lexer;
+  const lox_token_t *tokens;
+  // Index of the next token, never past EOF
+  long               current;
+
+  lox_ast_t         *ast;
+  // Items of the lists being parsed, nested lists stack up on top
+  uint32_t          *scratch;
+  long               scratch_count;
+  long               scratch_capacity;
+
+  int                depth;
+  bool               is_panicking;
+  bool               is_out_of_memory;
+} lox_parser_t;
+
+typedef enum lox_precedence_e
+{
+  LOX_PRECEDENCE_NONE,
+  LOX_PRECEDENCE_ASSIGNMENT,  // =
+  LOX_PRECEDENCE_OR,          // or
+  LOX_PRECEDENCE_AND,         // and
+  LOX_PRECEDENCE_EQUALITY,    // == !=
+  LOX_PRECEDENCE_COMPARISON,  // < > <= >=
+  LOX_PRECEDENCE_TERM,        // + -
+  LOX_PRECEDENCE_FACTOR,      // * /
+  LOX_PRECEDENCE_UNARY,       // ! -
+  LOX_PRECEDENCE_CALL,        // . ()
+  LOX_PRECEDENCE_PRIMARY
+} lox_precedence_e;
+
+/*
+ * Prefix rules get the index of the token that starts the expression,
+ * infix rules the index of the operator and the left operand, both
+ * already consumed.
+ */
+typedef lox_node_id_t (*lox_prefix_fn)(lox_parser_t *_parser, long _token, bool _can_assign);
+typedef lox_node_id_t (*lox_infix_fn)(lox_parser_t *_parser, lox_node_id_t _left, long _token,
+                                      bool _can_assign);
+
+typedef struct lox_parse_rule_t
+{
+  lox_prefix_fn    prefix;
+  lox_infix_fn     infix;
+  lox_precedence_e precedence;
+} lox_parse_rule_t;
+
+static const lox_parse_rule_t
+*lox_parser_get_rule
+(
+  lox_token_e _type
+);
+
+static lox_node_id_t
+lox_parser_expression
+(
+  lox_parser_t *_parser
+);
+
+static lox_node_id_t
+lox_parser_statement
+(
+  lox_parser_t *_parser
+);
+
+static lox_node_id_t
+lox_parser_declaration
+(
+  lox_parser_t *_parser
+);
+
+static lox_token_e
+lox_parser_peek
+(
+  const lox_parser_t *_parser
+)
+{
+  return _parser->tokens[_parser->current].type;
+}
+
+static bool
+lox_parser_check
+(
+  const lox_parser_t *_parser,
+  lox_token_e         _type
+)
+{
+  return lox_parser_peek(_parser) == _type;
+}
+
+/*
+ * Consumes the next token and returns its index.
+ */
+static long
+lox_parser_advance
+(
+  lox_parser_t *_parser
+)
+{
+  const long token = _parser->current;
+  if (_parser->tokens[token].type != LOX_EOF)
+  {
+    ++_parser->current;
+  }
+
+  return token;
+}
+
+static bool
+lox_parser_match
+(
+  lox_parser_t *_parser,
+  lox_token_e   _type
+)
+{
+  if (!lox_parser_check(_parser, _type))
+  {
+    return false;
+  }
+  lox_parser_advance(_parser);
+
+  return true;
+}
+
+/*
+ * Reports the first error of a statement, the ones that follow from it
+ * are dropped until the parser has resynchronized.
+ */
+static void
+lox_parser_error_at
+(
+  lox_parser_t *_parser,
+  long          _token,
+  const char   *_message
+)
+{
+  if (_parser->is_panicking)
+  {
+    return;
+  }
+  _parser->is_panicking = true;
+  ++_parser->ast->error_count;
+
+  const lox_token_t *token = &_parser->tokens[_token];
+  if (token->type == LOX_EOF)
+  {
+    lox_lexer_report(_parser->lexer, token->offset, "error at end: %s", _message);
+
+    return;
+  }
+
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_parser->lexer, token);
+  lox_lexer_report(_parser->lexer, token->offset, "error at '%.*s': %s",
+                   (int)lexeme.length, lexeme.data, _message);
+}
+
+/*
+ * Consumes a token of _type and returns its index, or reports _message
+ * and returns the index of the unexpected token without consuming it.
+ */
+static long
+lox_parser_consume
+(
+  lox_parser_t *_parser,
+  lox_token_e   _type,
+  const char   *_message
+)
+{
+  if (lox_parser_check(_parser, _type))
+  {
+    return lox_parser_advance(_parser);
+  }
+
+  lox_parser_error_at(_parser, _parser->current, _message);
+
+  return _parser->current;
+}
+
+/*
+ * Counts one more level of nesting, reporting an error and returning
+ * false when there are too many for the stack. Nothing after that point
+ * can be read in its right context, so it skips to the end of the source
+ * and stays panicking rather than report what the truncation breaks.
+ */
+static bool
+lox_parser_enter
+(
+  lox_parser_t *_parser
+)
+{
+  if (++_parser->depth > LOX_PARSER_MAX_DEPTH)
+  {
+    lox_parser_error_at(_parser, _parser->current, "Code nests too deeply.");
+    _parser->current = _parser->lexer->token_count - 1;
+    --_parser->depth;
+
+    return false;
+  }
+
+  return true;
+}
+
+static lox_node_id_t
+lox_parser_push_node
+(
+  lox_parser_t  *_parser,
+  lox_node_e     _kind,
+  long           _token,
+  lox_node_id_t  _left,
+  lox_node_id_t  _right
+)
+{
+  lox_ast_t *ast = _parser->ast;
+  if (ast->node_count == ast->node_capacity)
+  {
+    const long new_capacity = ast->node_capacity * 2;
+    lox_node_t *new_nodes = (new_capacity <= (long)UINT32_MAX)
+                            ? realloc(ast->nodes, new_capacity * sizeof(lox_node_t))
+                            : NULL;
+    if (new_nodes == NULL)
+    {
+      fprintf(stderr, "failed to grow syntax tree to %ld nodes\n", new_capacity);
+      _parser->is_out_of_memory = true;
+
+      return LOX_NODE_NONE;
+    }
+    ast->nodes = new_nodes;
+    ast->node_capacity = new_capacity;
+  }
+
+  lox_node_t *node = &ast->nodes[ast->node_count];
+  node->kind = _kind;
+  node->token = (uint32_t)_token;
+  node->left = _left;
+  node->right = _right;
+
+  return (lox_node_id_t)ast->node_count++;
+}
+
+static bool
+lox_parser_reserve_extra
+(
+  lox_parser_t *_parser,
+  long          _count
+)
+{
+  lox_ast_t *ast = _parser->ast;
+  if (ast->extra_count + _count <= ast->extra_capacity)
+  {
+    return true;
+  }
+
+  long new_capacity = ast->extra_capacity * 2;
+  while (new_capacity < ast->extra_count + _count)
+  {
+    new_capacity *= 2;
+  }
+
+  uint32_t *new_extra = realloc(ast->extra, new_capacity * sizeof(uint32_t));
+  if (new_extra == NULL)
+  {
+    fprintf(stderr, "failed to grow syntax tree lists to %ld entries\n", new_capacity);
+    _parser->is_out_of_memory = true;
+
+    return false;
+  }
+  ast->extra = new_extra;
+  ast->extra_capacity = new_capacity;
+
+  return true;
+}
+
+/*
+ * Stores _count items in the extra array without a count in front,
+ * for nodes with a fixed number of children.
+ */
+static uint32_t
+lox_parser_push_extra
+(
+  lox_parser_t        *_parser,
+  const lox_node_id_t *_items,
+  long                 _count
+)
+{
+  if (!lox_parser_reserve_extra(_parser, _count))
+  {
+    return 0;
+  }
+
+  lox_ast_t *ast = _parser->ast;
+  const uint32_t index = (uint32_t)ast->extra_count;
+  memcpy(ast->extra + index, _items, _count * sizeof(uint32_t));
+  ast->extra_count += _count;
+
+  return index;
+}
+
+static void
+lox_parser_push_item
+(
+  lox_parser_t *_parser,
+  uint32_t      _item
+)
+{
+  if (_parser->scratch_count == _parser->scratch_capacity)
+  {
+    const long new_capacity = (_parser->scratch_capacity > 0)
+                              ? _parser->scratch_capacity * 2
+                              : LOX_AST_INITIAL_CAPACITY;
+    uint32_t *new_scratch = realloc(_parser->scratch, new_capacity * sizeof(uint32_t));
+    if (new_scratch == NULL)
+    {
+      fprintf(stderr, "failed to grow parser list stack to %ld items\n", new_capacity);
+      _parser->is_out_of_memory = true;
+
+      return;
+    }
+    _parser->scratch = new_scratch;
+    _parser->scratch_capacity = new_capacity;
+  }
+
+  _parser->scratch[_parser->scratch_count++] = _item;
+}
+
+/*
+ * Moves the items pushed since _mark to the extra array behind their
+ * count, and returns where the count went.
+ */
+static uint32_t
+lox_parser_push_list
+(
+  lox_parser_t *_parser,
+  long          _mark
+)
+{
+  const long count = _parser->scratch_count - _mark;
+  _parser->scratch_count = _mark;
+  if (!lox_parser_reserve_extra(_parser, count + 1))
+  {
+    return 0;
+  }
+
+  lox_ast_t *ast = _parser->ast;
+  const uint32_t index = (uint32_t)ast->extra_count;
+  ast->extra[index] = (uint32_t)count;
+  if (count > 0)
+  {
+    memcpy(ast->extra + index + 1, _parser->scratch + _mark, count * sizeof(uint32_t));
+  }
+  ast->extra_count += count + 1;
+
+  return index;
+}
+
+static lox_node_id_t
+lox_parser_parse_precedence
+(
+  lox_parser_t     *_parser,
+  lox_precedence_e  _precedence
+)
+{
+  if (!lox_parser_enter(_parser))
+  {
+    return LOX_NODE_NONE;
+  }
+
+  long token = lox_parser_advance(_parser);
+  lox_prefix_fn prefix = lox_parser_get_rule(_parser->tokens[token].type)->prefix;
+  if (prefix == NULL)
+  {
+    lox_parser_error_at(_parser, token, "Expect expression.");
+    --_parser->depth;
+
+    return LOX_NODE_NONE;
+  }
+
+  const bool can_assign = _precedence <= LOX_PRECEDENCE_ASSIGNMENT;
+  lox_node_id_t node = prefix(_parser, token, can_assign);
+  while (_precedence <= lox_parser_get_rule(lox_parser_peek(_parser))->precedence)
+  {
+    token = lox_parser_advance(_parser);
+    node = lox_parser_get_rule(_parser->tokens[token].type)->infix(_parser, node, token, can_assign);
+  }
+
+  if (can_assign && lox_parser_check(_parser, LOX_EQUAL))
+  {
+    lox_parser_error_at(_parser, lox_parser_advance(_parser), "Invalid assignment target.");
+  }
+  --_parser->depth;
+
+  return node;
+}
+
+static lox_node_id_t
+lox_parser_expression
+(
+  lox_parser_t *_parser
+)
+{
+  return lox_parser_parse_precedence(_parser, LOX_PRECEDENCE_ASSIGNMENT);
+}
+
+static lox_node_id_t
+lox_parser_literal
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  (void)_can_assign;
+
+  return lox_parser_push_node(_parser, LOX_NODE_LITERAL, _token, LOX_NODE_NONE, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_variable
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  if (_can_assign && lox_parser_match(_parser, LOX_EQUAL))
+  {
+    const lox_node_id_t value = lox_parser_expression(_parser);
+
+    return lox_parser_push_node(_parser, LOX_NODE_ASSIGN, _token, value, LOX_NODE_NONE);
+  }
+
+  return lox_parser_push_node(_parser, LOX_NODE_VARIABLE, _token, LOX_NODE_NONE, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_this
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  (void)_can_assign;
+
+  return lox_parser_push_node(_parser, LOX_NODE_THIS, _token, LOX_NODE_NONE, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_super
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  (void)_can_assign;
+  lox_parser_consume(_parser, LOX_DOT, "Expect '.' after 'super'.");
+  lox_parser_consume(_parser, LOX_IDENTIFIER, "Expect superclass method name.");
+
+  return lox_parser_push_node(_parser, LOX_NODE_SUPER, _token, LOX_NODE_NONE, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_grouping
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_node_id_t expression = lox_parser_expression(_parser);
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after expression.");
+
+  return lox_parser_push_node(_parser, LOX_NODE_GROUPING, _token, expression, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_unary
+(
+  lox_parser_t *_parser,
+  long          _token,
+  bool          _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_node_id_t operand = lox_parser_parse_precedence(_parser, LOX_PRECEDENCE_UNARY);
+
+  return lox_parser_push_node(_parser, LOX_NODE_UNARY, _token, operand, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_binary
+(
+  lox_parser_t  *_parser,
+  lox_node_id_t  _left,
+  long           _token,
+  bool           _can_assign
+)
+{
+  (void)_can_assign;
+  const lox_token_e type = _parser->tokens[_token].type;
+  const lox_precedence_e precedence = lox_parser_get_rule(type)->precedence;
+  const lox_node_id_t right = lox_parser_parse_precedence(_parser, precedence + 1);
+  const lox_node_e kind = (type == LOX_AND || type == LOX_OR) ? LOX_NODE_LOGICAL : LOX_NODE_BINARY;
+
+  return lox_parser_push_node(_parser, kind, _token, _left, right);
+}
+
+static lox_node_id_t
+lox_parser_call
+(
+  lox_parser_t  *_parser,
+  lox_node_id_t  _left,
+  long           _token,
+  bool           _can_assign
+)
+{
+  (void)_can_assign;
+  const long mark = _parser->scratch_count;
+  if (!lox_parser_check(_parser, LOX_RIGHT_PAREN))
+  {
+    do
+    {
+      if (_parser->scratch_count - mark == LOX_PARSER_MAX_ARGUMENTS)
+      {
+        lox_parser_error_at(_parser, _parser->current, "Can't have more than 255 arguments.");
+      }
+      lox_parser_push_item(_parser, lox_parser_expression(_parser));
+    } while (lox_parser_match(_parser, LOX_COMMA));
+  }
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after arguments.");
+
+  const uint32_t arguments = lox_parser_push_list(_parser, mark);
+
+  return lox_parser_push_node(_parser, LOX_NODE_CALL, _token, _left, arguments);
+}
+
+static lox_node_id_t
+lox_parser_dot
+(
+  lox_parser_t  *_parser,
+  lox_node_id_t  _left,
+  long           _token,
+  bool           _can_assign
+)
+{
+  (void)_token;
+  const long name = lox_parser_consume(_parser, LOX_IDENTIFIER, "Expect property name after '.'.");
+  if (_can_assign && lox_parser_match(_parser, LOX_EQUAL))
+  {
+    const lox_node_id_t value = lox_parser_expression(_parser);
+
+    return lox_parser_push_node(_parser, LOX_NODE_SET, name, _left, value);
+  }
+
+  return lox_parser_push_node(_parser, LOX_NODE_GET, name, _left, LOX_NODE_NONE);
+}
+
+static const lox_parse_rule_t lox_parse_rules[LOX_TOKEN_COUNT] = {
+  [LOX_LEFT_PAREN]    = { lox_parser_grouping, lox_parser_call,   LOX_PRECEDENCE_CALL },
+  [LOX_DOT]           = { NULL,                lox_parser_dot,    LOX_PRECEDENCE_CALL },
+  [LOX_MINUS]         = { lox_parser_unary,    lox_parser_binary, LOX_PRECEDENCE_TERM },
+  [LOX_PLUS]          = { NULL,                lox_parser_binary, LOX_PRECEDENCE_TERM },
+  [LOX_SLASH]         = { NULL,                lox_parser_binary, LOX_PRECEDENCE_FACTOR },
+  [LOX_STAR]          = { NULL,                lox_parser_binary, LOX_PRECEDENCE_FACTOR },
+  [LOX_BANG]          = { lox_parser_unary,    NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_BANG_EQUAL]    = { NULL,                lox_parser_binary, LOX_PRECEDENCE_EQUALITY },
+  [LOX_EQUAL_EQUAL]   = { NULL,                lox_parser_binary, LOX_PRECEDENCE_EQUALITY },
+  [LOX_GREATER]       = { NULL,                lox_parser_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_GREATER_EQUAL] = { NULL,                lox_parser_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_LESS]          = { NULL,                lox_parser_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_LESS_EQUAL]    = { NULL,                lox_parser_binary, LOX_PRECEDENCE_COMPARISON },
+  [LOX_IDENTIFIER]    = { lox_parser_variable, NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_STRING]        = { lox_parser_literal,  NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_NUMBER]        = { lox_parser_literal,  NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_AND]           = { NULL,                lox_parser_binary, LOX_PRECEDENCE_AND },
+  [LOX_OR]            = { NULL,                lox_parser_binary, LOX_PRECEDENCE_OR },
+  [LOX_FALSE]         = { lox_parser_literal,  NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_TRUE]          = { lox_parser_literal,  NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_NIL]           = { lox_parser_literal,  NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_THIS]          = { lox_parser_this,     NULL,              LOX_PRECEDENCE_NONE },
+  [LOX_SUPER]         = { lox_parser_super,    NULL,              LOX_PRECEDENCE_NONE }
+};
+
+static const lox_parse_rule_t
+*lox_parser_get_rule
+(
+  lox_token_e _type
+)
+{
+  return &lox_parse_rules[_type];
+}
+
+/*
+ * Parses declarations up to the closing '}' and returns their list.
+ */
+static uint32_t
+lox_parser_block_list
+(
+  lox_parser_t *_parser
+)
+{
+  const long mark = _parser->scratch_count;
+  while (!lox_parser_check(_parser, LOX_RIGHT_BRACE) && !lox_parser_check(_parser, LOX_EOF))
+  {
+    lox_parser_push_item(_parser, lox_parser_declaration(_parser));
+  }
+  lox_parser_consume(_parser, LOX_RIGHT_BRACE, "Expect '}' after block.");
+
+  return lox_parser_push_list(_parser, mark);
+}
+
+static lox_node_id_t
+lox_parser_block
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  const uint32_t declarations = lox_parser_block_list(_parser);
+
+  return lox_parser_push_node(_parser, LOX_NODE_BLOCK, _token, LOX_NODE_NONE, declarations);
+}
+
+static lox_node_id_t
+lox_parser_expression_statement
+(
+  lox_parser_t *_parser
+)
+{
+  const long token = _parser->current;
+  const lox_node_id_t expression = lox_parser_expression(_parser);
+
+  return lox_parser_push_node(_parser, LOX_NODE_EXPRESSION, token, expression, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_print_statement
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  const lox_node_id_t value = lox_parser_expression(_parser);
+  lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after value.");
+
+  return lox_parser_push_node(_parser, LOX_NODE_PRINT, _token, value, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_return_statement
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  lox_node_id_t value = LOX_NODE_NONE;
+  if (!lox_parser_check(_parser, LOX_SEMICOLON))
+  {
+    value = lox_parser_expression(_parser);
+  }
+  lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after return value.");
+
+  return lox_parser_push_node(_parser, LOX_NODE_RETURN, _token, value, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_if_statement
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  lox_parser_consume(_parser, LOX_LEFT_PAREN, "Expect '(' after 'if'.");
+  const lox_node_id_t condition = lox_parser_expression(_parser);
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after condition.");
+
+  lox_node_id_t branches[2] = { lox_parser_statement(_parser), LOX_NODE_NONE };
+  if (lox_parser_match(_parser, LOX_ELSE))
+  {
+    branches[1] = lox_parser_statement(_parser);
+  }
+
+  return lox_parser_push_node(_parser, LOX_NODE_IF, _token, condition,
+                              lox_parser_push_extra(_parser, branches, 2));
+}
+
+static lox_node_id_t
+lox_parser_while_statement
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  lox_parser_consume(_parser, LOX_LEFT_PAREN, "Expect '(' after 'while'.");
+  const lox_node_id_t condition = lox_parser_expression(_parser);
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after condition.");
+  const lox_node_id_t body = lox_parser_statement(_parser);
+
+  return lox_parser_push_node(_parser, LOX_NODE_WHILE, _token, condition, body);
+}
+
+/*
+ * var has been consumed already. Leaves the terminator to the caller,
+ * a declaration or a for loop.
+ */
+static lox_node_id_t
+lox_parser_var_declaration
+(
+  lox_parser_t *_parser
+)
+{
+  const long name = lox_parser_consume(_parser, LOX_IDENTIFIER, "Expect variable name.");
+  lox_node_id_t initializer = LOX_NODE_NONE;
+  if (lox_parser_match(_parser, LOX_EQUAL))
+  {
+    initializer = lox_parser_expression(_parser);
+  }
+
+  return lox_parser_push_node(_parser, LOX_NODE_VAR, name, initializer, LOX_NODE_NONE);
+}
+
+static lox_node_id_t
+lox_parser_for_statement
+(
+  lox_parser_t *_parser,
+  long          _token
+)
+{
+  lox_parser_consume(_parser, LOX_LEFT_PAREN, "Expect '(' after 'for'.");
+
+  lox_node_id_t clauses[3] = { LOX_NODE_NONE, LOX_NODE_NONE, LOX_NODE_NONE };
+  if (!lox_parser_match(_parser, LOX_SEMICOLON))
+  {
+    clauses[0] = lox_parser_match(_parser, LOX_VAR)
+                 ? lox_parser_var_declaration(_parser)
+                 : lox_parser_expression_statement(_parser);
+    lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after loop initializer.");
+  }
+
+  if (!lox_parser_check(_parser, LOX_SEMICOLON))
+  {
+    clauses[1] = lox_parser_expression(_parser);
+  }
+  lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after loop condition.");
+
+  if (!lox_parser_check(_parser, LOX_RIGHT_PAREN))
+  {
+    clauses[2] = lox_parser_expression(_parser);
+  }
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after for clauses.");
+
+  const uint32_t clause_index = lox_parser_push_extra(_parser, clauses, 3);
+  const lox_node_id_t body = lox_parser_statement(_parser);
+
+  return lox_parser_push_node(_parser, LOX_NODE_FOR, _token, clause_index, body);
+}
+
+static lox_node_id_t
+lox_parser_statement_at_depth
+(
+  lox_parser_t *_parser
+)
+{
+  const long token = _parser->current;
+  switch (lox_parser_peek(_parser))
+  {
+    case LOX_PRINT:
+      lox_parser_advance(_parser);
+
+      return lox_parser_print_statement(_parser, token);
+    case LOX_RETURN:
+      lox_parser_advance(_parser);
+
+      return lox_parser_return_statement(_parser, token);
+    case LOX_IF:
+      lox_parser_advance(_parser);
+
+      return lox_parser_if_statement(_parser, token);
+    case LOX_WHILE:
+      lox_parser_advance(_parser);
+
+      return lox_parser_while_statement(_parser, token);
+    case LOX_FOR:
+      lox_parser_advance(_parser);
+
+      return lox_parser_for_statement(_parser, token);
+    case LOX_LEFT_BRACE:
+      lox_parser_advance(_parser);
+
+      return lox_parser_block(_parser, token);
+    default:
+    {
+      const lox_node_id_t statement = lox_parser_expression_statement(_parser);
+      lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after expression.");
+
+      return statement;
+    }
+  }
+}
+
+static lox_node_id_t
+lox_parser_statement
+(
+  lox_parser_t *_parser
+)
+{
+  if (!lox_parser_enter(_parser))
+  {
+    return LOX_NODE_NONE;
+  }
+
+  const lox_node_id_t statement = lox_parser_statement_at_depth(_parser);
+  --_parser->depth;
+
+  return statement;
+}
+
+/*
+ * Parses a function or method from its name on, _name_message is the
+ * error for a missing name.
+ */
+static lox_node_id_t
+lox_parser_function
+(
+  lox_parser_t *_parser,
+  const char   *_name_message
+)
+{
+  if (!lox_parser_enter(_parser))
+  {
+    return LOX_NODE_NONE;
+  }
+
+  const long name = lox_parser_consume(_parser, LOX_IDENTIFIER, _name_message);
+  lox_parser_consume(_parser, LOX_LEFT_PAREN, "Expect '(' after function name.");
+  const long mark = _parser->scratch_count;
+  if (!lox_parser_check(_parser, LOX_RIGHT_PAREN))
+  {
+    do
+    {
+      if (_parser->scratch_count - mark == LOX_PARSER_MAX_ARGUMENTS)
+      {
+        lox_parser_error_at(_parser, _parser->current, "Can't have more than 255 parameters.");
+      }
+      lox_parser_push_item(_parser, (uint32_t)lox_parser_consume(_parser, LOX_IDENTIFIER,
+                                                                 "Expect parameter name."));
+    } while (lox_parser_match(_parser, LOX_COMMA));
+  }
+  lox_parser_consume(_parser, LOX_RIGHT_PAREN, "Expect ')' after parameters.");
+  const uint32_t parameters = lox_parser_push_list(_parser, mark);
+
+  lox_parser_consume(_parser, LOX_LEFT_BRACE, "Expect '{' before function body.");
+  const uint32_t body = lox_parser_block_list(_parser);
+  --_parser->depth;
+
+  return lox_parser_push_node(_parser, LOX_NODE_FUNCTION, name, parameters, body);
+}
+
+static lox_node_id_t
+lox_parser_class_declaration
+(
+  lox_parser_t *_parser
+)
+{
+  const long name = lox_parser_consume(_parser, LOX_IDENTIFIER, "Expect class name.");
+
+  lox_node_id_t superclass = LOX_NODE_NONE;
+  if (lox_parser_match(_parser, LOX_LESS))
+  {
+    const long superclass_name = lox_parser_consume(_parser, LOX_IDENTIFIER,
+                                                    "Expect superclass name.");
+    lox_string_view_t class_lexeme = lox_lexer_token_lexeme(_parser->lexer, &_parser->tokens[name]);
+    lox_string_view_t superclass_lexeme = lox_lexer_token_lexeme(_parser->lexer,
+                                                                 &_parser->tokens[superclass_name]);
+    if (class_lexeme.length == superclass_lexeme.length &&
+        memcmp(class_lexeme.data, superclass_lexeme.data, class_lexeme.length) == 0)
+    {
+      lox_parser_error_at(_parser, superclass_name, "A class can't inherit from itself.");
+    }
+
+    superclass = lox_parser_push_node(_parser, LOX_NODE_VARIABLE, superclass_name,
+                                      LOX_NODE_NONE, LOX_NODE_NONE);
+  }
+
+  lox_parser_consume(_parser, LOX_LEFT_BRACE, "Expect '{' before class body.");
+  const long mark = _parser->scratch_count;
+  while (!lox_parser_check(_parser, LOX_RIGHT_BRACE) && !lox_parser_check(_parser, LOX_EOF))
+  {
+    const long method_start = _parser->current;
+    lox_parser_push_item(_parser, lox_parser_function(_parser, "Expect method name."));
+
+    // A broken method may not have consumed anything
+    if (_parser->is_panicking && _parser->current == method_start)
+    {
+      lox_parser_advance(_parser);
+    }
+  }
+  lox_parser_consume(_parser, LOX_RIGHT_BRACE, "Expect '}' after class body.");
+  const uint32_t methods = lox_parser_push_list(_parser, mark);
+
+  return lox_parser_push_node(_parser, LOX_NODE_CLASS, name, superclass, methods);
+}
+
+/*
+ * Skips to what looks like the start of the next statement. Always
+ * moves past _start, where the broken declaration began, so a token
+ * nothing can parse doesn't stop the parser. Skipping to the end of the
+ * source leaves the parser panicking, since every block still open then
+ * misses its '}' only because of the error already reported.
+ */
+static void
+lox_parser_synchronize
+(
+  lox_parser_t *_parser,
+  long          _start
+)
+{
+  if (_parser->current == _start)
+  {
+    lox_parser_advance(_parser);
+  }
+
+  while (!lox_parser_check(_parser, LOX_EOF))
+  {
+    if (_parser->tokens[_parser->current - 1].type == LOX_SEMICOLON)
+    {
+      _parser->is_panicking = false;
+
+      return;
+    }
+
+    switch (lox_parser_peek(_parser))
+    {
+      case LOX_CLASS:
+      case LOX_FUN:
+      case LOX_VAR:
+      case LOX_FOR:
+      case LOX_IF:
+      case LOX_WHILE:
+      case LOX_PRINT:
+      case LOX_RETURN:
+        _parser->is_panicking = false;
+
+        return;
+      default:
+        break;
+    }
+
+    lox_parser_advance(_parser);
+  }
+}
+
+static lox_node_id_t
+lox_parser_declaration
+(
+  lox_parser_t *_parser
+)
+{
+  const long start = _parser->current;
+  lox_node_id_t declaration = LOX_NODE_NONE;
+  if (lox_parser_match(_parser, LOX_CLASS))
+  {
+    declaration = lox_parser_class_declaration(_parser);
+  }
+  else if (lox_parser_match(_parser, LOX_FUN))
+  {
+    declaration = lox_parser_function(_parser, "Expect function name.");
+  }
+  else if (lox_parser_match(_parser, LOX_VAR))
+  {
+    declaration = lox_parser_var_declaration(_parser);
+    lox_parser_consume(_parser, LOX_SEMICOLON, "Expect ';' after variable declaration.");
+  }
+  else
+  {
+    declaration = lox_parser_statement(_parser);
+  }
+
+  if (_parser->is_panicking)
+  {
+    lox_parser_synchronize(_parser, start);
+  }
+
+  return declaration;
+}
+
+lox_ast_t
+*lox_parse
+(
+  lox_lexer_t *_lexer
+)
+{
+  lox_ast_t *ast = calloc(1, sizeof(lox_ast_t));
+  if (ast == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for syntax tree\n");
+
+    return NULL;
+  }
+
+  // Nearly every node consumes a token of its own, so the node array
+  // rarely has to grow past this
+  ast->node_capacity = _lexer->token_count + 2;
+  ast->extra_capacity = LOX_AST_INITIAL_CAPACITY + _lexer->token_count / 4;
+  ast->nodes = malloc(ast->node_capacity * sizeof(lox_node_t));
+  ast->extra = malloc(ast->extra_capacity * sizeof(uint32_t));
+  if (ast->nodes == NULL || ast->extra == NULL)
+  {
+    fprintf(stderr, "failed to allocate syntax tree for %ld tokens\n", _lexer->token_count);
+    lox_ast_clean(ast);
+
+    return NULL;
+  }
+
+  // Node 0 is LOX_NODE_NONE, the program takes its place
+  lox_parser_t parser = {
+    .lexer = _lexer,
+    .tokens = _lexer->tokens,
+    .current = 1,
+    .ast = ast
+  };
+  lox_parser_push_node(&parser, LOX_NODE_PROGRAM, 0, LOX_NODE_NONE, LOX_NODE_NONE);
+
+  const long mark = parser.scratch_count;
+  while (!lox_parser_check(&parser, LOX_EOF) && !parser.is_out_of_memory)
+  {
+    lox_parser_push_item(&parser, lox_parser_declaration(&parser));
+  }
+  ast->nodes[0].right = lox_parser_push_list(&parser, mark);
+  ast->root = 0;
+
+  free(parser.scratch);
+  if (parser.is_out_of_memory)
+  {
+    lox_ast_clean(ast);
+
+    return NULL;
+  }
+
+  return ast;
+}
+
+const lox_node_t
+*lox_ast_get_node
+(
+  const lox_ast_t *_ast,
+  lox_node_id_t    _node
+)
+{
+  return &_ast->nodes[_node];
+}
+
+const uint32_t
+*lox_ast_get_list
+(
+  const lox_ast_t *_ast,
+  uint32_t         _list,
+  long            *_count
+)
+{
+  *_count = _ast->extra[_list];
+
+  return _ast->extra + _list + 1;
+}
+
+const char
+*lox_node_name
+(
+  lox_node_e _kind
+)
+{
+  static const char *const names[LOX_NODE_COUNT] = {
+    "LITERAL", "VARIABLE", "THIS", "SUPER", "GROUPING", "UNARY", "BINARY", "LOGICAL",
+    "ASSIGN", "CALL", "GET", "SET",
+    "EXPRESSION", "PRINT", "VAR", "BLOCK", "IF", "WHILE", "FOR", "RETURN", "FUNCTION",
+    "CLASS", "PROGRAM"
+  };
+
+  return (_kind < LOX_NODE_COUNT) ? names[_kind] : "INVALID";
+}
+
+static void
+lox_ast_debug_token
+(
+  const lox_lexer_t *_lexer,
+  uint32_t           _token
+)
+{
+  lox_string_view_t lexeme = lox_lexer_token_lexeme(_lexer, &_lexer->tokens[_token]);
+  printf("%.*s", (int)lexeme.length, lexeme.data);
+}
+
+typedef enum lox_ast_debug_e
+{
+  LOX_AST_DEBUG_TEXT,
+  LOX_AST_DEBUG_TOKEN,
+  LOX_AST_DEBUG_NODE,
+  LOX_AST_DEBUG_LIST
+} lox_ast_debug_e;
+
+/*
+ * What is left to print, popped in order. Trees built by the infix
+ * loop can be far deeper than LOX_PARSER_MAX_DEPTH, so they are walked
+ * without recursing.
+ */
+typedef struct lox_ast_debug_item_t
+{
+  const char *text;
+  uint32_t    value;
+  int         depth;
+  uint8_t     kind;
+} lox_ast_debug_item_t;
+
+typedef struct lox_ast_debug_stack_t
+{
+  lox_ast_debug_item_t *items;
+  long                  count;
+  long                  capacity;
+} lox_ast_debug_stack_t;
+
+static void
+lox_ast_debug_push
+(
+  lox_ast_debug_stack_t *_stack,
+  lox_ast_debug_e        _kind,
+  const char            *_text,
+  uint32_t               _value,
+  int                    _depth
+)
+{
+  if (_stack->count == _stack->capacity)
+  {
+    const long new_capacity = (_stack->capacity < 64) ? 64 : _stack->capacity * 2;
+    lox_ast_debug_item_t *new_items = realloc(_stack->items, new_capacity * sizeof(lox_ast_debug_item_t));
+    if (new_items == NULL)
+    {
+      fprintf(stderr, "out of memory printing the syntax tree\n");
+      exit(EXIT_FAILURE);
+    }
+    _stack->items = new_items;
+    _stack->capacity = new_capacity;
+  }
+  _stack->items[_stack->count++] = (lox_ast_debug_item_t){
+    .text = _text, .value = _value, .depth = _depth, .kind = (uint8_t)_kind
+  };
+}
+
+/*
+ * Pushes _node after a space, unless it is a statement, which starts on
+ * a new line instead.
+ */
+static void
+lox_ast_debug_push_child
+(
+  lox_ast_debug_stack_t *_stack,
+  const lox_ast_t       *_ast,
+  lox_node_id_t          _node,
+  int                    _depth
+)
+{
+  lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node, _depth);
+  if (_node == LOX_NODE_NONE || _ast->nodes[_node].kind < LOX_NODE_EXPRESSION)
+  {
+    lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, " ", 0, 0);
+  }
+}
+
+/*
+ * Pushes the items of _list, each after a space unless it is a
+ * statement, which starts on a new line instead.
+ */
+static void
+lox_ast_debug_push_list
+(
+  lox_ast_debug_stack_t *_stack,
+  const lox_ast_t       *_ast,
+  uint32_t               _list,
+  int                    _depth
+)
+{
+  long count = 0;
+  const uint32_t *items = lox_ast_get_list(_ast, _list, &count);
+  for (long i = count - 1; i >= 0; --i)
+  {
+    lox_ast_debug_push_child(_stack, _ast, items[i], _depth);
+  }
+}
+
+/*
+ * Prints what comes before the first child of the inner _node, and
+ * pushes the rest in reverse: its children at _depth + 1, separated by
+ * spaces, and the closing parenthesis.
+ */
+static void
+lox_ast_debug_open
+(
+  const lox_lexer_t     *_lexer,
+  const lox_ast_t       *_ast,
+  lox_ast_debug_stack_t *_stack,
+  const lox_node_t      *_node,
+  int                    _depth
+)
+{
+  const int child_depth = _depth + 1;
+  lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, ")", 0, 0);
+  printf("(");
+  switch (_node->kind)
+  {
+    case LOX_NODE_SUPER:
+      printf("super ");
+      lox_ast_debug_token(_lexer, _node->token + 2);
+
+      break;
+    case LOX_NODE_GROUPING:
+      printf("group ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_UNARY:
+      lox_ast_debug_token(_lexer, _node->token);
+      printf(" ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_BINARY:
+    case LOX_NODE_LOGICAL:
+      lox_ast_debug_token(_lexer, _node->token);
+      printf(" ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->right, child_depth);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, " ", 0, 0);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_ASSIGN:
+      printf("= ");
+      lox_ast_debug_token(_lexer, _node->token);
+      printf(" ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_CALL:
+      printf("call ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_LIST, NULL, _node->right, child_depth);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_GET:
+    case LOX_NODE_SET:
+      printf("%s ", (_node->kind == LOX_NODE_GET) ? "get" : "set");
+      if (_node->kind == LOX_NODE_SET)
+      {
+        lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->right, child_depth);
+        lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, " ", 0, 0);
+      }
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_TOKEN, NULL, _node->token, 0);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, " ", 0, 0);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_EXPRESSION:
+    case LOX_NODE_PRINT:
+    case LOX_NODE_RETURN:
+      printf("%s ", (_node->kind == LOX_NODE_EXPRESSION) ? "expr"
+                    : (_node->kind == LOX_NODE_PRINT) ? "print" : "return");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_VAR:
+      printf("var ");
+      lox_ast_debug_token(_lexer, _node->token);
+      printf(" ");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_BLOCK:
+      printf("block");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_LIST, NULL, _node->right, child_depth);
+
+      break;
+    case LOX_NODE_IF:
+      printf("if ");
+      lox_ast_debug_push_child(_stack, _ast, _ast->extra[_node->right + 1], child_depth);
+      lox_ast_debug_push_child(_stack, _ast, _ast->extra[_node->right], child_depth);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_WHILE:
+      printf("while ");
+      lox_ast_debug_push_child(_stack, _ast, _node->right, child_depth);
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _node->left, child_depth);
+
+      break;
+    case LOX_NODE_FOR:
+      printf("for");
+      lox_ast_debug_push_child(_stack, _ast, _node->right, child_depth);
+      for (int i = 2; i >= 0; --i)
+      {
+        lox_ast_debug_push(_stack, LOX_AST_DEBUG_NODE, NULL, _ast->extra[_node->left + i], child_depth);
+        lox_ast_debug_push(_stack, LOX_AST_DEBUG_TEXT, " ", 0, 0);
+      }
+
+      break;
+    case LOX_NODE_FUNCTION:
+    {
+      printf("fun ");
+      lox_ast_debug_token(_lexer, _node->token);
+      printf(" (");
+      long parameter_count = 0;
+      const uint32_t *parameters = lox_ast_get_list(_ast, _node->left, &parameter_count);
+      for (long i = 0; i < parameter_count; ++i)
+      {
+        printf(i > 0 ? " " : "");
+        lox_ast_debug_token(_lexer, parameters[i]);
+      }
+      printf(")");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_LIST, NULL, _node->right, child_depth);
+    } break;
+    case LOX_NODE_CLASS:
+      printf("class ");
+      lox_ast_debug_token(_lexer, _node->token);
+      if (_node->left != LOX_NODE_NONE)
+      {
+        printf(" < ");
+        lox_ast_debug_token(_lexer, _ast->nodes[_node->left].token);
+      }
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_LIST, NULL, _node->right, child_depth);
+
+      break;
+    case LOX_NODE_PROGRAM:
+      printf("program");
+      lox_ast_debug_push(_stack, LOX_AST_DEBUG_LIST, NULL, _node->right, child_depth);
+
+      break;
+    default:
+      printf("?");
+
+      break;
+  }
+}
+
+/*
+ * Statements go on lines of their own, indented by their depth, and
+ * expressions inline.
+ */
+void
+lox_ast_debug
+(
+  const lox_lexer_t *_lexer,
+  const lox_ast_t   *_ast
+)
+{
+  lox_ast_debug_stack_t stack = { 0 };
+  lox_ast_debug_push(&stack, LOX_AST_DEBUG_NODE, NULL, _ast->root, 0);
+  while (stack.count > 0)
+  {
+    const lox_ast_debug_item_t item = stack.items[--stack.count];
+    switch (item.kind)
+    {
+      case LOX_AST_DEBUG_TEXT:
+        printf("%s", item.text);
+
+        break;
+      case LOX_AST_DEBUG_TOKEN:
+        lox_ast_debug_token(_lexer, item.value);
+
+        break;
+      case LOX_AST_DEBUG_LIST:
+        lox_ast_debug_push_list(&stack, _ast, item.value, item.depth);
+
+        break;
+      case LOX_AST_DEBUG_NODE:
+      {
+        // Children of broken statements, or the optional ones left out
+        if (item.value == LOX_NODE_NONE && item.depth > 0)
+        {
+          printf("_");
+
+          break;
+        }
+
+        const lox_node_t *node = lox_ast_get_node(_ast, item.value);
+        if (node->kind == LOX_NODE_LITERAL || node->kind == LOX_NODE_VARIABLE ||
+            node->kind == LOX_NODE_THIS)
+        {
+          lox_ast_debug_token(_lexer, node->token);
+
+          break;
+        }
+        if (node->kind >= LOX_NODE_EXPRESSION && item.depth > 0)
+        {
+          printf("\n%*s", item.depth * 2, "");
+        }
+        lox_ast_debug_open(_lexer, _ast, &stack, node, item.depth);
+      } break;
+      default:
+        break;
+    }
+  }
+  free(stack.items);
+  printf("\n");
+}
+
+void
+lox_ast_clean
+(
+  lox_ast_t *_ast
+)
+{
+  free(_ast->nodes);
+  free(_ast->extra);
+  free(_ast);
+}
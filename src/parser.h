@@ -0,0 +1,155 @@
+/*
+ * Implements the parser, which turns the tokens of a lexer into a
+ * syntax tree. Declarations and statements are parsed by recursive
+ * descent, expressions by precedence climbing over a table of rules
+ * indexed by token type.
+ */
+
+#ifndef LOX_PARSER_H
+#define LOX_PARSER_H
+
+#include "base.h"
+#include "lexer.h"
+
+// Node 0 is never handed out, so it stands for a missing child
+#define LOX_NODE_NONE             0
+#define LOX_PARSER_MAX_DEPTH      512
+#define LOX_PARSER_MAX_ARGUMENTS  255
+#define LOX_AST_INITIAL_CAPACITY  64
+
+/*
+ * Nodes refer to each other by their position in the tree, which keeps
+ * them at 16 bytes and lets the tree be freed without walking it.
+ */
+typedef uint32_t lox_node_id_t;
+
+/*
+ * What token, left and right hold for every kind of node. Lists are
+ * stored in the tree's extra array as a count followed by the items,
+ * and referenced by the position of the count, see lox_ast_get_list.
+ */
+typedef enum lox_node_e
+{
+  // Expressions.
+  LOX_NODE_LITERAL,     // token: number, string, true, false or nil
+  LOX_NODE_VARIABLE,    // token: name
+  LOX_NODE_THIS,        // token: this
+  LOX_NODE_SUPER,       // token: super, the method name is 2 tokens later
+  LOX_NODE_GROUPING,    // token: '(', left: expression
+  LOX_NODE_UNARY,       // token: operator, left: operand
+  LOX_NODE_BINARY,      // token: operator, left and right: operands
+  LOX_NODE_LOGICAL,     // token: and or or, left and right: operands
+  LOX_NODE_ASSIGN,      // token: name, left: value
+  LOX_NODE_CALL,        // token: '(', left: callee, right: list of arguments
+  LOX_NODE_GET,         // token: property name, left: object
+  LOX_NODE_SET,         // token: property name, left: object, right: value
+
+  // Statements.
+  LOX_NODE_EXPRESSION,  // token: first token, left: expression
+  LOX_NODE_PRINT,       // token: print, left: expression
+  LOX_NODE_VAR,         // token: name, left: initializer or none
+  LOX_NODE_BLOCK,       // token: '{', right: list of declarations
+  LOX_NODE_IF,          // token: if, left: condition, right: extra index of then, else
+  LOX_NODE_WHILE,       // token: while, left: condition, right: body
+  LOX_NODE_FOR,         // token: for, left: extra index of initializer, condition,
+                        // increment, any of them none, right: body
+  LOX_NODE_RETURN,      // token: return, left: value or none
+  LOX_NODE_FUNCTION,    // token: name, left: list of parameter tokens, right: list of
+                        // declarations
+  LOX_NODE_CLASS,       // token: name, left: superclass variable or none, right: list
+                        // of methods
+  LOX_NODE_PROGRAM,     // token: BOF, right: list of declarations
+
+  LOX_NODE_COUNT
+} lox_node_e;
+
+typedef struct lox_node_t
+{
+  uint8_t       kind;
+  uint32_t      token;
+  lox_node_id_t left;
+  lox_node_id_t right;
+} lox_node_t;
+
+_Static_assert(sizeof(lox_node_t) <= 16, "lox_node_t should fit in 16 bytes");
+
+/*
+ * Nodes are bump-allocated from one array, sized up front from the
+ * number of tokens so it seldom grows. Tokens and their text stay in
+ * the lexer, which must outlive the tree.
+ */
+typedef struct lox_ast_t
+{
+  lox_node_t    *nodes;
+  long           node_count;
+  long           node_capacity;
+
+  uint32_t      *extra;
+  long           extra_count;
+  long           extra_capacity;
+
+  lox_node_id_t  root;
+  long           error_count;
+} lox_ast_t;
+
+/*
+ * Parses the tokens of _lexer. Syntax errors are reported on stderr
+ * and counted in error_count, the parser skips to the next statement
+ * and goes on, so the tree is complete but for the broken statements.
+ * Returns NULL if memory runs out.
+ */
+lox_ast_t
+*lox_parse
+(
+  lox_lexer_t *_lexer
+);
+
+const lox_node_t
+*lox_ast_get_node
+(
+  const lox_ast_t *_ast,
+  lox_node_id_t    _node
+);
+
+/*
+ * Returns the items of the list at _list and writes their number to
+ * _count.
+ */
+const uint32_t
+*lox_ast_get_list
+(
+  const lox_ast_t *_ast,
+  uint32_t         _list,
+  long            *_count
+);
+
+/*
+ * Name of _kind as spelled in lox_node_e, without the LOX_NODE_
+ * prefix.
+ */
+const char
+*lox_node_name
+(
+  lox_node_e _kind
+);
+
+/*
+ * Prints the tree as nested s-expressions on stdout.
+ */
+void
+lox_ast_debug
+(
+  const lox_lexer_t *_lexer,
+  const lox_ast_t   *_ast
+);
+
+/*
+ * Frees the whole tree at once.
+ */
+void
+lox_ast_clean
+(
+  lox_ast_t *_ast
+);
+
+#endif // LOX_PARSER_H
@@ -0,0 +1,486 @@
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static bool
+lox_simd_is_whitespace
+(
+  char _char
+)
+{
+  return _char == ' ' || _char == '\t' || _char == '\r' || _char == '\n';
+}
+
+static bool
+lox_simd_is_identifier
+(
+  char _char
+)
+{
+  return (_char >= 'a' && _char <= 'z') ||
+         (_char >= 'A' && _char <= 'Z') ||
+         (_char >= '0' && _char <= '9') ||
+         (_char == '_');
+}
+
+static const char
+*lox_simd_skip_whitespace_scalar
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (current_char < _end && lox_simd_is_whitespace(*current_char))
+  {
+    ++current_char;
+  }
+
+  return current_char;
+}
+
+static const char
+*lox_simd_find_line_end_scalar
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (current_char < _end && *current_char != '\n')
+  {
+    ++current_char;
+  }
+
+  return current_char;
+}
+
+static const char
+*lox_simd_find_string_end_scalar
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (current_char < _end && *current_char != '"')
+  {
+    ++current_char;
+  }
+
+  return current_char;
+}
+
+static const char
+*lox_simd_skip_identifier_scalar
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (current_char < _end && lox_simd_is_identifier(*current_char))
+  {
+    ++current_char;
+  }
+
+  return current_char;
+}
+
+static const char
+*lox_simd_skip_digits_scalar
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (current_char < _end && *current_char >= '0' && *current_char <= '9')
+  {
+    ++current_char;
+  }
+
+  return current_char;
+}
+
+static const lox_simd_kernels_t lox_simd_scalar_kernels = {
+  .name = "scalar",
+  .skip_whitespace = lox_simd_skip_whitespace_scalar,
+  .find_line_end = lox_simd_find_line_end_scalar,
+  .find_string_end = lox_simd_find_string_end_scalar,
+  .skip_identifier = lox_simd_skip_identifier_scalar,
+  .skip_digits = lox_simd_skip_digits_scalar
+};
+
+#ifdef LOX_SIMD_X86
+
+/*
+ * The SSE2 and AVX2 kernels build a bit mask per block, one bit per
+ * byte, of the bytes the kernel may skip. Bytes >= 0x80 compare as
+ * negative, so they never land in the ASCII ranges below. The tail
+ * shorter than a block is left to the scalar kernels.
+ */
+
+__attribute__((target("sse2")))
+static __m128i
+lox_simd_sse2_in_range
+(
+  __m128i _chunk,
+  char    _low,
+  char    _high
+)
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(_chunk, _mm_set1_epi8((char)(_low - 1))),
+                       _mm_cmplt_epi8(_chunk, _mm_set1_epi8((char)(_high + 1))));
+}
+
+__attribute__((target("sse2")))
+static const char
+*lox_simd_skip_whitespace_sse2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)current_char);
+    __m128i is_blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                                 _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                                                 _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+    uint32_t blank_mask = (uint32_t)_mm_movemask_epi8(is_blank);
+    if (blank_mask != 0xFFFF)
+    {
+      return current_char + __builtin_ctz(~blank_mask);
+    }
+
+    current_char += 16;
+  }
+
+  return lox_simd_skip_whitespace_scalar(current_char, _end);
+}
+
+__attribute__((target("sse2")))
+static const char
+*lox_simd_find_line_end_sse2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)current_char);
+    uint32_t newline_mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+    if (newline_mask != 0)
+    {
+      return current_char + __builtin_ctz(newline_mask);
+    }
+
+    current_char += 16;
+  }
+
+  return lox_simd_find_line_end_scalar(current_char, _end);
+}
+
+__attribute__((target("sse2")))
+static const char
+*lox_simd_find_string_end_sse2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)current_char);
+    uint32_t quote_mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+    if (quote_mask != 0)
+    {
+      return current_char + __builtin_ctz(quote_mask);
+    }
+
+    current_char += 16;
+  }
+
+  return lox_simd_find_string_end_scalar(current_char, _end);
+}
+
+__attribute__((target("sse2")))
+static const char
+*lox_simd_skip_identifier_sse2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)current_char);
+    // Setting 0x20 folds upper case letters onto lower case ones
+    __m128i is_letter = lox_simd_sse2_in_range(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i is_digit = lox_simd_sse2_in_range(chunk, '0', '9');
+    __m128i is_underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+    uint32_t identifier_mask = (uint32_t)_mm_movemask_epi8(
+      _mm_or_si128(_mm_or_si128(is_letter, is_digit), is_underscore));
+    if (identifier_mask != 0xFFFF)
+    {
+      return current_char + __builtin_ctz(~identifier_mask);
+    }
+
+    current_char += 16;
+  }
+
+  return lox_simd_skip_identifier_scalar(current_char, _end);
+}
+
+__attribute__((target("sse2")))
+static const char
+*lox_simd_skip_digits_sse2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)current_char);
+    uint32_t digit_mask = (uint32_t)_mm_movemask_epi8(lox_simd_sse2_in_range(chunk, '0', '9'));
+    if (digit_mask != 0xFFFF)
+    {
+      return current_char + __builtin_ctz(~digit_mask);
+    }
+
+    current_char += 16;
+  }
+
+  return lox_simd_skip_digits_scalar(current_char, _end);
+}
+
+static const lox_simd_kernels_t lox_simd_sse2_kernels = {
+  .name = "sse2",
+  .skip_whitespace = lox_simd_skip_whitespace_sse2,
+  .find_line_end = lox_simd_find_line_end_sse2,
+  .find_string_end = lox_simd_find_string_end_sse2,
+  .skip_identifier = lox_simd_skip_identifier_sse2,
+  .skip_digits = lox_simd_skip_digits_sse2
+};
+
+__attribute__((target("avx2")))
+static __m256i
+lox_simd_avx2_in_range
+(
+  __m256i _chunk,
+  char    _low,
+  char    _high
+)
+{
+  return _mm256_and_si256(_mm256_cmpgt_epi8(_chunk, _mm256_set1_epi8((char)(_low - 1))),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(_high + 1)), _chunk));
+}
+
+__attribute__((target("avx2")))
+static const char
+*lox_simd_skip_whitespace_avx2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)current_char);
+    __m256i is_blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                                                       _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')),
+                                                       _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))));
+    uint32_t blank_mask = (uint32_t)_mm256_movemask_epi8(is_blank);
+    if (blank_mask != 0xFFFFFFFFu)
+    {
+      return current_char + __builtin_ctz(~blank_mask);
+    }
+
+    current_char += 32;
+  }
+
+  return lox_simd_skip_whitespace_sse2(current_char, _end);
+}
+
+__attribute__((target("avx2")))
+static const char
+*lox_simd_find_line_end_avx2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)current_char);
+    uint32_t newline_mask = (uint32_t)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+    if (newline_mask != 0)
+    {
+      return current_char + __builtin_ctz(newline_mask);
+    }
+
+    current_char += 32;
+  }
+
+  return lox_simd_find_line_end_sse2(current_char, _end);
+}
+
+__attribute__((target("avx2")))
+static const char
+*lox_simd_find_string_end_avx2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)current_char);
+    uint32_t quote_mask = (uint32_t)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+    if (quote_mask != 0)
+    {
+      return current_char + __builtin_ctz(quote_mask);
+    }
+
+    current_char += 32;
+  }
+
+  return lox_simd_find_string_end_sse2(current_char, _end);
+}
+
+__attribute__((target("avx2")))
+static const char
+*lox_simd_skip_identifier_avx2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)current_char);
+    __m256i is_letter = lox_simd_avx2_in_range(_mm256_or_si256(chunk, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i is_digit = lox_simd_avx2_in_range(chunk, '0', '9');
+    __m256i is_underscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+    uint32_t identifier_mask = (uint32_t)_mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_or_si256(is_letter, is_digit), is_underscore));
+    if (identifier_mask != 0xFFFFFFFFu)
+    {
+      return current_char + __builtin_ctz(~identifier_mask);
+    }
+
+    current_char += 32;
+  }
+
+  return lox_simd_skip_identifier_sse2(current_char, _end);
+}
+
+__attribute__((target("avx2")))
+static const char
+*lox_simd_skip_digits_avx2
+(
+  const char *_begin,
+  const char *_end
+)
+{
+  const char *current_char = _begin;
+  while (_end - current_char >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)current_char);
+    uint32_t digit_mask = (uint32_t)_mm256_movemask_epi8(lox_simd_avx2_in_range(chunk, '0', '9'));
+    if (digit_mask != 0xFFFFFFFFu)
+    {
+      return current_char + __builtin_ctz(~digit_mask);
+    }
+
+    current_char += 32;
+  }
+
+  return lox_simd_skip_digits_sse2(current_char, _end);
+}
+
+static const lox_simd_kernels_t lox_simd_avx2_kernels = {
+  .name = "avx2",
+  .skip_whitespace = lox_simd_skip_whitespace_avx2,
+  .find_line_end = lox_simd_find_line_end_avx2,
+  .find_string_end = lox_simd_find_string_end_avx2,
+  .skip_identifier = lox_simd_skip_identifier_avx2,
+  .skip_digits = lox_simd_skip_digits_avx2
+};
+
+#endif // LOX_SIMD_X86
+
+const lox_simd_kernels_t
+*lox_simd_find_kernels
+(
+  const char *_name
+)
+{
+  if (strcmp(_name, "scalar") == 0)
+  {
+    return &lox_simd_scalar_kernels;
+  }
+
+#ifdef LOX_SIMD_X86
+  __builtin_cpu_init();
+  if (strcmp(_name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+  {
+    return &lox_simd_sse2_kernels;
+  }
+
+  if (strcmp(_name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+  {
+    return &lox_simd_avx2_kernels;
+  }
+#endif
+
+  return NULL;
+}
+
+const lox_simd_kernels_t
+*lox_simd_get_kernels
+(void)
+{
+  const char *requested = getenv(LOX_SIMD_ENVIRONMENT_VARIABLE);
+  if (requested != NULL)
+  {
+    const lox_simd_kernels_t *kernels = lox_simd_find_kernels(requested);
+    if (kernels != NULL)
+    {
+      return kernels;
+    }
+
+    fprintf(stderr, "%s kernels aren't available, picking the best supported\n", requested);
+  }
+
+  const char *preferred[] = { "avx2", "sse2" };
+  for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); ++i)
+  {
+    const lox_simd_kernels_t *kernels = lox_simd_find_kernels(preferred[i]);
+    if (kernels != NULL)
+    {
+      return kernels;
+    }
+  }
+
+  return &lox_simd_scalar_kernels;
+}
@@ -0,0 +1,53 @@
+/*
+ * Implements the lexer's bulk scanning kernels. Each kernel has a
+ * scalar version, plus SSE2 and AVX2 versions on x86 picked at runtime
+ * from what the CPU supports.
+ */
+
+#ifndef LOX_SIMD_H
+#define LOX_SIMD_H
+
+#include "base.h"
+
+#define LOX_SIMD_ENVIRONMENT_VARIABLE "LOX_SIMD"
+
+/*
+ * Every kernel scans [_begin, _end) and returns a pointer to the first
+ * character that stops it, or _end.
+ */
+typedef struct lox_simd_kernels_t
+{
+  const char *name;
+
+  // Stops at the first character other than ' ', '\t', '\r' or '\n'
+  const char *(*skip_whitespace)(const char *_begin, const char *_end);
+  // Stops at the first '\n'
+  const char *(*find_line_end)(const char *_begin, const char *_end);
+  // Stops at the first '"'
+  const char *(*find_string_end)(const char *_begin, const char *_end);
+  // Stops at the first character outside [A-Za-z0-9_]
+  const char *(*skip_identifier)(const char *_begin, const char *_end);
+  // Stops at the first character outside [0-9]
+  const char *(*skip_digits)(const char *_begin, const char *_end);
+} lox_simd_kernels_t;
+
+/*
+ * Returns the widest kernels the CPU supports. Setting the LOX_SIMD
+ * environment variable to "scalar", "sse2" or "avx2" forces that choice
+ * when it's available.
+ */
+const lox_simd_kernels_t
+*lox_simd_get_kernels
+(void);
+
+/*
+ * Returns the kernels with the given name, or NULL if they aren't
+ * compiled in or the CPU can't run them.
+ */
+const lox_simd_kernels_t
+*lox_simd_find_kernels
+(
+  const char *_name
+);
+
+#endif // LOX_SIMD_H
@@ -0,0 +1,159 @@
+#include "source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool
+lox_source_read_descriptor
+(
+  lox_source_t *_source,
+  int           _descriptor
+)
+{
+  long capacity = LOX_SOURCE_READ_CHUNK_SIZE;
+  long length = 0;
+  char *buffer = malloc(capacity);
+  if (buffer == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for source buffer\n");
+
+    return false;
+  }
+
+  for (;;)
+  {
+    if (length == capacity)
+    {
+      capacity *= 2;
+      char *new_buffer = realloc(buffer, capacity);
+      if (new_buffer == NULL)
+      {
+        fprintf(stderr, "failed to grow source buffer to %ld bytes\n", capacity);
+        free(buffer);
+
+        return false;
+      }
+      buffer = new_buffer;
+    }
+
+    ssize_t read_count = read(_descriptor, buffer + length, capacity - length);
+    if (read_count == 0)
+    {
+      break;
+    }
+
+    if (read_count < 0)
+    {
+      perror("failed to read source");
+      free(buffer);
+
+      return false;
+    }
+
+    length += read_count;
+  }
+
+  _source->data = buffer;
+  _source->length = length;
+  _source->is_owned = true;
+
+  return true;
+}
+
+static bool
+lox_source_map_descriptor
+(
+  lox_source_t *_source,
+  int           _descriptor,
+  long          _length
+)
+{
+  if (_length == 0)
+  {
+    // mmap rejects empty mappings
+    _source->data = "";
+    _source->length = 0;
+
+    return true;
+  }
+
+  void *mapping = mmap(NULL, _length, PROT_READ, MAP_PRIVATE, _descriptor, 0);
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+  madvise(mapping, _length, MADV_SEQUENTIAL);
+
+  _source->data = mapping;
+  _source->length = _length;
+  _source->is_mapped = true;
+
+  return true;
+}
+
+bool
+lox_source_open
+(
+  lox_source_t *_source,
+  const char   *_path
+)
+{
+  _source->data = NULL;
+  _source->length = 0;
+  _source->is_mapped = false;
+  _source->is_owned = false;
+
+  if (_path == NULL || strcmp(_path, "-") == 0)
+  {
+    return lox_source_read_descriptor(_source, STDIN_FILENO);
+  }
+
+  int descriptor = open(_path, O_RDONLY);
+  if (descriptor < 0)
+  {
+    fprintf(stderr, "failed to open source file\n");
+
+    return false;
+  }
+
+  struct stat file_stat;
+  bool is_loaded = false;
+  if (fstat(descriptor, &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+  {
+    is_loaded = lox_source_map_descriptor(_source, descriptor, (long)file_stat.st_size);
+  }
+
+  // Pipes, devices, or a failed mapping
+  if (!is_loaded)
+  {
+    is_loaded = lox_source_read_descriptor(_source, descriptor);
+  }
+
+  // The mapping outlives the descriptor
+  close(descriptor);
+
+  return is_loaded;
+}
+
+void
+lox_source_close
+(
+  lox_source_t *_source
+)
+{
+  if (_source->is_mapped)
+  {
+    munmap((void *)_source->data, _source->length);
+  }
+  else if (_source->is_owned)
+  {
+    free((void *)_source->data);
+  }
+
+  _source->data = NULL;
+  _source->length = 0;
+  _source->is_mapped = false;
+  _source->is_owned = false;
+}
@@ -0,0 +1,38 @@
+/*
+ * Loads program text as a read-only (pointer, length) view. Regular
+ * files are memory mapped, anything else is read into a heap buffer.
+ */
+
+#ifndef LOX_SOURCE_H
+#define LOX_SOURCE_H
+
+#include "base.h"
+
+#define LOX_SOURCE_READ_CHUNK_SIZE (64 * 1024)
+
+typedef struct lox_source_t
+{
+  const char *data;
+  long        length;
+  bool        is_mapped;
+  bool        is_owned;
+} lox_source_t;
+
+/*
+ * Opens _path, or standard input when _path is NULL or "-". The data
+ * isn't NUL-terminated when mapped, always go through length.
+ */
+bool
+lox_source_open
+(
+  lox_source_t *_source,
+  const char   *_path
+);
+
+void
+lox_source_close
+(
+  lox_source_t *_source
+);
+
+#endif // LOX_SOURCE_H
@@ -0,0 +1,13 @@
+#include "stats.h"
+
+#include <time.h>
+
+double
+lox_stats_now
+(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
@@ -0,0 +1,30 @@
+/*
+ * Implements the optional instrumentation of the lexer and interner.
+ *
+ * Counters are only compiled in when LOX_STATS is defined, which the
+ * LOX_STATS CMake option does for every target. Otherwise
+ * LOX_STATS_ONLY drops its argument, so instrumented code and the
+ * counter fields cost nothing.
+ */
+
+#ifndef LOX_STATS_H
+#define LOX_STATS_H
+
+#include "base.h"
+
+#ifdef LOX_STATS
+#define LOX_STATS_ENABLED   true
+#define LOX_STATS_ONLY(...) __VA_ARGS__
+#else
+#define LOX_STATS_ENABLED   false
+#define LOX_STATS_ONLY(...)
+#endif
+
+/*
+ * Monotonic time in seconds, for phase timings.
+ */
+double
+lox_stats_now
+(void);
+
+#endif // LOX_STATS_H
@@ -0,0 +1,241 @@
+#include "table.h"
+#include "memory.h"
+#include "object.h"
+
+void
+lox_table_init
+(
+  lox_table_t *_table
+)
+{
+  _table->entries = NULL;
+  _table->count = 0;
+  _table->capacity = 0;
+}
+
+/*
+ * Returns the entry of _key, or the slot it would go in, preferring
+ * the first deleted entry on the way to an empty one. The capacity is
+ * a power of two.
+ */
+static lox_table_entry_t
+*lox_table_find_entry
+(
+  lox_table_entry_t *_entries,
+  long               _capacity,
+  lox_string_t      *_key
+)
+{
+  uint32_t index = _key->hash & (uint32_t)(_capacity - 1);
+  lox_table_entry_t *tombstone = NULL;
+  for (;;)
+  {
+    lox_table_entry_t *entry = &_entries[index];
+    if (entry->key == _key)
+    {
+      return entry;
+    }
+
+    if (entry->key == NULL)
+    {
+      if (lox_value_is_nil(entry->value))
+      {
+        return (tombstone != NULL) ? tombstone : entry;
+      }
+      if (tombstone == NULL)
+      {
+        tombstone = entry;
+      }
+    }
+
+    index = (index + 1) & (uint32_t)(_capacity - 1);
+  }
+}
+
+static void
+lox_table_grow
+(
+  lox_table_t *_table
+)
+{
+  const long new_capacity = LOX_GROW_CAPACITY(_table->capacity);
+  lox_table_entry_t *new_entries = lox_reallocate(NULL, new_capacity * sizeof(lox_table_entry_t));
+  for (long i = 0; i < new_capacity; ++i)
+  {
+    new_entries[i].key = NULL;
+    new_entries[i].value = lox_value_nil();
+  }
+
+  // Deleted entries are dropped, so count starts over
+  _table->count = 0;
+  for (long i = 0; i < _table->capacity; ++i)
+  {
+    const lox_table_entry_t *entry = &_table->entries[i];
+    if (entry->key == NULL)
+    {
+      continue;
+    }
+
+    lox_table_entry_t *destination = lox_table_find_entry(new_entries, new_capacity, entry->key);
+    *destination = *entry;
+    ++_table->count;
+  }
+
+  lox_reallocate(_table->entries, 0);
+  _table->entries = new_entries;
+  _table->capacity = new_capacity;
+}
+
+bool
+lox_table_get
+(
+  const lox_table_t *_table,
+  lox_string_t      *_key,
+  lox_value_t       *_value
+)
+{
+  if (_table->count == 0)
+  {
+    return false;
+  }
+
+  const lox_table_entry_t *entry = lox_table_find_entry(_table->entries, _table->capacity, _key);
+  if (entry->key == NULL)
+  {
+    return false;
+  }
+  *_value = entry->value;
+
+  return true;
+}
+
+bool
+lox_table_set
+(
+  lox_table_t  *_table,
+  lox_string_t *_key,
+  lox_value_t   _value
+)
+{
+  if ((_table->count + 1) * 100 > _table->capacity * LOX_TABLE_MAX_LOAD_PERCENT)
+  {
+    lox_table_grow(_table);
+  }
+
+  lox_table_entry_t *entry = lox_table_find_entry(_table->entries, _table->capacity, _key);
+  const bool is_new = entry->key == NULL;
+  // Reusing a deleted entry doesn't change the count
+  if (is_new && lox_value_is_nil(entry->value))
+  {
+    ++_table->count;
+  }
+  entry->key = _key;
+  entry->value = _value;
+
+  return is_new;
+}
+
+bool
+lox_table_delete
+(
+  lox_table_t  *_table,
+  lox_string_t *_key
+)
+{
+  if (_table->count == 0)
+  {
+    return false;
+  }
+
+  lox_table_entry_t *entry = lox_table_find_entry(_table->entries, _table->capacity, _key);
+  if (entry->key == NULL)
+  {
+    return false;
+  }
+  entry->key = NULL;
+  entry->value = lox_value_bool(true);
+
+  return true;
+}
+
+void
+lox_table_add_all
+(
+  const lox_table_t *_from,
+  lox_table_t       *_to
+)
+{
+  for (long i = 0; i < _from->capacity; ++i)
+  {
+    const lox_table_entry_t *entry = &_from->entries[i];
+    if (entry->key != NULL)
+    {
+      lox_table_set(_to, entry->key, entry->value);
+    }
+  }
+}
+
+lox_string_t
+*lox_table_find_string
+(
+  const lox_table_t *_table,
+  const char        *_chars,
+  long               _length,
+  uint32_t           _hash
+)
+{
+  if (_table->count == 0)
+  {
+    return NULL;
+  }
+
+  uint32_t index = _hash & (uint32_t)(_table->capacity - 1);
+  for (;;)
+  {
+    const lox_table_entry_t *entry = &_table->entries[index];
+    if (entry->key == NULL)
+    {
+      if (lox_value_is_nil(entry->value))
+      {
+        return NULL;
+      }
+    }
+    else if (entry->key->hash == _hash && entry->key->length == (uint32_t)_length &&
+             memcmp(entry->key->chars, _chars, _length) == 0)
+    {
+      return entry->key;
+    }
+
+    index = (index + 1) & (uint32_t)(_table->capacity - 1);
+  }
+}
+
+void
+lox_table_rekey
+(
+  lox_table_t  *_table,
+  lox_string_t *_old_key,
+  lox_string_t *_new_key
+)
+{
+  if (_table->count == 0)
+  {
+    return;
+  }
+
+  lox_table_entry_t *entry = lox_table_find_entry(_table->entries, _table->capacity, _old_key);
+  if (entry->key == _old_key)
+  {
+    entry->key = _new_key;
+  }
+}
+
+void
+lox_table_clean
+(
+  lox_table_t *_table
+)
+{
+  lox_reallocate(_table->entries, 0);
+  lox_table_init(_table);
+}
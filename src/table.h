@@ -0,0 +1,114 @@
+/*
+ * Implements the hash table behind globals, fields, methods and the
+ * set of interned strings. Keys are interned strings, so they compare
+ * by pointer and bring their hash along.
+ */
+
+#ifndef LOX_TABLE_H
+#define LOX_TABLE_H
+
+#include "base.h"
+#include "value.h"
+
+#define LOX_TABLE_MAX_LOAD_PERCENT 75
+
+typedef struct lox_string_t lox_string_t;
+
+/*
+ * Empty entries have no key and a nil value, deleted ones no key and a
+ * true value, so probing goes on past them.
+ */
+typedef struct lox_table_entry_t
+{
+  lox_string_t *key;
+  lox_value_t   value;
+} lox_table_entry_t;
+
+/*
+ * Open addressing with linear probing. count includes the deleted
+ * entries, so the load factor accounts for them.
+ */
+typedef struct lox_table_t
+{
+  lox_table_entry_t *entries;
+  long               count;
+  long               capacity;
+} lox_table_t;
+
+void
+lox_table_init
+(
+  lox_table_t *_table
+);
+
+/*
+ * Writes the value of _key to _value and returns true if it is set.
+ */
+bool
+lox_table_get
+(
+  const lox_table_t *_table,
+  lox_string_t      *_key,
+  lox_value_t       *_value
+);
+
+/*
+ * Sets _key to _value and returns true if _key wasn't set before.
+ */
+bool
+lox_table_set
+(
+  lox_table_t  *_table,
+  lox_string_t *_key,
+  lox_value_t   _value
+);
+
+bool
+lox_table_delete
+(
+  lox_table_t  *_table,
+  lox_string_t *_key
+);
+
+/*
+ * Sets every key of _from in _to.
+ */
+void
+lox_table_add_all
+(
+  const lox_table_t *_from,
+  lox_table_t       *_to
+);
+
+/*
+ * Finds a key by its text rather than its pointer, which is how
+ * strings are interned.
+ */
+lox_string_t
+*lox_table_find_string
+(
+  const lox_table_t *_table,
+  const char        *_chars,
+  long               _length,
+  uint32_t           _hash
+);
+
+/*
+ * Replaces the key _old_key with _new_key, which hashes the same, if
+ * the table has it.
+ */
+void
+lox_table_rekey
+(
+  lox_table_t  *_table,
+  lox_string_t *_old_key,
+  lox_string_t *_new_key
+);
+
+void
+lox_table_clean
+(
+  lox_table_t *_table
+);
+
+#endif // LOX_TABLE_H
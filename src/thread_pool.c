@@ -0,0 +1,155 @@
+#include "thread_pool.h"
+
+/*
+ * Claims and runs tasks of the current batch until none are left.
+ * Must be called with the mutex held, which it releases around tasks.
+ */
+static void
+lox_thread_pool_drain
+(
+  lox_thread_pool_t *_pool
+)
+{
+  while (_pool->next_task < _pool->task_count)
+  {
+    const long task_index = _pool->next_task++;
+    lox_task_fn task = _pool->task;
+    void *context = _pool->context;
+
+    pthread_mutex_unlock(&_pool->mutex);
+    task(context, task_index);
+    pthread_mutex_lock(&_pool->mutex);
+
+    if (++_pool->finished_task_count == _pool->task_count)
+    {
+      pthread_cond_broadcast(&_pool->work_done);
+    }
+  }
+}
+
+static void
+*lox_thread_pool_work
+(
+  void *_pool
+)
+{
+  lox_thread_pool_t *pool = _pool;
+  unsigned long seen_batch_id = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;)
+  {
+    while (!pool->is_shutting_down && pool->batch_id == seen_batch_id)
+    {
+      pthread_cond_wait(&pool->work_ready, &pool->mutex);
+    }
+
+    if (pool->is_shutting_down)
+    {
+      break;
+    }
+
+    seen_batch_id = pool->batch_id;
+    lox_thread_pool_drain(pool);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+lox_thread_pool_t
+*lox_thread_pool_create
+(
+  int _thread_count
+)
+{
+  lox_thread_pool_t *new_pool = calloc(1, sizeof(lox_thread_pool_t));
+  if (new_pool == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for new thread pool\n");
+
+    return NULL;
+  }
+
+  pthread_mutex_init(&new_pool->mutex, NULL);
+  pthread_cond_init(&new_pool->work_ready, NULL);
+  pthread_cond_init(&new_pool->work_done, NULL);
+
+  const int spawned_count = (_thread_count > 1) ? _thread_count - 1 : 0;
+  new_pool->threads = calloc(spawned_count + 1, sizeof(pthread_t));
+  if (new_pool->threads == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for pool threads\n");
+    lox_thread_pool_clean(new_pool);
+
+    return NULL;
+  }
+
+  for (int i = 0; i < spawned_count; ++i)
+  {
+    if (pthread_create(&new_pool->threads[i], NULL, lox_thread_pool_work, new_pool) != 0)
+    {
+      fprintf(stderr, "failed to start pool thread %d\n", i);
+
+      break;
+    }
+
+    ++new_pool->thread_count;
+  }
+
+  return new_pool;
+}
+
+void
+lox_thread_pool_run
+(
+  lox_thread_pool_t *_pool,
+  lox_task_fn        _task,
+  void              *_context,
+  long               _task_count
+)
+{
+  if (_task_count <= 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&_pool->mutex);
+  _pool->task = _task;
+  _pool->context = _context;
+  _pool->task_count = _task_count;
+  _pool->next_task = 0;
+  _pool->finished_task_count = 0;
+  ++_pool->batch_id;
+  pthread_cond_broadcast(&_pool->work_ready);
+
+  lox_thread_pool_drain(_pool);
+  while (_pool->finished_task_count < _pool->task_count)
+  {
+    pthread_cond_wait(&_pool->work_done, &_pool->mutex);
+  }
+  pthread_mutex_unlock(&_pool->mutex);
+}
+
+void
+lox_thread_pool_clean
+(
+  lox_thread_pool_t *_pool
+)
+{
+  pthread_mutex_lock(&_pool->mutex);
+  _pool->is_shutting_down = true;
+  pthread_cond_broadcast(&_pool->work_ready);
+  pthread_mutex_unlock(&_pool->mutex);
+
+  for (int i = 0; i < _pool->thread_count; ++i)
+  {
+    pthread_join(_pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&_pool->work_done);
+  pthread_cond_destroy(&_pool->work_ready);
+  pthread_mutex_destroy(&_pool->mutex);
+  free(_pool->threads);
+  free(_pool);
+}
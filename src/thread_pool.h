@@ -0,0 +1,63 @@
+/*
+ * Implements a fixed set of worker threads that run batches of
+ * independent tasks.
+ */
+
+#ifndef LOX_THREAD_POOL_H
+#define LOX_THREAD_POOL_H
+
+#include <pthread.h>
+
+#include "base.h"
+
+typedef void (*lox_task_fn)(void *_context, long _task_index);
+
+typedef struct lox_thread_pool_t
+{
+  pthread_t       *threads;
+  int              thread_count;
+
+  pthread_mutex_t  mutex;
+  pthread_cond_t   work_ready;
+  pthread_cond_t   work_done;
+
+  // Current batch, guarded by mutex
+  lox_task_fn      task;
+  void            *context;
+  long             task_count;
+  long             next_task;
+  long             finished_task_count;
+  unsigned long    batch_id;
+  bool             is_shutting_down;
+} lox_thread_pool_t;
+
+/*
+ * Starts _thread_count - 1 threads, the caller of lox_thread_pool_run
+ * being the last worker.
+ */
+lox_thread_pool_t
+*lox_thread_pool_create
+(
+  int _thread_count
+);
+
+/*
+ * Runs _task for every index in [0, _task_count) across the pool and
+ * returns once all of them are done.
+ */
+void
+lox_thread_pool_run
+(
+  lox_thread_pool_t *_pool,
+  lox_task_fn        _task,
+  void              *_context,
+  long               _task_count
+);
+
+void
+lox_thread_pool_clean
+(
+  lox_thread_pool_t *_pool
+);
+
+#endif // LOX_THREAD_POOL_H
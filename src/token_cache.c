@@ -0,0 +1,482 @@
+#include "token_cache.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOX_XXH64_PRIME_1 11400714785074694791ULL
+#define LOX_XXH64_PRIME_2 14029467366897019727ULL
+#define LOX_XXH64_PRIME_3 1609587929392839161ULL
+#define LOX_XXH64_PRIME_4 9650029242287828579ULL
+#define LOX_XXH64_PRIME_5 2870177450012600261ULL
+
+// Tokens copied into zeroed records per write
+#define LOX_TOKEN_CACHE_WRITE_BATCH 256
+
+static uint64_t
+lox_xxh64_rotate
+(
+  uint64_t _value,
+  int      _bits
+)
+{
+  return (_value << _bits) | (_value >> (64 - _bits));
+}
+
+static uint64_t
+lox_xxh64_read64
+(
+  const char *_bytes
+)
+{
+  uint64_t value;
+  memcpy(&value, _bytes, sizeof(value));
+
+  return value;
+}
+
+static uint32_t
+lox_xxh64_read32
+(
+  const char *_bytes
+)
+{
+  uint32_t value;
+  memcpy(&value, _bytes, sizeof(value));
+
+  return value;
+}
+
+static uint64_t
+lox_xxh64_round
+(
+  uint64_t _accumulator,
+  uint64_t _input
+)
+{
+  _accumulator += _input * LOX_XXH64_PRIME_2;
+  _accumulator = lox_xxh64_rotate(_accumulator, 31);
+
+  return _accumulator * LOX_XXH64_PRIME_1;
+}
+
+static uint64_t
+lox_xxh64_merge
+(
+  uint64_t _hash,
+  uint64_t _accumulator
+)
+{
+  _hash ^= lox_xxh64_round(0, _accumulator);
+
+  return _hash * LOX_XXH64_PRIME_1 + LOX_XXH64_PRIME_4;
+}
+
+uint64_t
+lox_token_cache_hash
+(
+  const char *_source,
+  long        _source_length
+)
+{
+  const char *current = _source;
+  const char *end = _source + _source_length;
+
+  uint64_t hash;
+  if (_source_length >= 32)
+  {
+    uint64_t accumulators[4] = {
+      LOX_XXH64_PRIME_1 + LOX_XXH64_PRIME_2,
+      LOX_XXH64_PRIME_2,
+      0,
+      -LOX_XXH64_PRIME_1
+    };
+
+    for (; end - current >= 32; current += 32)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        accumulators[i] = lox_xxh64_round(accumulators[i], lox_xxh64_read64(current + 8 * i));
+      }
+    }
+
+    hash = lox_xxh64_rotate(accumulators[0], 1) + lox_xxh64_rotate(accumulators[1], 7) +
+           lox_xxh64_rotate(accumulators[2], 12) + lox_xxh64_rotate(accumulators[3], 18);
+    for (int i = 0; i < 4; ++i)
+    {
+      hash = lox_xxh64_merge(hash, accumulators[i]);
+    }
+  }
+  else
+  {
+    hash = LOX_XXH64_PRIME_5;
+  }
+
+  hash += (uint64_t)_source_length;
+
+  for (; end - current >= 8; current += 8)
+  {
+    hash ^= lox_xxh64_round(0, lox_xxh64_read64(current));
+    hash = lox_xxh64_rotate(hash, 27) * LOX_XXH64_PRIME_1 + LOX_XXH64_PRIME_4;
+  }
+
+  if (end - current >= 4)
+  {
+    hash ^= (uint64_t)lox_xxh64_read32(current) * LOX_XXH64_PRIME_1;
+    hash = lox_xxh64_rotate(hash, 23) * LOX_XXH64_PRIME_2 + LOX_XXH64_PRIME_3;
+    current += 4;
+  }
+
+  for (; current < end; ++current)
+  {
+    hash ^= (uint64_t)(uint8_t)*current * LOX_XXH64_PRIME_5;
+    hash = lox_xxh64_rotate(hash, 11) * LOX_XXH64_PRIME_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= LOX_XXH64_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= LOX_XXH64_PRIME_3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+char
+*lox_token_cache_default_directory
+(void)
+{
+  const char *base = getenv("XDG_CACHE_HOME");
+  const char *suffix = "/" LOX_TOKEN_CACHE_SUBDIRECTORY;
+  // Relative values are invalid per the XDG spec and get ignored
+  if (base == NULL || base[0] != '/')
+  {
+    base = getenv("HOME");
+    suffix = "/.cache/" LOX_TOKEN_CACHE_SUBDIRECTORY;
+  }
+  if (base == NULL || base[0] == '\0')
+  {
+    return NULL;
+  }
+
+  const size_t length = strlen(base) + strlen(suffix) + 1;
+  char *directory = malloc(length);
+  if (directory == NULL)
+  {
+    return NULL;
+  }
+  snprintf(directory, length, "%s%s", base, suffix);
+
+  return directory;
+}
+
+char
+*lox_token_cache_path
+(
+  const char *_cache_directory,
+  const char *_source_path
+)
+{
+  // The same source reached through another relative path or a link
+  // maps to the same file
+  char *absolute_path = realpath(_source_path, NULL);
+  if (absolute_path == NULL)
+  {
+    return NULL;
+  }
+  const uint64_t path_hash = lox_token_cache_hash(absolute_path, (long)strlen(absolute_path));
+  free(absolute_path);
+
+  const size_t length = strlen(_cache_directory) + 1 + 16 + sizeof(LOX_TOKEN_CACHE_SUFFIX);
+  char *cache_path = malloc(length);
+  if (cache_path == NULL)
+  {
+    return NULL;
+  }
+  snprintf(cache_path, length, "%s/%016llx%s", _cache_directory, (unsigned long long)path_hash,
+           LOX_TOKEN_CACHE_SUFFIX);
+
+  return cache_path;
+}
+
+/*
+ * Creates every missing directory leading up to the file at _path,
+ * like mkdir -p on its parent.
+ */
+static bool
+lox_token_cache_make_directories
+(
+  const char *_path
+)
+{
+  char *directory = strdup(_path);
+  if (directory == NULL)
+  {
+    return false;
+  }
+
+  bool is_made = true;
+  char *last_slash = strrchr(directory, '/');
+  for (char *slash = strchr(directory + 1, '/'); is_made && slash != NULL && slash <= last_slash;
+       slash = strchr(slash + 1, '/'))
+  {
+    *slash = '\0';
+    is_made = mkdir(directory, 0700) == 0 || errno == EEXIST;
+    *slash = '/';
+  }
+  free(directory);
+
+  return is_made;
+}
+
+/*
+ * Checks every token slices the source and refers to an existing
+ * name, so a damaged file can't send later stages out of bounds.
+ */
+static bool
+lox_token_cache_verify_tokens
+(
+  const lox_token_t *_tokens,
+  uint64_t           _token_count,
+  uint64_t           _source_length,
+  uint64_t           _interned_count
+)
+{
+  for (uint64_t i = 0; i < _token_count; ++i)
+  {
+    const lox_token_t *token = &_tokens[i];
+    if (token->type >= LOX_TOKEN_COUNT || token->literal_kind > LOX_LITERAL_INTERNED ||
+        (uint64_t)token->offset + token->length > _source_length ||
+        (token->literal_kind == LOX_LITERAL_INTERNED && token->literal.id >= _interned_count))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+lox_lexer_t
+*lox_token_cache_load
+(
+  const char *_cache_path,
+  const char *_source,
+  long        _source_length,
+  uint64_t    _source_hash
+)
+{
+  // A missing cache is the common case, not an error
+  if (access(_cache_path, R_OK) != 0)
+  {
+    return NULL;
+  }
+
+  lox_source_t file;
+  if (!lox_source_open(&file, _cache_path))
+  {
+    return NULL;
+  }
+
+  lox_token_cache_header_t header;
+  if (file.length < (long)sizeof(header))
+  {
+    fprintf(stderr, "token cache %s is truncated\n", _cache_path);
+    lox_source_close(&file);
+
+    return NULL;
+  }
+  memcpy(&header, file.data, sizeof(header));
+
+  if (memcmp(header.magic, LOX_TOKEN_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != LOX_TOKEN_CACHE_VERSION || header.token_size != sizeof(lox_token_t) ||
+      header.source_length != (uint64_t)_source_length || header.source_hash != _source_hash)
+  {
+    lox_source_close(&file);
+
+    return NULL;
+  }
+
+  const lox_token_t *tokens = (const lox_token_t *)(file.data + sizeof(header));
+  const lox_token_cache_name_t *names =
+    (const lox_token_cache_name_t *)(tokens + header.token_count);
+  const char *name_bytes = (const char *)(names + header.interned_count);
+  const uint64_t expected_length = sizeof(header) + header.token_count * sizeof(lox_token_t) +
+                                   header.interned_count * sizeof(lox_token_cache_name_t) +
+                                   header.names_length;
+  if (header.token_count > (uint64_t)file.length || header.interned_count > (uint64_t)file.length ||
+      expected_length != (uint64_t)file.length ||
+      !lox_token_cache_verify_tokens(tokens, header.token_count, header.source_length,
+                                     header.interned_count))
+  {
+    fprintf(stderr, "token cache %s is corrupt\n", _cache_path);
+    lox_source_close(&file);
+
+    return NULL;
+  }
+
+  lox_lexer_t *new_lexer = lox_lexer_create();
+  if (new_lexer == NULL)
+  {
+    lox_source_close(&file);
+
+    return NULL;
+  }
+
+  // Interning in id order hands out the same ids again
+  for (uint64_t i = 0; i < header.interned_count; ++i)
+  {
+    const lox_token_cache_name_t *name = &names[i];
+    if ((uint64_t)name->offset + name->length > header.names_length ||
+        lox_intern(new_lexer->interner, name_bytes + name->offset, name->length) != i)
+    {
+      fprintf(stderr, "token cache %s has a broken string table\n", _cache_path);
+      lox_source_close(&file);
+      lox_lexer_clean(new_lexer);
+
+      return NULL;
+    }
+  }
+
+  new_lexer->tokens = (lox_token_t *)tokens;
+  new_lexer->token_count = (long)header.token_count;
+  new_lexer->token_capacity = (long)header.token_count;
+  new_lexer->token_cache = file;
+  new_lexer->source = _source;
+  new_lexer->source_length = _source_length;
+
+  return new_lexer;
+}
+
+/*
+ * Writes the tokens field by field into zeroed records, so the padding
+ * of lox_token_t, and the bytes of a literal its kind leaves unused,
+ * don't make the file depend on what was in memory.
+ */
+static bool
+lox_token_cache_write_tokens
+(
+  FILE              *_file,
+  const lox_token_t *_tokens,
+  long               _token_count
+)
+{
+  lox_token_t records[LOX_TOKEN_CACHE_WRITE_BATCH];
+  for (long first = 0; first < _token_count; first += LOX_TOKEN_CACHE_WRITE_BATCH)
+  {
+    const long count = (_token_count - first < LOX_TOKEN_CACHE_WRITE_BATCH)
+                       ? _token_count - first : LOX_TOKEN_CACHE_WRITE_BATCH;
+    memset(records, 0, count * sizeof(lox_token_t));
+    for (long i = 0; i < count; ++i)
+    {
+      const lox_token_t *token = &_tokens[first + i];
+      lox_token_t *record = &records[i];
+      record->type = token->type;
+      record->literal_kind = token->literal_kind;
+      record->offset = token->offset;
+      record->length = token->length;
+      if (token->literal_kind == LOX_LITERAL_NUMBER)
+      {
+        record->literal.number = token->literal.number;
+      }
+      else if (token->literal_kind == LOX_LITERAL_INTERNED)
+      {
+        record->literal.id = token->literal.id;
+      }
+    }
+
+    if (fwrite(records, sizeof(lox_token_t), count, _file) != (size_t)count)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+lox_token_cache_store
+(
+  const char        *_cache_path,
+  const lox_lexer_t *_lexer,
+  uint64_t           _source_hash
+)
+{
+  // Loading the tokens would skip the diagnostics, they are lexed again
+  if (_lexer->had_error)
+  {
+    return false;
+  }
+
+  const lox_interner_t *interner = _lexer->interner;
+
+  lox_token_cache_header_t header = {
+    .magic = LOX_TOKEN_CACHE_MAGIC,
+    .version = LOX_TOKEN_CACHE_VERSION,
+    .token_size = sizeof(lox_token_t),
+    .source_hash = _source_hash,
+    .source_length = (uint64_t)_lexer->source_length,
+    .token_count = (uint64_t)_lexer->token_count,
+    .interned_count = interner->entry_count,
+    .names_length = 0
+  };
+  for (uint32_t i = 0; i < interner->entry_count; ++i)
+  {
+    header.names_length += interner->entries[i].length;
+  }
+
+  // Name offsets are 32-bit
+  if (header.names_length > UINT32_MAX || !lox_token_cache_make_directories(_cache_path))
+  {
+    return false;
+  }
+
+  const size_t path_length = strlen(_cache_path);
+  char *temporary_path = malloc(path_length + 32);
+  if (temporary_path == NULL)
+  {
+    return false;
+  }
+  snprintf(temporary_path, path_length + 32, "%s.%ld.tmp", _cache_path, (long)getpid());
+
+  FILE *file = fopen(temporary_path, "wb");
+  if (file == NULL)
+  {
+    free(temporary_path);
+
+    return false;
+  }
+
+  bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                    lox_token_cache_write_tokens(file, _lexer->tokens, _lexer->token_count);
+
+  uint32_t name_offset = 0;
+  for (uint32_t i = 0; is_written && i < interner->entry_count; ++i)
+  {
+    lox_token_cache_name_t name = {
+      .offset = name_offset,
+      .length = interner->entries[i].length
+    };
+    is_written = fwrite(&name, sizeof(name), 1, file) == 1;
+    name_offset += name.length;
+  }
+
+  for (uint32_t i = 0; is_written && i < interner->entry_count; ++i)
+  {
+    const lox_interned_t *entry = &interner->entries[i];
+    is_written = fwrite(entry->name, 1, entry->length, file) == entry->length;
+  }
+
+  is_written = (fclose(file) == 0) && is_written;
+  if (!is_written || rename(temporary_path, _cache_path) != 0)
+  {
+    unlink(temporary_path);
+    free(temporary_path);
+
+    return false;
+  }
+
+  free(temporary_path);
+
+  return true;
+}
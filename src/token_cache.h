@@ -0,0 +1,113 @@
+/*
+ * Implements an on-disk cache of lexed tokens, so unchanged sources
+ * don't have to be lexed again.
+ *
+ * A cache file is a lox_token_cache_header_t, the token array exactly
+ * as lox_token_t lays it out with its padding zeroed, a
+ * lox_token_cache_name_t per interned string in id order, and the
+ * bytes of those strings. Files are in host byte order and only meant
+ * to be read back on the machine that wrote them.
+ *
+ * Only sources that lexed without diagnostics are cached, so loading
+ * tokens from the cache never hides an error.
+ *
+ * Cache files live in a directory of their own, never next to the
+ * sources, one per source named after a hash of its absolute path.
+ */
+
+#ifndef LOX_TOKEN_CACHE_H
+#define LOX_TOKEN_CACHE_H
+
+#include "base.h"
+#include "lexer.h"
+
+#define LOX_TOKEN_CACHE_MAGIC        "LOXTOKC"
+// Bump whenever lexing rules or the token layout change
+#define LOX_TOKEN_CACHE_VERSION      3
+#define LOX_TOKEN_CACHE_SUFFIX       ".tokens"
+// Inside $XDG_CACHE_HOME or ~/.cache
+#define LOX_TOKEN_CACHE_SUBDIRECTORY "lox"
+
+typedef struct lox_token_cache_header_t
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t token_size;
+  uint64_t source_hash;
+  uint64_t source_length;
+  uint64_t token_count;
+  uint64_t interned_count;
+  uint64_t names_length;
+} lox_token_cache_header_t;
+
+typedef struct lox_token_cache_name_t
+{
+  uint32_t offset;
+  uint32_t length;
+} lox_token_cache_name_t;
+
+/*
+ * XXH64 of _source with seed 0, which keys a cache file to the exact
+ * text it was made from.
+ */
+uint64_t
+lox_token_cache_hash
+(
+  const char *_source,
+  long        _source_length
+);
+
+/*
+ * Directory cache files go to unless told otherwise, $XDG_CACHE_HOME/lox
+ * or else ~/.cache/lox. Returns NULL when neither variable is set. The
+ * caller frees the path.
+ */
+char
+*lox_token_cache_default_directory
+(void);
+
+/*
+ * Path of the cache file in _cache_directory for the source at
+ * _source_path, or NULL if the source path can't be resolved. The
+ * caller frees the path.
+ */
+char
+*lox_token_cache_path
+(
+  const char *_cache_directory,
+  const char *_source_path
+);
+
+/*
+ * Returns a lexer for _source whose tokens are mapped straight from
+ * _cache_path, or NULL if there's no cache file for this source. Only
+ * the interner is rebuilt, nothing is allocated per token. A file made
+ * from other text or by another version is silently ignored, and one
+ * that doesn't hold together is reported and ignored.
+ */
+lox_lexer_t
+*lox_token_cache_load
+(
+  const char *_cache_path,
+  const char *_source,
+  long        _source_length,
+  uint64_t    _source_hash
+);
+
+/*
+ * Writes the tokens and interned strings of _lexer to _cache_path,
+ * through a temporary file renamed over it so readers never see a
+ * partial cache, creating its directory first if needed. Storing is
+ * best effort and reports nothing: it returns false if _lexer reported
+ * errors or the file couldn't be written, which only costs the next
+ * run a lex.
+ */
+bool
+lox_token_cache_store
+(
+  const char        *_cache_path,
+  const lox_lexer_t *_lexer,
+  uint64_t           _source_hash
+);
+
+#endif // LOX_TOKEN_CACHE_H
@@ -0,0 +1,332 @@
+#include "token_pack.h"
+
+#define LOX_PACKED_FLAG_WORD_BITS 64
+
+static long
+lox_packed_flags_word_count
+(
+  long _token_count
+)
+{
+  return (_token_count + LOX_PACKED_FLAG_WORD_BITS - 1) / LOX_PACKED_FLAG_WORD_BITS;
+}
+
+static bool
+lox_packed_flags_create
+(
+  lox_packed_flags_t *_flags,
+  long                _token_count
+)
+{
+  const long word_count = lox_packed_flags_word_count(_token_count);
+  _flags->words = calloc(word_count + 1, sizeof(uint64_t));
+  _flags->counts = malloc((word_count + 1) * sizeof(uint32_t));
+  if (_flags->words == NULL || _flags->counts == NULL)
+  {
+    fprintf(stderr, "failed to allocate literal flags for %ld tokens\n", _token_count);
+
+    return false;
+  }
+
+  return true;
+}
+
+static void
+lox_packed_flags_set
+(
+  lox_packed_flags_t *_flags,
+  long                _index
+)
+{
+  _flags->words[_index / LOX_PACKED_FLAG_WORD_BITS] |=
+    (uint64_t)1 << (_index % LOX_PACKED_FLAG_WORD_BITS);
+}
+
+static void
+lox_packed_flags_count
+(
+  lox_packed_flags_t *_flags,
+  long                _token_count
+)
+{
+  const long word_count = lox_packed_flags_word_count(_token_count);
+  uint32_t count = 0;
+  for (long i = 0; i < word_count; ++i)
+  {
+    _flags->counts[i] = count;
+    count += (uint32_t)__builtin_popcountll(_flags->words[i]);
+  }
+}
+
+/*
+ * Position of the literal of token _index in its table, or -1 if the
+ * token has none.
+ */
+static long
+lox_packed_flags_rank
+(
+  const lox_packed_flags_t *_flags,
+  long                      _index
+)
+{
+  const uint64_t word = _flags->words[_index / LOX_PACKED_FLAG_WORD_BITS];
+  const uint64_t bit = (uint64_t)1 << (_index % LOX_PACKED_FLAG_WORD_BITS);
+  if ((word & bit) == 0)
+  {
+    return -1;
+  }
+
+  return (long)_flags->counts[_index / LOX_PACKED_FLAG_WORD_BITS] +
+         __builtin_popcountll(word & (bit - 1));
+}
+
+static void
+lox_packed_flags_clean
+(
+  lox_packed_flags_t *_flags
+)
+{
+  free(_flags->words);
+  free(_flags->counts);
+}
+
+static size_t
+lox_packed_flags_size
+(
+  long _token_count
+)
+{
+  return (lox_packed_flags_word_count(_token_count) + 1) * (sizeof(uint64_t) + sizeof(uint32_t));
+}
+
+lox_packed_tokens_t
+*lox_packed_tokens_create
+(
+  lox_lexer_t *_lexer
+)
+{
+  const long token_count = _lexer->token_count;
+  if (token_count > (long)UINT32_MAX)
+  {
+    fprintf(stderr, "can't pack more than %u tokens\n", UINT32_MAX);
+
+    return NULL;
+  }
+
+  long number_count = 0;
+  long name_count = 0;
+  long long_length_count = 0;
+  for (long i = 0; i < token_count; ++i)
+  {
+    const lox_token_t *token = &_lexer->tokens[i];
+    number_count += token->literal_kind == LOX_LITERAL_NUMBER;
+    name_count += token->literal_kind == LOX_LITERAL_INTERNED;
+    long_length_count += token->length >= LOX_PACKED_TOKEN_MAX_LENGTH;
+  }
+
+  lox_packed_tokens_t *packed = calloc(1, sizeof(lox_packed_tokens_t));
+  if (packed == NULL)
+  {
+    fprintf(stderr, "failed to allocate memory for packed tokens\n");
+
+    return NULL;
+  }
+  packed->token_count = token_count;
+  packed->number_count = number_count;
+  packed->name_count = name_count;
+  packed->long_length_count = long_length_count;
+
+  // A packed token is no larger than the wide one it is read from, so a
+  // buffer of the lexer's own is packed in place, front to back. Tokens
+  // mapped from the cache are read-only and get a buffer of their own.
+  // One spare element each, so empty tables still get a pointer
+  const bool is_in_place = _lexer->token_cache.data == NULL;
+  packed->tokens = is_in_place ? NULL : malloc((token_count + 1) * sizeof(lox_packed_token_t));
+  packed->numbers = malloc((number_count + 1) * sizeof(double));
+  packed->names = malloc((name_count + 1) * sizeof(lox_intern_id_t));
+  packed->long_lengths = malloc((long_length_count + 1) * sizeof(lox_packed_length_t));
+  if ((!is_in_place && packed->tokens == NULL) || packed->numbers == NULL ||
+      packed->names == NULL || packed->long_lengths == NULL)
+  {
+    fprintf(stderr, "failed to allocate %ld packed tokens\n", token_count);
+    lox_packed_tokens_clean(packed);
+
+    return NULL;
+  }
+
+  if (!lox_packed_flags_create(&packed->number_flags, token_count) ||
+      !lox_packed_flags_create(&packed->name_flags, token_count))
+  {
+    lox_packed_tokens_clean(packed);
+
+    return NULL;
+  }
+
+  if (is_in_place)
+  {
+    packed->tokens = (lox_packed_token_t *)_lexer->tokens;
+  }
+
+  long number_index = 0;
+  long name_index = 0;
+  long long_length_index = 0;
+  for (long i = 0; i < token_count; ++i)
+  {
+    // Copied out before the packed token can overwrite it
+    const lox_token_t wide_token = _lexer->tokens[i];
+    const lox_token_t *token = &wide_token;
+
+    uint64_t length = token->length;
+    if (length >= LOX_PACKED_TOKEN_MAX_LENGTH)
+    {
+      packed->long_lengths[long_length_index++] = (lox_packed_length_t){
+        .token_index = (uint32_t)i,
+        .length = token->length
+      };
+      length = LOX_PACKED_TOKEN_MAX_LENGTH;
+    }
+    packed->tokens[i] = (uint64_t)token->type | (length << 8) | ((uint64_t)token->offset << 32);
+
+    if (token->literal_kind == LOX_LITERAL_NUMBER)
+    {
+      lox_packed_flags_set(&packed->number_flags, i);
+      packed->numbers[number_index++] = token->literal.number;
+    }
+    else if (token->literal_kind == LOX_LITERAL_INTERNED)
+    {
+      lox_packed_flags_set(&packed->name_flags, i);
+      packed->names[name_index++] = token->literal.id;
+    }
+  }
+
+  lox_packed_flags_count(&packed->number_flags, token_count);
+  lox_packed_flags_count(&packed->name_flags, token_count);
+
+  if (is_in_place)
+  {
+    // Failing to shrink only keeps the spare bytes around
+    lox_packed_token_t *shrunk_tokens = realloc(packed->tokens,
+                                                (token_count + 1) * sizeof(lox_packed_token_t));
+    if (shrunk_tokens != NULL)
+    {
+      packed->tokens = shrunk_tokens;
+    }
+    _lexer->tokens = NULL;
+  }
+  lox_lexer_release_tokens(_lexer);
+
+  return packed;
+}
+
+static uint32_t
+lox_packed_tokens_find_length
+(
+  const lox_packed_tokens_t *_packed,
+  long                       _index
+)
+{
+  long low = 0;
+  long high = _packed->long_length_count - 1;
+  while (low < high)
+  {
+    const long middle = low + (high - low) / 2;
+    if ((long)_packed->long_lengths[middle].token_index < _index)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return _packed->long_lengths[low].length;
+}
+
+bool
+lox_packed_tokens_get
+(
+  const lox_packed_tokens_t *_packed,
+  long                       _index,
+  lox_token_t               *_token
+)
+{
+  if (_index < 0 || _index >= _packed->token_count)
+  {
+    return false;
+  }
+
+  const lox_packed_token_t packed_token = _packed->tokens[_index];
+  _token->type = (uint8_t)packed_token;
+  _token->length = (uint32_t)(packed_token >> 8) & LOX_PACKED_TOKEN_MAX_LENGTH;
+  _token->offset = (uint32_t)(packed_token >> 32);
+  if (_token->length == LOX_PACKED_TOKEN_MAX_LENGTH)
+  {
+    _token->length = lox_packed_tokens_find_length(_packed, _index);
+  }
+
+  _token->literal_kind = LOX_LITERAL_NONE;
+  _token->literal.number = 0.0;
+
+  // Only these types can have a literal, the rest skip the flags
+  long literal_index = -1;
+  if (_token->type == LOX_NUMBER &&
+      (literal_index = lox_packed_flags_rank(&_packed->number_flags, _index)) >= 0)
+  {
+    _token->literal_kind = LOX_LITERAL_NUMBER;
+    _token->literal.number = _packed->numbers[literal_index];
+  }
+  else if ((_token->type == LOX_IDENTIFIER || _token->type == LOX_STRING) &&
+           (literal_index = lox_packed_flags_rank(&_packed->name_flags, _index)) >= 0)
+  {
+    _token->literal_kind = LOX_LITERAL_INTERNED;
+    _token->literal.id = _packed->names[literal_index];
+  }
+
+  return true;
+}
+
+size_t
+lox_packed_tokens_size
+(
+  const lox_packed_tokens_t *_packed
+)
+{
+  size_t size = sizeof(lox_packed_tokens_t);
+  size += (_packed->token_count + 1) * sizeof(lox_packed_token_t);
+  size += 2 * lox_packed_flags_size(_packed->token_count);
+  size += (_packed->number_count + 1) * sizeof(double);
+  size += (_packed->name_count + 1) * sizeof(lox_intern_id_t);
+  size += (_packed->long_length_count + 1) * sizeof(lox_packed_length_t);
+
+  return size;
+}
+
+void
+lox_packed_tokens_debug
+(
+  const lox_lexer_t         *_lexer,
+  const lox_packed_tokens_t *_packed
+)
+{
+  lox_token_t token;
+  for (long i = 0; lox_packed_tokens_get(_packed, i, &token); ++i)
+  {
+    lox_lexer_debug_token(_lexer, i, &token);
+  }
+}
+
+void
+lox_packed_tokens_clean
+(
+  lox_packed_tokens_t *_packed
+)
+{
+  lox_packed_flags_clean(&_packed->number_flags);
+  lox_packed_flags_clean(&_packed->name_flags);
+  free(_packed->tokens);
+  free(_packed->numbers);
+  free(_packed->names);
+  free(_packed->long_lengths);
+  free(_packed);
+}
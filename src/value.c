@@ -0,0 +1,104 @@
+#include "value.h"
+#include "memory.h"
+#include "object.h"
+
+void
+lox_value_array_init
+(
+  lox_value_array_t *_array
+)
+{
+  _array->values = NULL;
+  _array->count = 0;
+  _array->capacity = 0;
+}
+
+long
+lox_value_array_push
+(
+  lox_value_array_t *_array,
+  lox_value_t        _value
+)
+{
+  if (_array->count == _array->capacity)
+  {
+    _array->capacity = LOX_GROW_CAPACITY(_array->capacity);
+    _array->values = lox_reallocate(_array->values, _array->capacity * sizeof(lox_value_t));
+  }
+  _array->values[_array->count] = _value;
+
+  return _array->count++;
+}
+
+void
+lox_value_array_clean
+(
+  lox_value_array_t *_array
+)
+{
+  lox_reallocate(_array->values, 0);
+  lox_value_array_init(_array);
+}
+
+bool
+lox_values_equal
+(
+  lox_value_t _a,
+  lox_value_t _b
+)
+{
+#ifdef LOX_TAGGED_VALUES
+  if (_a.type != _b.type)
+  {
+    return false;
+  }
+
+  switch (_a.type)
+  {
+    case LOX_VALUE_NIL:
+      return true;
+    case LOX_VALUE_BOOL:
+      return lox_value_as_bool(_a) == lox_value_as_bool(_b);
+    case LOX_VALUE_NUMBER:
+      return lox_value_as_number(_a) == lox_value_as_number(_b);
+    case LOX_VALUE_OBJECT:
+      return lox_value_as_object(_a) == lox_value_as_object(_b);
+    default:
+      return false;
+  }
+#else
+  // Comparing bits would make NaN equal to itself and 0 unequal to -0
+  if (lox_value_is_number(_a) && lox_value_is_number(_b))
+  {
+    return lox_value_as_number(_a) == lox_value_as_number(_b);
+  }
+
+  return _a == _b;
+#endif // LOX_TAGGED_VALUES
+}
+
+void
+lox_value_print
+(
+  FILE        *_file,
+  lox_value_t  _value
+)
+{
+  if (lox_value_is_nil(_value))
+  {
+    fprintf(_file, "nil");
+  }
+  else if (lox_value_is_bool(_value))
+  {
+    fprintf(_file, lox_value_as_bool(_value) ? "true" : "false");
+  }
+  else if (lox_value_is_number(_value))
+  {
+    // Enough digits to print integers below 10^15 exactly
+    fprintf(_file, "%.15g", lox_value_as_number(_value));
+  }
+  else
+  {
+    lox_object_print(_file, lox_value_as_object(_value));
+  }
+}
@@ -0,0 +1,325 @@
+/*
+ * Implements the values the VM computes with: nil, booleans, numbers
+ * and references to heap objects, see object.h.
+ *
+ * Values are built and taken apart through the functions below only,
+ * so their layout can change without touching the compiler or the VM.
+ * They are NaN-boxed into 64 bits unless LOX_TAGGED_VALUES is defined.
+ */
+
+#ifndef LOX_VALUE_H
+#define LOX_VALUE_H
+
+#include "base.h"
+
+typedef struct lox_object_t lox_object_t;
+
+#ifdef LOX_TAGGED_VALUES
+
+typedef enum lox_value_e
+{
+  LOX_VALUE_NIL,
+  LOX_VALUE_BOOL,
+  LOX_VALUE_NUMBER,
+  LOX_VALUE_OBJECT
+} lox_value_e;
+
+/*
+ * The debugging layout: a type tag next to a union, twice the size of
+ * a NaN-boxed value but readable in a debugger.
+ */
+typedef struct lox_value_t
+{
+  lox_value_e type;
+  union
+  {
+    bool          boolean;
+    double        number;
+    lox_object_t *object;
+  } as;
+} lox_value_t;
+
+static inline lox_value_t
+lox_value_nil
+(void)
+{
+  return (lox_value_t){ .type = LOX_VALUE_NIL, .as.number = 0.0 };
+}
+
+static inline lox_value_t
+lox_value_bool
+(
+  bool _boolean
+)
+{
+  return (lox_value_t){ .type = LOX_VALUE_BOOL, .as.boolean = _boolean };
+}
+
+static inline lox_value_t
+lox_value_number
+(
+  double _number
+)
+{
+  return (lox_value_t){ .type = LOX_VALUE_NUMBER, .as.number = _number };
+}
+
+static inline lox_value_t
+lox_value_object
+(
+  lox_object_t *_object
+)
+{
+  return (lox_value_t){ .type = LOX_VALUE_OBJECT, .as.object = _object };
+}
+
+static inline bool
+lox_value_is_nil
+(
+  lox_value_t _value
+)
+{
+  return _value.type == LOX_VALUE_NIL;
+}
+
+static inline bool
+lox_value_is_bool
+(
+  lox_value_t _value
+)
+{
+  return _value.type == LOX_VALUE_BOOL;
+}
+
+static inline bool
+lox_value_is_number
+(
+  lox_value_t _value
+)
+{
+  return _value.type == LOX_VALUE_NUMBER;
+}
+
+static inline bool
+lox_value_is_object
+(
+  lox_value_t _value
+)
+{
+  return _value.type == LOX_VALUE_OBJECT;
+}
+
+static inline bool
+lox_value_as_bool
+(
+  lox_value_t _value
+)
+{
+  return _value.as.boolean;
+}
+
+static inline double
+lox_value_as_number
+(
+  lox_value_t _value
+)
+{
+  return _value.as.number;
+}
+
+static inline lox_object_t
+*lox_value_as_object
+(
+  lox_value_t _value
+)
+{
+  return _value.as.object;
+}
+
+#else
+
+/*
+ * A value is one 64-bit word. Numbers are stored as their IEEE 754
+ * bits. Everything else hides in the payload of a quiet NaN that no
+ * arithmetic produces: nil, false and true are the small payloads 1
+ * to 3, and objects set the sign bit on top of their 48-bit address.
+ */
+typedef uint64_t lox_value_t;
+
+_Static_assert(sizeof(void *) <= sizeof(lox_value_t), "NaN-boxing needs pointers of at most 64 bits");
+
+#define LOX_VALUE_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define LOX_VALUE_QNAN     ((uint64_t)0x7ffc000000000000)
+#define LOX_VALUE_TAG_NIL   1
+#define LOX_VALUE_TAG_FALSE 2
+#define LOX_VALUE_TAG_TRUE  3
+
+static inline lox_value_t
+lox_value_nil
+(void)
+{
+  return LOX_VALUE_QNAN | LOX_VALUE_TAG_NIL;
+}
+
+static inline lox_value_t
+lox_value_bool
+(
+  bool _boolean
+)
+{
+  return LOX_VALUE_QNAN | (_boolean ? LOX_VALUE_TAG_TRUE : LOX_VALUE_TAG_FALSE);
+}
+
+static inline lox_value_t
+lox_value_number
+(
+  double _number
+)
+{
+  lox_value_t value;
+  memcpy(&value, &_number, sizeof(value));
+
+  return value;
+}
+
+static inline lox_value_t
+lox_value_object
+(
+  lox_object_t *_object
+)
+{
+  return LOX_VALUE_SIGN_BIT | LOX_VALUE_QNAN | (uint64_t)(uintptr_t)_object;
+}
+
+static inline bool
+lox_value_is_nil
+(
+  lox_value_t _value
+)
+{
+  return _value == lox_value_nil();
+}
+
+static inline bool
+lox_value_is_bool
+(
+  lox_value_t _value
+)
+{
+  // false and true differ in the lowest bit only
+  return (_value | 1) == lox_value_bool(true);
+}
+
+static inline bool
+lox_value_is_number
+(
+  lox_value_t _value
+)
+{
+  return (_value & LOX_VALUE_QNAN) != LOX_VALUE_QNAN;
+}
+
+static inline bool
+lox_value_is_object
+(
+  lox_value_t _value
+)
+{
+  return (_value & (LOX_VALUE_SIGN_BIT | LOX_VALUE_QNAN)) == (LOX_VALUE_SIGN_BIT | LOX_VALUE_QNAN);
+}
+
+static inline bool
+lox_value_as_bool
+(
+  lox_value_t _value
+)
+{
+  return _value == lox_value_bool(true);
+}
+
+static inline double
+lox_value_as_number
+(
+  lox_value_t _value
+)
+{
+  double number;
+  memcpy(&number, &_value, sizeof(number));
+
+  return number;
+}
+
+static inline lox_object_t
+*lox_value_as_object
+(
+  lox_value_t _value
+)
+{
+  return (lox_object_t *)(uintptr_t)(_value & ~(LOX_VALUE_SIGN_BIT | LOX_VALUE_QNAN));
+}
+
+#endif // LOX_TAGGED_VALUES
+
+/*
+ * nil and false are falsey, every other value is truthy.
+ */
+static inline bool
+lox_value_is_falsey
+(
+  lox_value_t _value
+)
+{
+  return lox_value_is_nil(_value) || (lox_value_is_bool(_value) && !lox_value_as_bool(_value));
+}
+
+typedef struct lox_value_array_t
+{
+  lox_value_t *values;
+  long         count;
+  long         capacity;
+} lox_value_array_t;
+
+void
+lox_value_array_init
+(
+  lox_value_array_t *_array
+);
+
+/*
+ * Appends _value and returns its index.
+ */
+long
+lox_value_array_push
+(
+  lox_value_array_t *_array,
+  lox_value_t        _value
+);
+
+void
+lox_value_array_clean
+(
+  lox_value_array_t *_array
+);
+
+/*
+ * Numbers are equal by value, objects by identity, which for strings
+ * is the same thing since they are interned.
+ */
+bool
+lox_values_equal
+(
+  lox_value_t _a,
+  lox_value_t _b
+);
+
+/*
+ * Prints _value as the print statement does, without a newline.
+ */
+void
+lox_value_print
+(
+  FILE        *_file,
+  lox_value_t  _value
+);
+
+#endif // LOX_VALUE_H
@@ -0,0 +1,887 @@
+#include "vm.h"
+#include "compiler.h"
+#include "memory.h"
+
+#include <stdarg.h>
+#include <time.h>
+
+#if defined(__GNUC__) && !defined(LOX_SWITCH_DISPATCH)
+#define LOX_VM_COMPUTED_GOTO
+#endif
+
+static inline lox_value_t
+lox_vm_peek
+(
+  const lox_vm_t *_vm,
+  int             _distance
+)
+{
+  return _vm->stack_top[-1 - _distance];
+}
+
+static void
+lox_vm_reset_stack
+(
+  lox_vm_t *_vm
+)
+{
+  _vm->stack_top = _vm->stack;
+  _vm->frame_count = 0;
+  _vm->open_upvalues = NULL;
+}
+
+/*
+ * Reports an error with the line of every call it happened under, and
+ * unwinds the stack. The ip of every frame must be up to date.
+ */
+static void
+lox_vm_runtime_error
+(
+  lox_vm_t   *_vm,
+  const char *_format,
+  ...
+)
+{
+  va_list arguments;
+  va_start(arguments, _format);
+  vfprintf(stderr, _format, arguments);
+  va_end(arguments);
+  fputs("\n", stderr);
+
+  for (int i = _vm->frame_count - 1; i >= 0; --i)
+  {
+    const lox_call_frame_t *frame = &_vm->frames[i];
+    const lox_function_t *function = frame->closure->function;
+    // ip is past the instruction that failed
+    const long offset = frame->ip - function->chunk.code - 1;
+    fprintf(stderr, "[line %ld] in ", lox_chunk_get_line(&function->chunk, offset));
+    if (function->name == NULL)
+    {
+      fprintf(stderr, "script\n");
+    }
+    else
+    {
+      fprintf(stderr, "%s()\n", function->name->chars);
+    }
+  }
+
+  lox_vm_reset_stack(_vm);
+}
+
+static lox_value_t
+lox_vm_clock_native
+(
+  int          _argument_count,
+  lox_value_t *_arguments
+)
+{
+  (void)_argument_count;
+  (void)_arguments;
+
+  return lox_value_number((double)clock() / CLOCKS_PER_SEC);
+}
+
+lox_vm_t
+*lox_vm_create
+(void)
+{
+  lox_vm_t *vm = lox_reallocate(NULL, sizeof(lox_vm_t));
+  vm->stack = lox_reallocate(NULL, LOX_VM_STACK_MAX * sizeof(lox_value_t));
+  lox_vm_reset_stack(vm);
+  vm->objects = NULL;
+  vm->bytes_allocated = 0;
+  lox_gc_init(&vm->gc);
+  lox_table_init(&vm->globals);
+  lox_table_init(&vm->strings);
+  // Read by the collector, which may run while "init" is allocated
+  vm->init_string = NULL;
+  vm->init_string = lox_string_copy(vm, "init", 4);
+
+  lox_vm_define_native(vm, "clock", lox_vm_clock_native, 0);
+
+  return vm;
+}
+
+void
+lox_vm_define_native
+(
+  lox_vm_t      *_vm,
+  const char    *_name,
+  lox_native_fn  _function,
+  int            _arity
+)
+{
+  lox_string_t *name = lox_string_copy(_vm, _name, (long)strlen(_name));
+  lox_vm_push(_vm, lox_value_object(&name->object));
+  lox_native_t *native = lox_native_create(_vm, _function, _arity, name);
+  lox_vm_push(_vm, lox_value_object(&native->object));
+
+  lox_gc_barrier(&_vm->gc, NULL, lox_value_object(&name->object));
+  lox_gc_barrier(&_vm->gc, NULL, lox_value_object(&native->object));
+  lox_table_set(&_vm->globals, name, lox_value_object(&native->object));
+  lox_vm_pop(_vm);
+  lox_vm_pop(_vm);
+}
+
+static bool
+lox_vm_call
+(
+  lox_vm_t      *_vm,
+  lox_closure_t *_closure,
+  int            _argument_count
+)
+{
+  const lox_function_t *function = _closure->function;
+  if (_argument_count != function->arity)
+  {
+    lox_vm_runtime_error(_vm, "Expected %d arguments but got %d.", function->arity,
+                         _argument_count);
+
+    return false;
+  }
+
+  lox_value_t *slots = _vm->stack_top - _argument_count - 1;
+  if (_vm->frame_count == LOX_VM_FRAMES_MAX ||
+      slots + function->max_slots > _vm->stack + LOX_VM_STACK_MAX)
+  {
+    lox_vm_runtime_error(_vm, "Stack overflow.");
+
+    return false;
+  }
+
+  lox_call_frame_t *frame = &_vm->frames[_vm->frame_count++];
+  frame->closure = _closure;
+  frame->ip = function->chunk.code;
+  frame->slots = slots;
+
+  return true;
+}
+
+static bool
+lox_vm_call_value
+(
+  lox_vm_t    *_vm,
+  lox_value_t  _callee,
+  int          _argument_count
+)
+{
+  if (lox_value_is_object(_callee))
+  {
+    lox_object_t *object = lox_value_as_object(_callee);
+    switch (object->type)
+    {
+      case LOX_OBJECT_CLOSURE:
+        return lox_vm_call(_vm, (lox_closure_t *)object, _argument_count);
+      case LOX_OBJECT_BOUND_METHOD:
+      {
+        lox_bound_method_t *bound_method = (lox_bound_method_t *)object;
+        _vm->stack_top[-_argument_count - 1] = bound_method->receiver;
+
+        return lox_vm_call(_vm, bound_method->method, _argument_count);
+      }
+      case LOX_OBJECT_CLASS:
+      {
+        lox_class_t *class_ = (lox_class_t *)object;
+        lox_instance_t *instance = lox_instance_create(_vm, class_);
+        _vm->stack_top[-_argument_count - 1] = lox_value_object(&instance->object);
+        if (!lox_value_is_nil(class_->initializer))
+        {
+          return lox_vm_call(_vm, (lox_closure_t *)lox_value_as_object(class_->initializer),
+                             _argument_count);
+        }
+
+        if (_argument_count != 0)
+        {
+          lox_vm_runtime_error(_vm, "Expected 0 arguments but got %d.", _argument_count);
+
+          return false;
+        }
+
+        return true;
+      }
+      case LOX_OBJECT_NATIVE:
+      {
+        const lox_native_t *native = (const lox_native_t *)object;
+        if (_argument_count != native->arity)
+        {
+          lox_vm_runtime_error(_vm, "Expected %d arguments but got %d.", native->arity,
+                               _argument_count);
+
+          return false;
+        }
+
+        const lox_value_t result = native->function(_argument_count,
+                                                    _vm->stack_top - _argument_count);
+        _vm->stack_top -= _argument_count + 1;
+        lox_vm_push(_vm, result);
+
+        return true;
+      }
+      default:
+        break;
+    }
+  }
+
+  lox_vm_runtime_error(_vm, "Can only call functions and classes.");
+
+  return false;
+}
+
+static bool
+lox_vm_invoke_from_class
+(
+  lox_vm_t     *_vm,
+  lox_class_t  *_class,
+  lox_string_t *_name,
+  int           _argument_count
+)
+{
+  lox_value_t method;
+  if (!lox_table_get(&_class->methods, _name, &method))
+  {
+    lox_vm_runtime_error(_vm, "Undefined property '%s'.", _name->chars);
+
+    return false;
+  }
+
+  return lox_vm_call(_vm, (lox_closure_t *)lox_value_as_object(method), _argument_count);
+}
+
+/*
+ * Calls the method _name of the receiver under the arguments, or the
+ * function in its field of that name.
+ */
+static bool
+lox_vm_invoke
+(
+  lox_vm_t     *_vm,
+  lox_string_t *_name,
+  int           _argument_count
+)
+{
+  const lox_value_t receiver = lox_vm_peek(_vm, _argument_count);
+  if (!lox_value_is_object_type(receiver, LOX_OBJECT_INSTANCE))
+  {
+    lox_vm_runtime_error(_vm, "Only instances have methods.");
+
+    return false;
+  }
+
+  lox_instance_t *instance = (lox_instance_t *)lox_value_as_object(receiver);
+  lox_value_t field;
+  if (lox_table_get(&instance->fields, _name, &field))
+  {
+    _vm->stack_top[-_argument_count - 1] = field;
+
+    return lox_vm_call_value(_vm, field, _argument_count);
+  }
+
+  return lox_vm_invoke_from_class(_vm, instance->class_, _name, _argument_count);
+}
+
+/*
+ * Replaces the instance on top of the stack with its method _name
+ * bound to it.
+ */
+static bool
+lox_vm_bind_method
+(
+  lox_vm_t     *_vm,
+  lox_class_t  *_class,
+  lox_string_t *_name
+)
+{
+  lox_value_t method;
+  if (!lox_table_get(&_class->methods, _name, &method))
+  {
+    lox_vm_runtime_error(_vm, "Undefined property '%s'.", _name->chars);
+
+    return false;
+  }
+
+  lox_bound_method_t *bound_method =
+    lox_bound_method_create(_vm, lox_vm_peek(_vm, 0), (lox_closure_t *)lox_value_as_object(method));
+  _vm->stack_top[-1] = lox_value_object(&bound_method->object);
+
+  return true;
+}
+
+/*
+ * Returns the upvalue of _slot, sharing it with the closures that
+ * captured the same variable before.
+ */
+static lox_upvalue_t
+*lox_vm_capture_upvalue
+(
+  lox_vm_t    *_vm,
+  lox_value_t *_slot
+)
+{
+  lox_upvalue_t *previous = NULL;
+  lox_upvalue_t *upvalue = _vm->open_upvalues;
+  while (upvalue != NULL && upvalue->location > _slot)
+  {
+    previous = upvalue;
+    upvalue = upvalue->next_open;
+  }
+
+  if (upvalue != NULL && upvalue->location == _slot)
+  {
+    return upvalue;
+  }
+
+  lox_upvalue_t *new_upvalue = lox_upvalue_create(_vm, _slot);
+  new_upvalue->next_open = upvalue;
+  if (previous == NULL)
+  {
+    _vm->open_upvalues = new_upvalue;
+  }
+  else
+  {
+    previous->next_open = new_upvalue;
+  }
+
+  return new_upvalue;
+}
+
+/*
+ * Moves the variables from _last up off the stack into the upvalues
+ * that captured them.
+ */
+static void
+lox_vm_close_upvalues
+(
+  lox_vm_t    *_vm,
+  lox_value_t *_last
+)
+{
+  while (_vm->open_upvalues != NULL && _vm->open_upvalues->location >= _last)
+  {
+    lox_upvalue_t *upvalue = _vm->open_upvalues;
+    lox_gc_barrier(&_vm->gc, &upvalue->object, *upvalue->location);
+    upvalue->closed = *upvalue->location;
+    upvalue->location = &upvalue->closed;
+    _vm->open_upvalues = upvalue->next_open;
+  }
+}
+
+static void
+lox_vm_define_method
+(
+  lox_vm_t     *_vm,
+  lox_string_t *_name
+)
+{
+  const lox_value_t method = lox_vm_peek(_vm, 0);
+  lox_class_t *class_ = (lox_class_t *)lox_value_as_object(lox_vm_peek(_vm, 1));
+  lox_gc_barrier(&_vm->gc, &class_->object, lox_value_object(&_name->object));
+  lox_gc_barrier(&_vm->gc, &class_->object, method);
+  lox_table_set(&class_->methods, _name, method);
+  if (_name == _vm->init_string)
+  {
+    class_->initializer = method;
+  }
+  lox_vm_pop(_vm);
+}
+
+static void
+lox_vm_concatenate
+(
+  lox_vm_t *_vm
+)
+{
+  const lox_string_t *b = (const lox_string_t *)lox_value_as_object(lox_vm_peek(_vm, 0));
+  const lox_string_t *a = (const lox_string_t *)lox_value_as_object(lox_vm_peek(_vm, 1));
+  lox_string_t *result = lox_string_concatenate(_vm, a, b);
+  _vm->stack_top -= 2;
+  lox_vm_push(_vm, lox_value_object(&result->object));
+}
+
+/*
+ * The current frame's ip and constants are kept in locals, so they can
+ * stay in registers. They are written back before anything that reads
+ * them from the frame: calls and runtime errors.
+ */
+static lox_interpret_e
+lox_vm_execute
+(
+  lox_vm_t *_vm
+)
+{
+  lox_call_frame_t *frame;
+  uint8_t *ip;
+  lox_value_t *constants;
+
+#define LOX_VM_LOAD_FRAME()                                           \
+  do                                                                  \
+  {                                                                   \
+    frame = &_vm->frames[_vm->frame_count - 1];                       \
+    ip = frame->ip;                                                   \
+    constants = frame->closure->function->chunk.constants.values;     \
+  } while (false)
+#define LOX_VM_SAVE_IP() (frame->ip = ip)
+#define LOX_VM_READ_BYTE() (*ip++)
+#define LOX_VM_READ_SHORT() (ip += 2, (uint16_t)(ip[-2] << 8 | ip[-1]))
+#define LOX_VM_READ_CONSTANT() (constants[LOX_VM_READ_SHORT()])
+#define LOX_VM_READ_STRING() ((lox_string_t *)lox_value_as_object(LOX_VM_READ_CONSTANT()))
+#define LOX_VM_ERROR(...)                                             \
+  do                                                                  \
+  {                                                                   \
+    LOX_VM_SAVE_IP();                                                 \
+    lox_vm_runtime_error(_vm, __VA_ARGS__);                           \
+                                                                      \
+    return LOX_INTERPRET_RUNTIME_ERROR;                               \
+  } while (false)
+// Where the VM holds no object outside its roots, for the collector to
+// move young objects
+#ifdef LOX_GC_STRESS
+#define LOX_VM_SAFE_POINT() lox_gc_collect_young(_vm)
+#else
+#define LOX_VM_SAFE_POINT()                                           \
+  do                                                                  \
+  {                                                                   \
+    if (_vm->gc.is_nursery_full)                                      \
+    {                                                                 \
+      lox_gc_collect_young(_vm);                                      \
+    }                                                                 \
+  } while (false)
+#endif // LOX_GC_STRESS
+#define LOX_VM_BINARY_OP(_make, _operator)                            \
+  do                                                                  \
+  {                                                                   \
+    if (!lox_value_is_number(lox_vm_peek(_vm, 0)) ||                  \
+        !lox_value_is_number(lox_vm_peek(_vm, 1)))                    \
+    {                                                                 \
+      LOX_VM_ERROR("Operands must be numbers.");                      \
+    }                                                                 \
+    const double b = lox_value_as_number(lox_vm_pop(_vm));            \
+    const double a = lox_value_as_number(_vm->stack_top[-1]);         \
+    _vm->stack_top[-1] = _make(a _operator b);                        \
+  } while (false)
+
+#ifdef LOX_VM_COMPUTED_GOTO
+#define LOX_VM_LABEL_ADDRESS(_name, _effect) &&lox_op_##_name,
+  static void *const dispatch_table[LOX_OP_COUNT] = { LOX_OPCODES(LOX_VM_LABEL_ADDRESS) };
+#undef LOX_VM_LABEL_ADDRESS
+
+#define LOX_VM_CASE(_name) lox_op_##_name:
+#define LOX_VM_NEXT() goto *dispatch_table[LOX_VM_READ_BYTE()]
+#else
+#define LOX_VM_CASE(_name) case LOX_OP_##_name:
+#define LOX_VM_NEXT() continue
+#endif
+
+  LOX_VM_LOAD_FRAME();
+
+#ifdef LOX_VM_COMPUTED_GOTO
+  LOX_VM_NEXT();
+#else
+  for (;;)
+  {
+    switch (LOX_VM_READ_BYTE())
+    {
+#endif
+      LOX_VM_CASE(CONSTANT)
+      {
+        lox_vm_push(_vm, LOX_VM_READ_CONSTANT());
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(NIL)
+      {
+        lox_vm_push(_vm, lox_value_nil());
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(TRUE)
+      {
+        lox_vm_push(_vm, lox_value_bool(true));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(FALSE)
+      {
+        lox_vm_push(_vm, lox_value_bool(false));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(POP)
+      {
+        lox_vm_pop(_vm);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GET_LOCAL)
+      {
+        const uint8_t slot = LOX_VM_READ_BYTE();
+        lox_vm_push(_vm, frame->slots[slot]);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SET_LOCAL)
+      {
+        const uint8_t slot = LOX_VM_READ_BYTE();
+        frame->slots[slot] = lox_vm_peek(_vm, 0);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GET_GLOBAL)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        lox_value_t value;
+        if (!lox_table_get(&_vm->globals, name, &value))
+        {
+          LOX_VM_ERROR("Undefined variable '%s'.", name->chars);
+        }
+        lox_vm_push(_vm, value);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(DEFINE_GLOBAL)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        lox_gc_barrier(&_vm->gc, NULL, lox_value_object(&name->object));
+        lox_gc_barrier(&_vm->gc, NULL, lox_vm_peek(_vm, 0));
+        lox_table_set(&_vm->globals, name, lox_vm_peek(_vm, 0));
+        lox_vm_pop(_vm);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SET_GLOBAL)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        lox_gc_barrier(&_vm->gc, NULL, lox_vm_peek(_vm, 0));
+        if (lox_table_set(&_vm->globals, name, lox_vm_peek(_vm, 0)))
+        {
+          lox_table_delete(&_vm->globals, name);
+          LOX_VM_ERROR("Undefined variable '%s'.", name->chars);
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GET_UPVALUE)
+      {
+        const uint8_t slot = LOX_VM_READ_BYTE();
+        lox_vm_push(_vm, *frame->closure->upvalues[slot]->location);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SET_UPVALUE)
+      {
+        lox_upvalue_t *upvalue = frame->closure->upvalues[LOX_VM_READ_BYTE()];
+        lox_gc_barrier(&_vm->gc, &upvalue->object, lox_vm_peek(_vm, 0));
+        *upvalue->location = lox_vm_peek(_vm, 0);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GET_PROPERTY)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        if (!lox_value_is_object_type(lox_vm_peek(_vm, 0), LOX_OBJECT_INSTANCE))
+        {
+          LOX_VM_ERROR("Only instances have properties.");
+        }
+
+        lox_instance_t *instance = (lox_instance_t *)lox_value_as_object(lox_vm_peek(_vm, 0));
+        lox_value_t value;
+        if (lox_table_get(&instance->fields, name, &value))
+        {
+          _vm->stack_top[-1] = value;
+          LOX_VM_NEXT();
+        }
+
+        LOX_VM_SAVE_IP();
+        if (!lox_vm_bind_method(_vm, instance->class_, name))
+        {
+          return LOX_INTERPRET_RUNTIME_ERROR;
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SET_PROPERTY)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        if (!lox_value_is_object_type(lox_vm_peek(_vm, 1), LOX_OBJECT_INSTANCE))
+        {
+          LOX_VM_ERROR("Only instances have fields.");
+        }
+
+        lox_instance_t *instance = (lox_instance_t *)lox_value_as_object(lox_vm_peek(_vm, 1));
+        lox_gc_barrier(&_vm->gc, &instance->object, lox_value_object(&name->object));
+        lox_gc_barrier(&_vm->gc, &instance->object, lox_vm_peek(_vm, 0));
+        lox_table_set(&instance->fields, name, lox_vm_peek(_vm, 0));
+        const lox_value_t value = lox_vm_pop(_vm);
+        _vm->stack_top[-1] = value;
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GET_SUPER)
+      {
+        lox_string_t *name = LOX_VM_READ_STRING();
+        lox_class_t *superclass = (lox_class_t *)lox_value_as_object(lox_vm_pop(_vm));
+        LOX_VM_SAVE_IP();
+        if (!lox_vm_bind_method(_vm, superclass, name))
+        {
+          return LOX_INTERPRET_RUNTIME_ERROR;
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(EQUAL)
+      {
+        const lox_value_t b = lox_vm_pop(_vm);
+        _vm->stack_top[-1] = lox_value_bool(lox_values_equal(_vm->stack_top[-1], b));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(GREATER)
+      {
+        LOX_VM_BINARY_OP(lox_value_bool, >);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(LESS)
+      {
+        LOX_VM_BINARY_OP(lox_value_bool, <);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(ADD)
+      {
+        const lox_value_t b = lox_vm_peek(_vm, 0);
+        const lox_value_t a = lox_vm_peek(_vm, 1);
+        if (lox_value_is_number(a) && lox_value_is_number(b))
+        {
+          lox_vm_pop(_vm);
+          _vm->stack_top[-1] = lox_value_number(lox_value_as_number(a) + lox_value_as_number(b));
+        }
+        else if (lox_value_is_object_type(a, LOX_OBJECT_STRING) &&
+                 lox_value_is_object_type(b, LOX_OBJECT_STRING))
+        {
+          lox_vm_concatenate(_vm);
+        }
+        else
+        {
+          LOX_VM_ERROR("Operands must be two numbers or two strings.");
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SUBTRACT)
+      {
+        LOX_VM_BINARY_OP(lox_value_number, -);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(MULTIPLY)
+      {
+        LOX_VM_BINARY_OP(lox_value_number, *);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(DIVIDE)
+      {
+        LOX_VM_BINARY_OP(lox_value_number, /);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(NOT)
+      {
+        _vm->stack_top[-1] = lox_value_bool(lox_value_is_falsey(_vm->stack_top[-1]));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(NEGATE)
+      {
+        if (!lox_value_is_number(lox_vm_peek(_vm, 0)))
+        {
+          LOX_VM_ERROR("Operand must be a number.");
+        }
+        _vm->stack_top[-1] = lox_value_number(-lox_value_as_number(_vm->stack_top[-1]));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(PRINT)
+      {
+        lox_value_print(stdout, lox_vm_pop(_vm));
+        fputc('\n', stdout);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(JUMP)
+      {
+        const uint16_t distance = LOX_VM_READ_SHORT();
+        ip += distance;
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(JUMP_IF_FALSE)
+      {
+        const uint16_t distance = LOX_VM_READ_SHORT();
+        if (lox_value_is_falsey(lox_vm_peek(_vm, 0)))
+        {
+          ip += distance;
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(LOOP)
+      {
+        LOX_VM_SAFE_POINT();
+        const uint16_t distance = LOX_VM_READ_SHORT();
+        ip -= distance;
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(CALL)
+      {
+        LOX_VM_SAFE_POINT();
+        const int argument_count = LOX_VM_READ_BYTE();
+        LOX_VM_SAVE_IP();
+        if (!lox_vm_call_value(_vm, lox_vm_peek(_vm, argument_count), argument_count))
+        {
+          return LOX_INTERPRET_RUNTIME_ERROR;
+        }
+        LOX_VM_LOAD_FRAME();
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(INVOKE)
+      {
+        LOX_VM_SAFE_POINT();
+        lox_string_t *name = LOX_VM_READ_STRING();
+        const int argument_count = LOX_VM_READ_BYTE();
+        LOX_VM_SAVE_IP();
+        if (!lox_vm_invoke(_vm, name, argument_count))
+        {
+          return LOX_INTERPRET_RUNTIME_ERROR;
+        }
+        LOX_VM_LOAD_FRAME();
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(SUPER_INVOKE)
+      {
+        LOX_VM_SAFE_POINT();
+        lox_string_t *name = LOX_VM_READ_STRING();
+        const int argument_count = LOX_VM_READ_BYTE();
+        lox_class_t *superclass = (lox_class_t *)lox_value_as_object(lox_vm_pop(_vm));
+        LOX_VM_SAVE_IP();
+        if (!lox_vm_invoke_from_class(_vm, superclass, name, argument_count))
+        {
+          return LOX_INTERPRET_RUNTIME_ERROR;
+        }
+        LOX_VM_LOAD_FRAME();
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(CLOSURE)
+      {
+        lox_function_t *function = (lox_function_t *)lox_value_as_object(LOX_VM_READ_CONSTANT());
+        lox_closure_t *closure = lox_closure_create(_vm, function);
+        lox_vm_push(_vm, lox_value_object(&closure->object));
+        for (int i = 0; i < closure->upvalue_count; ++i)
+        {
+          const uint8_t is_local = LOX_VM_READ_BYTE();
+          const uint8_t index = LOX_VM_READ_BYTE();
+          closure->upvalues[i] = is_local
+                                 ? lox_vm_capture_upvalue(_vm, frame->slots + index)
+                                 : frame->closure->upvalues[index];
+          lox_gc_barrier(&_vm->gc, &closure->object, lox_value_object(&closure->upvalues[i]->object));
+        }
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(CLOSE_UPVALUE)
+      {
+        lox_vm_close_upvalues(_vm, _vm->stack_top - 1);
+        lox_vm_pop(_vm);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(RETURN)
+      {
+        const lox_value_t result = lox_vm_pop(_vm);
+        lox_vm_close_upvalues(_vm, frame->slots);
+        if (--_vm->frame_count == 0)
+        {
+          lox_vm_pop(_vm);
+
+          return LOX_INTERPRET_OK;
+        }
+
+        _vm->stack_top = frame->slots;
+        lox_vm_push(_vm, result);
+        LOX_VM_LOAD_FRAME();
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(CLASS)
+      {
+        lox_class_t *class_ = lox_class_create(_vm, LOX_VM_READ_STRING());
+        lox_vm_push(_vm, lox_value_object(&class_->object));
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(INHERIT)
+      {
+        const lox_value_t superclass = lox_vm_peek(_vm, 1);
+        if (!lox_value_is_object_type(superclass, LOX_OBJECT_CLASS))
+        {
+          LOX_VM_ERROR("Superclass must be a class.");
+        }
+
+        // Methods are copied down, so calls never walk up the hierarchy
+        lox_class_t *subclass = (lox_class_t *)lox_value_as_object(lox_vm_peek(_vm, 0));
+        const lox_class_t *parent = (const lox_class_t *)lox_value_as_object(superclass);
+        lox_table_add_all(&parent->methods, &subclass->methods);
+        subclass->initializer = parent->initializer;
+        lox_gc_retrace(&_vm->gc, &subclass->object);
+        lox_vm_pop(_vm);
+        LOX_VM_NEXT();
+      }
+      LOX_VM_CASE(METHOD)
+      {
+        lox_vm_define_method(_vm, LOX_VM_READ_STRING());
+        LOX_VM_NEXT();
+      }
+#ifndef LOX_VM_COMPUTED_GOTO
+      default:
+        LOX_VM_ERROR("Unknown opcode %u.", ip[-1]);
+    }
+  }
+#endif
+
+#undef LOX_VM_LOAD_FRAME
+#undef LOX_VM_SAVE_IP
+#undef LOX_VM_READ_BYTE
+#undef LOX_VM_READ_SHORT
+#undef LOX_VM_READ_CONSTANT
+#undef LOX_VM_READ_STRING
+#undef LOX_VM_ERROR
+#undef LOX_VM_SAFE_POINT
+#undef LOX_VM_BINARY_OP
+#undef LOX_VM_CASE
+#undef LOX_VM_NEXT
+}
+
+lox_interpret_e
+lox_vm_run
+(
+  lox_vm_t       *_vm,
+  lox_function_t *_function
+)
+{
+  lox_vm_push(_vm, lox_value_object(&_function->object));
+  lox_closure_t *closure = lox_closure_create(_vm, _function);
+  lox_vm_pop(_vm);
+  lox_vm_push(_vm, lox_value_object(&closure->object));
+  if (!lox_vm_call(_vm, closure, 0))
+  {
+    return LOX_INTERPRET_RUNTIME_ERROR;
+  }
+
+  return lox_vm_execute(_vm);
+}
+
+lox_interpret_e
+lox_vm_interpret
+(
+  lox_vm_t    *_vm,
+  lox_lexer_t *_lexer
+)
+{
+  lox_function_t *function = lox_compile(_vm, _lexer);
+  if (function == NULL)
+  {
+    return LOX_INTERPRET_COMPILE_ERROR;
+  }
+
+  return lox_vm_run(_vm, function);
+}
+
+void
+lox_vm_clean
+(
+  lox_vm_t *_vm
+)
+{
+  lox_gc_clean(_vm);
+  lox_object_t *object = _vm->objects;
+  while (object != NULL)
+  {
+    lox_object_t *next = object->next;
+    lox_object_free(_vm, object);
+    object = next;
+  }
+
+  lox_table_clean(&_vm->globals);
+  lox_table_clean(&_vm->strings);
+  lox_reallocate(_vm->stack, 0);
+  lox_reallocate(_vm, 0);
+}
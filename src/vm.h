@@ -0,0 +1,133 @@
+/*
+ * Implements the virtual machine that runs compiled programs, a stack
+ * machine over the bytecode of chunk.h.
+ *
+ * The dispatch loop jumps from one instruction straight to the next
+ * through a table of label addresses when the compiler supports it,
+ * GCC and Clang do, and falls back to a switch otherwise. Building
+ * with LOX_SWITCH_DISPATCH forces the switch.
+ */
+
+#ifndef LOX_VM_H
+#define LOX_VM_H
+
+#include "base.h"
+#include "gc.h"
+#include "lexer.h"
+#include "object.h"
+#include "table.h"
+#include "value.h"
+
+#define LOX_VM_FRAMES_MAX 256
+#define LOX_VM_STACK_MAX  (LOX_VM_FRAMES_MAX * 256)
+
+typedef enum lox_interpret_e
+{
+  LOX_INTERPRET_OK,
+  LOX_INTERPRET_COMPILE_ERROR,
+  LOX_INTERPRET_RUNTIME_ERROR
+} lox_interpret_e;
+
+/*
+ * A function being run. Its locals start at slots, slot 0 holds the
+ * closure itself, or the receiver for methods.
+ */
+typedef struct lox_call_frame_t
+{
+  lox_closure_t *closure;
+  uint8_t       *ip;
+  lox_value_t   *slots;
+} lox_call_frame_t;
+
+struct lox_vm_t
+{
+  lox_call_frame_t  frames[LOX_VM_FRAMES_MAX];
+  int               frame_count;
+
+  lox_value_t      *stack;
+  lox_value_t      *stack_top;
+
+  lox_table_t       globals;
+  // Every string alive, see lox_string_copy
+  lox_table_t       strings;
+  lox_string_t     *init_string;
+  // Sorted by slot, the highest first
+  lox_upvalue_t    *open_upvalues;
+
+  lox_object_t     *objects;
+  size_t            bytes_allocated;
+  lox_gc_t          gc;
+};
+
+/*
+ * The stack is a root of the collector, so objects only referenced
+ * from C, between two allocations, are pushed on it meanwhile.
+ */
+static inline void
+lox_vm_push
+(
+  lox_vm_t    *_vm,
+  lox_value_t  _value
+)
+{
+  *_vm->stack_top++ = _value;
+}
+
+static inline lox_value_t
+lox_vm_pop
+(
+  lox_vm_t *_vm
+)
+{
+  return *--_vm->stack_top;
+}
+
+/*
+ * Creates a VM with the native functions defined, clock() for now.
+ */
+lox_vm_t
+*lox_vm_create
+(void);
+
+void
+lox_vm_define_native
+(
+  lox_vm_t      *_vm,
+  const char    *_name,
+  lox_native_fn  _function,
+  int            _arity
+);
+
+/*
+ * Compiles the tokens of _lexer and runs them. Compile and runtime
+ * errors are reported on stderr, globals stay defined for the next
+ * program run on the same VM.
+ */
+lox_interpret_e
+lox_vm_interpret
+(
+  lox_vm_t    *_vm,
+  lox_lexer_t *_lexer
+);
+
+/*
+ * Runs _function, the top level of a program as returned by
+ * lox_compile.
+ */
+lox_interpret_e
+lox_vm_run
+(
+  lox_vm_t       *_vm,
+  lox_function_t *_function
+);
+
+/*
+ * Frees every object the VM allocated, and the VM.
+ */
+void
+lox_vm_clean
+(
+  lox_vm_t *_vm
+);
+
+#endif // LOX_VM_H